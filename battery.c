@@ -24,196 +24,527 @@
 #include "battery.h"
 #include "config.h"
 #include "smbus.h"
+#include "smbus_async.h"
 #include "mitm.h"
+#include "poll_schedule.h"
+#include "capture.h"
+#include "history.h"
+#include "metrics.h"
 #include "override.h"
+#include "log.h"
 #include "hardware/sync.h"
 #include "pico/stdlib.h"
-#include <stdlib.h>
-#include <stdio.h>
 
 
-bool battery_stat_need_cache_update = false;
+// every stat the firmware knows about:
+// X(command, name, max result length, type, valid for, priority, noise)
+// noise is the change between two readings that still counts as flat (in the stat's units), see battery_stat_adapt().
+// BATTERY_STAT_FIXED stats are always read every valid_for
+#define BATTERY_STATS(X) \
+    X(BATT_CMD_MANUFACTURER_ACCESS, "manufacturer access", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_REMAINING_CAPACITY_ALARM, "capacity alarm", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_REMAINING_TIME_ALARM, "time alarm", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_BATTERY_MODE, "battery mode", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_AT_RATE, "at rate", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_AT_RATE_TIME_TO_FULL, "time to full", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_AT_RATE_TIME_TO_EMPTY, "time to empty", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_AT_RATE_OK, "rate ok", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_TEMPERATURE, "temperature", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, 2) \
+    X(BATT_CMD_VOLTAGE, "voltage", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_HIGH, 20) \
+    X(BATT_CMD_CURRENT, "current", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_HIGH, 20) \
+    X(BATT_CMD_AVERAGE_CURRENT, "avg current", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, 20) \
+    X(BATT_CMD_MAX_ERROR, "max error", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_RELATIVE_STATE_OF_CHARGE, "relative charge", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_HIGH, 0) \
+    X(BATT_CMD_ABSOLUTE_STATE_OF_CHARGE, "absolute charge", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, 0) \
+    X(BATT_CMD_REMAINING_CAPACITY, "remaining", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_HIGH, 1) \
+    X(BATT_CMD_FULL_CHARGE_CAPACITY, "full capacity", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_RUN_TIME_TO_EMPTY, "run time", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, 2) \
+    X(BATT_CMD_AVERAGE_TIME_TO_EMPTY, "avg run time", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, 2) \
+    X(BATT_CMD_AVERAGE_TIME_TO_FULL, "avg charge time", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, 2) \
+    X(BATT_CMD_CHARGING_CURRENT, "charge current", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, 20) \
+    X(BATT_CMD_CHARGING_VOLTAGE, "charge voltage", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, 20) \
+    X(BATT_CMD_BATTERY_STATUS, "battery status", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_CYCLE_COUNT, "cycles", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    \
+    X(BATT_CMD_DESIGN_CAPACITY, "design capacity", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_DESIGN_VOLTAGE, "design voltage", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_SPECIFICATION_INFO, "spec info", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_MANUFACTURE_DATE, "manufacture date", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_SERIAL_NUMBER, "serial no.", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    \
+    X(BATT_CMD_MANUFACTURER_NAME, "manufacturer", 32, SBS_STRING, BATTERY_STAT_VALID_PERIOD_CONSTANT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_DEVICE_NAME, "device name", 32, SBS_STRING, BATTERY_STAT_VALID_PERIOD_CONSTANT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_DEVICE_CHEMISTRY, "chemistry", 16, SBS_STRING, BATTERY_STAT_VALID_PERIOD_CONSTANT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED) \
+    X(BATT_CMD_MANUFACTURER_DATA, "manufacturer data", 14, SBS_BLOCK, BATTERY_STAT_VALID_PERIOD_DEFAULT, BATTERY_STAT_PRIORITY_NORMAL, BATTERY_STAT_FIXED)
+
+
+// slot of each stat in battery_stat_cache
+enum battery_stat_slot {
+#define BATTERY_STAT_SLOT(cmd, name, length, stat_type, valid, prio, flat) BATTERY_STAT_SLOT_##cmd,
+    BATTERY_STATS(BATTERY_STAT_SLOT)
+#undef BATTERY_STAT_SLOT
+    BATTERY_STAT_COUNT
+};
+
+// result buffers of all stats in one block, sized by their max result length.
+// aligned so the gui can read them as uint16
+struct battery_stat_arena {
+#define BATTERY_STAT_BUFFER(cmd, name, length, stat_type, valid, prio, flat) uint8_t result_##cmd[length] __attribute__((aligned(2)));
+    BATTERY_STATS(BATTERY_STAT_BUFFER)
+#undef BATTERY_STAT_BUFFER
+};
+
+struct battery_stat_arena battery_stat_arena;
+
+// snapshots have room for BATTERY_STAT_MAX_RESULT_LENGTH bytes
+#define BATTERY_STAT_CHECK_LENGTH(cmd, name, length, stat_type, valid, prio, flat) _Static_assert(length <= BATTERY_STAT_MAX_RESULT_LENGTH, #cmd " is too long");
+BATTERY_STATS(BATTERY_STAT_CHECK_LENGTH)
+#undef BATTERY_STAT_CHECK_LENGTH
+
+battery_stat_t battery_stat_cache[BATTERY_STAT_COUNT] = {
+#define BATTERY_STAT_ENTRY(cmd, name, length, stat_type, valid, prio, flat) \
+    [BATTERY_STAT_SLOT_##cmd] = { \
+        read_command: cmd, \
+        friendly_name: name, \
+        max_result_length: length, \
+        valid_for: valid, \
+        period: valid, \
+        noise: flat, \
+        type: stat_type, \
+        cached_result: { as_uint8: battery_stat_arena.result_##cmd }, \
+        priority: prio \
+    },
+    BATTERY_STATS(BATTERY_STAT_ENTRY)
+#undef BATTERY_STAT_ENTRY
+};
+
+// command -> slot + 1, 0 if there's no stat for the command.
+// not const so it's in ram, the mitm looks up every reply it snoops
+uint8_t battery_stat_index[256] = {
+#define BATTERY_STAT_INDEX(cmd, name, length, stat_type, valid, prio, flat) [cmd] = BATTERY_STAT_SLOT_##cmd + 1,
+    BATTERY_STATS(BATTERY_STAT_INDEX)
+#undef BATTERY_STAT_INDEX
+};
+
+// stat read that's on the bus in the background (BATT_I2C_ASYNC)
+smbus_transfer_t battery_transfer;
+battery_stat_t* battery_transfer_stat = NULL;
+
+// reads land here first, the cache only gets the result once the read is done
+uint8_t battery_read_buffer[SMBUS_ASYNC_MAX_LENGTH];
+
+struct battery_subscription {
+    battery_stat_t* batt_stat;      // NULL if the slot is free
+    uint32_t max_age;
+};
+
+// only touched by core1 (and by core0 at boot, before core1 runs). core0 sees the result in each stat's max_age
+struct battery_subscription battery_subscriptions[BATTERY_MAX_SUBSCRIPTIONS];
+
+uint64_t battery_last_poll = 0;
+
+// reads done by the poller vs. replies taken from the laptop's traffic
+unsigned long battery_polled_count = 0;
+unsigned long battery_snooped_count = 0;
+
+
+// seqlock: core0 makes the sequence odd while it changes a stat, readers retry if it was odd or changed under them.
+// only core0 writes, so writers never wait and nothing is locked while the bus is in use
+
+void battery_stat_write_begin(battery_stat_t* batt_stat) {
+    batt_stat->sequence++;
+    __dmb();
+}
+
+void battery_stat_write_end(battery_stat_t* batt_stat) {
+    __dmb();
+    batt_stat->sequence++;
+}
 
-spin_lock_t* battery_stat_cache_lock;
-battery_stat_t* battery_stat_cache;
-size_t battery_stat_cache_size;
+void battery_stat_read(battery_stat_t* batt_stat, battery_stat_snapshot_t* snapshot) {
+    uint32_t sequence;
+
+    // unknown stat, looks like one that was never read
+    if (batt_stat == NULL) {
+        snapshot->result_length = 0;
+        snapshot->result_valid = false;
+        snapshot->last_updated = 0;
+        snapshot->valid_for = 0;
+        snapshot->cached_result.as_string[0] = 0x00;
+        return;
+    }
 
+    do {
+        while ((sequence = batt_stat->sequence) & 1) tight_loop_contents();
+        __dmb();
 
-void battery_stat_lock() {
-    spin_lock_unsafe_blocking(battery_stat_cache_lock);
+        for (int i = 0; i < batt_stat->max_result_length; i++) {
+            snapshot->cached_result.as_uint8[i] = batt_stat->cached_result.as_uint8[i];
+        }
+        snapshot->result_length = batt_stat->result_length;
+        snapshot->result_valid = batt_stat->result_valid;
+        snapshot->last_updated = batt_stat->last_updated;
+        snapshot->valid_for = batt_stat->period;
+
+        __dmb();
+    } while (sequence != batt_stat->sequence);
+
+    if (snapshot->result_length > batt_stat->max_result_length) snapshot->result_length = batt_stat->max_result_length;
+    snapshot->cached_result.as_string[snapshot->result_length] = 0x00;
 }
 
-void battery_stat_unlock() {
-    spin_unlock_unsafe(battery_stat_cache_lock);
+bool battery_snapshot_is_error(battery_stat_snapshot_t* snapshot) {
+    return !snapshot->result_valid;
 }
 
-bool battery_stat_is_error(battery_stat_t* batt_stat) {
-    return !batt_stat->result_valid;
+bool battery_snapshot_is_expired(battery_stat_snapshot_t* snapshot) {
+    return snapshot->last_updated == 0 || snapshot->last_updated + snapshot->valid_for < time_us_64();
 }
 
+bool battery_snapshot_is_valid(battery_stat_snapshot_t* snapshot) {
+    return !battery_snapshot_is_error(snapshot) && !battery_snapshot_is_expired(snapshot);
+}
 
-bool battery_stat_is_expired(battery_stat_t* batt_stat) {
-    return batt_stat->last_updated == 0 || batt_stat->last_updated + batt_stat->valid_for < time_us_64();
+
+battery_stat_t* battery_get_stat(uint8_t cmd) {
+    uint8_t slot = battery_stat_index[cmd];
+    if (slot == 0) return NULL;
+    return &battery_stat_cache[slot - 1];
 }
 
-bool battery_stat_is_valid(battery_stat_t* batt_stat) {
-    return !battery_stat_is_error(batt_stat) && !battery_stat_is_expired(batt_stat);
+// recalculates what the poller sees of a stat's subscriptions
+void battery_stat_update_max_age(battery_stat_t* batt_stat) {
+    uint32_t max_age = 0;
+    uint8_t subscribers = 0;
+    bool follows_period = false;
+
+    for (int i = 0; i < BATTERY_MAX_SUBSCRIPTIONS; i++) {
+        struct battery_subscription* subscription = &battery_subscriptions[i];
+        if (subscription->batt_stat != batt_stat) continue;
+
+        subscribers++;
+        if (subscription->max_age == 0) {
+            follows_period = true;
+            continue;
+        }
+        if (max_age == 0 || subscription->max_age < max_age) max_age = subscription->max_age;
+    }
+
+    // same seqlock as the results, but the writer is core1
+    batt_stat->subscription_sequence++;
+    __dmb();
+    batt_stat->max_age = max_age;
+    batt_stat->follows_period = follows_period;
+    batt_stat->subscribers = subscribers;
+    __dmb();
+    batt_stat->subscription_sequence++;
 }
 
+// how old the stat may get before it has to be read again, 0 if nobody is subscribed. only call from core0
+uint32_t battery_stat_get_max_age(battery_stat_t* batt_stat) {
+    uint32_t sequence;
+    uint8_t subscribers;
+    uint32_t max_age;
+    bool follows_period;
 
-battery_stat_t* battery_get_stat(uint8_t cmd) {
-    // todo: this can be optimized
-    battery_stat_t* batt_stat;
-    for (int i = 0; i < battery_stat_cache_size; i++) {
-        batt_stat = &battery_stat_cache[i];
-        if (batt_stat->read_command == cmd) return batt_stat;
+    do {
+        while ((sequence = batt_stat->subscription_sequence) & 1) tight_loop_contents();
+        __dmb();
+
+        subscribers = batt_stat->subscribers;
+        max_age = batt_stat->max_age;
+        follows_period = batt_stat->follows_period;
+
+        __dmb();
+    } while (sequence != batt_stat->subscription_sequence);
+
+    if (subscribers == 0) return 0;
+    if (max_age == 0 || (follows_period && batt_stat->period < max_age)) max_age = batt_stat->period;
+    return max_age;
+}
+
+battery_subscription_t battery_stat_subscribe(battery_stat_t* batt_stat, uint32_t max_age) {
+    if (batt_stat == NULL) return -1;
+
+    for (int i = 0; i < BATTERY_MAX_SUBSCRIPTIONS; i++) {
+        struct battery_subscription* subscription = &battery_subscriptions[i];
+        if (subscription->batt_stat != NULL) continue;
+
+        subscription->batt_stat = batt_stat;
+        subscription->max_age = max_age;
+        battery_stat_update_max_age(batt_stat);
+        return i;
     }
+
+    return -1;
 }
 
-void battery_stat_request_update(battery_stat_t* batt_stat) {
-    batt_stat->update_requested = true;
-    battery_stat_need_cache_update = true;
+void battery_stat_unsubscribe(battery_subscription_t subscription) {
+    if (subscription < 0 || subscription >= BATTERY_MAX_SUBSCRIPTIONS) return;
+
+    battery_stat_t* batt_stat = battery_subscriptions[subscription].batt_stat;
+    if (batt_stat == NULL) return;
+
+    battery_subscriptions[subscription].batt_stat = NULL;
+    battery_stat_update_max_age(batt_stat);
 }
 
 
+bool battery_stat_is_signed(uint8_t cmd) {
+    return cmd == BATT_CMD_AT_RATE || cmd == BATT_CMD_CURRENT || cmd == BATT_CMD_AVERAGE_CURRENT;
+}
+
+int32_t battery_reply_value(uint8_t cmd, uint8_t* reply) {
+    uint16_t raw = reply[0] | (reply[1] << 8);
+    return battery_stat_is_signed(cmd) ? (int16_t) raw : raw;
+}
+
+// adjusts the period of an adaptive stat to a new reading. the period drops when the change is over the
+// noise level and more than twice the average change (or the current changed direction), grows by a quarter
+// while the readings stay within the noise level, and stays the same while the stat moves at a steady pace
+void battery_stat_adapt(battery_stat_t* batt_stat, uint8_t* reply) {
+    if (batt_stat->noise == BATTERY_STAT_FIXED) return;
+
+    bool is_signed = battery_stat_is_signed(batt_stat->read_command);
+    int32_t value = battery_reply_value(batt_stat->read_command, reply);
+
+    if (!batt_stat->has_last_value) {
+        batt_stat->last_value = value;
+        batt_stat->has_last_value = true;
+        return;
+    }
+
+    int32_t last_value = batt_stat->last_value;
+    uint32_t change = value > last_value ? value - last_value : last_value - value;
+    uint32_t period = batt_stat->period;
+
+    if (is_signed && ((value < 0 && last_value > 0) || (value > 0 && last_value < 0))) {
+        period = BATTERY_STAT_ADAPTIVE_MIN_PERIOD;
+    } else if (change > batt_stat->noise && change * 16 > batt_stat->average_change * 2) {
+        // a jump way over the noise level is usually a load change, catch up quicker
+        period /= change > 8 * (uint32_t) batt_stat->noise ? 4 : 2;
+    } else if (change <= batt_stat->noise) {
+        period += period / 4;
+    }
+
+    if (period < BATTERY_STAT_ADAPTIVE_MIN_PERIOD) period = BATTERY_STAT_ADAPTIVE_MIN_PERIOD;
+    if (period > BATTERY_STAT_ADAPTIVE_MAX_PERIOD) period = BATTERY_STAT_ADAPTIVE_MAX_PERIOD;
+
+    batt_stat->period = period;
+    batt_stat->average_change = (batt_stat->average_change * 7 + change * 16) / 8;
+    batt_stat->last_value = value;
+}
+
+// ret is like the return value of smbus_read
+void battery_store_stat_result(battery_stat_t* batt_stat, int ret) {
+    if (ret < 0) {
+        batt_stat->result_valid = false;
+    } else {
+        batt_stat->result_valid = true;
+        batt_stat->result_length = ret;
+    }
+
+    batt_stat->last_updated = time_us_64();
+}
+
+// copies a reply into the cache, ret is like the return value of smbus_read.
+// only call from core0, the readers on core1 see either the old or the new result
+void battery_store_stat_reply(battery_stat_t* batt_stat, uint8_t* reply, int ret) {
+    battery_stat_write_begin(batt_stat);
+
+    if (ret >= 0) {
+        for (int i = 0; i < ret; i++) {
+            batt_stat->cached_result.as_uint8[i] = reply[i];
+        }
+
+        // same as smbus_read_text, the text can end before the block does
+        if (batt_stat->type == SBS_STRING) {
+            for (int i = 0; i < ret; i++) {
+                if (reply[i] == 0x00) {
+                    ret = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (ret >= 2) battery_stat_adapt(batt_stat, reply);
+    battery_store_stat_result(batt_stat, ret);
+    battery_stat_write_end(batt_stat);
+
+    if (ret >= 2 && batt_stat->type == SBS_BYTES) {
+        int32_t value = battery_reply_value(batt_stat->read_command, reply);
+        history_add(batt_stat->read_command, value, batt_stat->last_updated);
+        metrics_note_reading(batt_stat->read_command, value, batt_stat->last_updated);
+    }
+}
+
 void battery_update_stat(battery_stat_t* batt_stat) {
     i2c_dev_t* bms = get_bms_dev();
     cmd_reply_override override = NULL;
     int ret;
 
-    printf("updating %02x (%s)\n", batt_stat->read_command, batt_stat->friendly_name);
+    LOG_DEBUG(LOG_BATTERY_UPDATE, batt_stat->read_command);
     
     if (defused_use_read_command_reply_override(batt_stat->read_command)) {
         override = get_read_command_reply_override(batt_stat->read_command);
-        if (override != NULL) printf("using read cmd override\n");
+        if (override != NULL) LOG_DEBUG(LOG_BATTERY_UPDATE_OVERRIDE, batt_stat->read_command);
     }
 
     switch (batt_stat->type) {
         case SBS_BYTES:
             if (override != NULL) {
-                ret = mitm_smbus_read_with_override(bms, batt_stat->read_command, batt_stat->cached_result.as_uint8, batt_stat->max_result_length, false, override);                    
+                ret = mitm_smbus_read_with_override(bms, batt_stat->read_command, battery_read_buffer, batt_stat->max_result_length, false, override);                    
             } else {
-                ret = smbus_read(bms, batt_stat->read_command, batt_stat->cached_result.as_uint8, batt_stat->max_result_length);
+                ret = smbus_read(bms, batt_stat->read_command, battery_read_buffer, batt_stat->max_result_length);
             }
             break;
         case SBS_BLOCK:
             if (override != NULL) {
-                ret = mitm_smbus_read_with_override(bms, batt_stat->read_command, batt_stat->cached_result.as_uint8, batt_stat->max_result_length, true, override);
+                ret = mitm_smbus_read_with_override(bms, batt_stat->read_command, battery_read_buffer, batt_stat->max_result_length, true, override);
             } else {
-                ret = smbus_read_block(bms, batt_stat->read_command, batt_stat->cached_result.as_uint8, batt_stat->max_result_length);
+                ret = smbus_read_block(bms, batt_stat->read_command, battery_read_buffer, batt_stat->max_result_length);
             }
             break;
         case SBS_STRING:
             if (override != NULL) {
-                // ret = mitm_smbus_read_text_with_override(bms, batt_stat->read_command, batt_stat->cached_result.as_uint8, batt_stat->max_result_length, override);
-                ret = mitm_smbus_read_with_override(bms, batt_stat->read_command, batt_stat->cached_result.as_uint8, batt_stat->max_result_length, true, override);
+                // ret = mitm_smbus_read_text_with_override(bms, batt_stat->read_command, battery_read_buffer, batt_stat->max_result_length, override);
+                ret = mitm_smbus_read_with_override(bms, batt_stat->read_command, battery_read_buffer, batt_stat->max_result_length, true, override);
             } else {
-                ret = smbus_read_text(bms, batt_stat->read_command, batt_stat->cached_result.as_uint8, batt_stat->max_result_length);
+                ret = smbus_read_text(bms, batt_stat->read_command, (char*) battery_read_buffer, batt_stat->max_result_length);
             }
             break;
         default:
             return;
     }
 
-    if (ret < 0) {
-        batt_stat->result_valid = false;
-    } else {
-        batt_stat->result_valid = true;
-        batt_stat->result_length = ret;
-        batt_stat->update_requested = false;
+    battery_store_stat_reply(batt_stat, battery_read_buffer, ret);
+}
+
+// starts reading a stat in the background. returns false if it has to be read the blocking way instead
+bool battery_start_stat_transfer(battery_stat_t* batt_stat) {
+    if (defused_use_read_command_reply_override(batt_stat->read_command) && get_read_command_reply_override(batt_stat->read_command) != NULL) return false;
+
+    switch (batt_stat->type) {
+        case SBS_BYTES:
+            smbus_transfer_read(&battery_transfer, get_bms_dev(), batt_stat->read_command, battery_read_buffer, batt_stat->max_result_length);
+            break;
+        case SBS_BLOCK:
+        case SBS_STRING:
+            smbus_transfer_read_block(&battery_transfer, get_bms_dev(), batt_stat->read_command, battery_read_buffer, batt_stat->max_result_length);
+            break;
+        default:
+            return false;
     }
 
-    batt_stat->last_updated = time_us_64();
+    if (smbus_async_submit(&battery_transfer) < 0) return false;
+
+    LOG_DEBUG(LOG_SMBUS_ASYNC_UPDATE, batt_stat->read_command);
+    battery_transfer_stat = batt_stat;
+    return true;
 }
 
+void battery_finish_stat_transfer(battery_stat_t* batt_stat) {
+    int ret = battery_transfer.result;
 
-void battery_update_cache() {
-    if (!battery_stat_need_cache_update) return;
-    
-    battery_stat_lock();
+    // the laptop came first, the stat is still due and gets read again
+    if (ret == SMBUS_ERROR_ABORTED) return;
+
+    if (ret < 0) LOG_ERROR(LOG_SMBUS_ASYNC_FAILED, batt_stat->read_command, ret);
+    battery_store_stat_reply(batt_stat, battery_read_buffer, ret);
+}
 
-    battery_stat_need_cache_update = false;
+void battery_stat_snoop_reply(uint8_t cmd, uint8_t* reply, uint8_t length) {
+    capture_snoop_reply(cmd, reply, length);
 
-    battery_stat_t* batt_stat;
+    battery_stat_t* batt_stat = battery_get_stat(cmd);
+    if (batt_stat == NULL || length > batt_stat->max_result_length) return;
+
+    battery_store_stat_reply(batt_stat, reply, length);
+
+    battery_snooped_count++;
+}
+
+void battery_get_poll_stats(unsigned long* polled, unsigned long* snooped) {
+    *polled = battery_polled_count;
+    *snooped = battery_snooped_count;
+}
 
-    for (int i = 0; i < battery_stat_cache_size; i++) {
-        batt_stat = &battery_stat_cache[i];
-        if (!batt_stat->update_requested) continue;
-        if (batt_stat->last_updated + BATTERY_STAT_MIN_RETRY_PERIOD > time_us_64()) continue;
+void battery_get_poll_demand(int* subscriptions, unsigned long* reads_per_minute) {
+    *subscriptions = 0;
+    *reads_per_minute = 0;
 
-        battery_update_stat(batt_stat);
+    for (int i = 0; i < BATTERY_MAX_SUBSCRIPTIONS; i++) {
+        if (battery_subscriptions[i].batt_stat != NULL) (*subscriptions)++;
     }
 
-    battery_stat_unlock();
+    for (int i = 0; i < BATTERY_STAT_COUNT; i++) {
+        uint32_t max_age = battery_stat_get_max_age(&battery_stat_cache[i]);
+        if (max_age == 0) continue;
+        *reads_per_minute += 60000000ull * 100 / ((uint64_t) max_age * BATTERY_STAT_REFRESH_PERCENT);
+    }
 }
 
 
-battery_stat_t create_battery_stat(uint8_t cmd, char* friendly_name, uint8_t max_result_length, battery_stat_type_t type, uint32_t valid_for) {
-    battery_response_t result;
-    result.as_uint8 = malloc(max_result_length);
+// the due stat with the earliest deadline (see BATTERY_STAT_PRIORITY_BOOST), NULL if none has to be read right now
+battery_stat_t* battery_next_stat_to_update(uint64_t now) {
+    battery_stat_t* next = NULL;
+    uint64_t next_deadline = 0;
 
-    battery_stat_t batt_stat = {
-        read_command: cmd,
-        friendly_name: friendly_name,
-        max_result_length: max_result_length,
-        valid_for: valid_for,
-        type: type,
+    for (int i = 0; i < BATTERY_STAT_COUNT; i++) {
+        battery_stat_t* batt_stat = &battery_stat_cache[i];
+        uint32_t max_age = battery_stat_get_max_age(batt_stat);
+        if (max_age == 0) continue;
 
-        cached_result: result,
-        result_length: 0,
-        result_valid: false,
-        last_updated: 0,
+        // snooped replies count as updates too, so the stats the laptop keeps fresh don't come up here
+        if (batt_stat->last_updated != 0) {
+            if (!batt_stat->result_valid && batt_stat->last_updated + BATTERY_STAT_MIN_RETRY_PERIOD > now) continue;
+            if (batt_stat->last_updated + (uint64_t) max_age * BATTERY_STAT_REFRESH_PERCENT / 100 > now) continue;
+        }
 
-        update_requested: false
-    };
-    
-    return batt_stat;
-}
-
-
-void init_battery() {
-    battery_stat_t battery_stat_cache_init[] = {
-        create_battery_stat(BATT_CMD_MANUFACTURER_ACCESS, "manufacturer access", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_REMAINING_CAPACITY_ALARM, "capacity alarm", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_REMAINING_TIME_ALARM, "time alarm", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_BATTERY_MODE, "battery mode", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_AT_RATE, "at rate", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_AT_RATE_TIME_TO_FULL, "time to full", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_AT_RATE_TIME_TO_EMPTY, "time to empty", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_AT_RATE_OK, "rate ok", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_TEMPERATURE, "temperature", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_VOLTAGE, "voltage", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_CURRENT, "current", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_AVERAGE_CURRENT, "avg current", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_MAX_ERROR, "max error", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_RELATIVE_STATE_OF_CHARGE, "relative charge", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_ABSOLUTE_STATE_OF_CHARGE, "absolute charge", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_REMAINING_CAPACITY, "remaining", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_FULL_CHARGE_CAPACITY, "full capacity", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_RUN_TIME_TO_EMPTY, "run time", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_AVERAGE_TIME_TO_EMPTY, "avg run time", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_AVERAGE_TIME_TO_FULL, "avg charge time", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_CHARGING_CURRENT, "charge current", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_CHARGING_VOLTAGE, "charge voltage", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_BATTERY_STATUS, "battery status", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-        create_battery_stat(BATT_CMD_CYCLE_COUNT, "cycles", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-
-        create_battery_stat(BATT_CMD_DESIGN_CAPACITY, "design capacity", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT),
-        create_battery_stat(BATT_CMD_DESIGN_VOLTAGE, "design voltage", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT),
-        create_battery_stat(BATT_CMD_SPECIFICATION_INFO, "spec info", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT),
-        create_battery_stat(BATT_CMD_MANUFACTURE_DATE, "manufacture date", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT),
-        create_battery_stat(BATT_CMD_SERIAL_NUMBER, "serial no.", 2, SBS_BYTES, BATTERY_STAT_VALID_PERIOD_CONSTANT),
-
-        create_battery_stat(BATT_CMD_MANUFACTURER_NAME, "manufacturer", 32, SBS_STRING, BATTERY_STAT_VALID_PERIOD_CONSTANT),
-        create_battery_stat(BATT_CMD_DEVICE_NAME, "device name", 32, SBS_STRING, BATTERY_STAT_VALID_PERIOD_CONSTANT),
-        create_battery_stat(BATT_CMD_DEVICE_CHEMISTRY, "chemistry", 16, SBS_STRING, BATTERY_STAT_VALID_PERIOD_CONSTANT),
-        create_battery_stat(BATT_CMD_MANUFACTURER_DATA, "manufacturer data", 14, SBS_BLOCK, BATTERY_STAT_VALID_PERIOD_DEFAULT),
-    };
-    battery_stat_cache_size = sizeof(battery_stat_cache_init) / sizeof(battery_stat_t);
-    battery_stat_cache = malloc(sizeof(battery_stat_cache_init));
-    for (int i = 0; i < battery_stat_cache_size; i++) {
-        battery_stat_cache[i] = battery_stat_cache_init[i];
+        // never read ones are due right away
+        uint64_t deadline = batt_stat->last_updated == 0 ? 0 : batt_stat->last_updated + max_age;
+        uint64_t boost = (uint64_t) batt_stat->priority * BATTERY_STAT_PRIORITY_BOOST;
+        deadline = deadline > boost ? deadline - boost : 0;
+
+        if (next == NULL || deadline < next_deadline) {
+            next = batt_stat;
+            next_deadline = deadline;
+        }
+    }
+
+    return next;
+}
+
+void battery_update_cache() {
+    battery_stat_t* batt_stat;
+
+    // pick up the read that was started last time
+    if (battery_transfer_stat != NULL) {
+        if (!smbus_async_poll(&battery_transfer)) return;
+
+        battery_finish_stat_transfer(battery_transfer_stat);
+        battery_transfer_stat = NULL;
     }
 
-    battery_stat_cache_lock = spin_lock_instance(spin_lock_claim_unused(true));
+    uint64_t now = time_us_64();
+    if (now - battery_last_poll < BATTERY_POLL_MIN_INTERVAL) return;
+
+    // one stat per call, the next one comes next time
+    batt_stat = battery_next_stat_to_update(now);
+    if (batt_stat == NULL) return;
+
+    // wait for a gap between the laptop's reads
+    uint32_t duration = poll_schedule_estimate_read_us(batt_stat->max_result_length, batt_stat->type != SBS_BYTES);
+    if (!poll_schedule_can_start(duration)) return;
+
+    battery_last_poll = now;
+    battery_polled_count++;
+
+    if (BATT_I2C_ASYNC && battery_start_stat_transfer(batt_stat)) return;
+
+    battery_update_stat(batt_stat);
+
+    // the laptop started a transaction while the bus was ours
+    if (mitm_laptop_pending()) poll_schedule_count_collision();
 }
@@ -68,7 +68,27 @@
 
 #define BATTERY_STAT_VALID_PERIOD_DEFAULT 5000000       // 5 sec
 #define BATTERY_STAT_VALID_PERIOD_CONSTANT 1200000000   // 20 min
-#define BATTERY_STAT_MIN_RETRY_PERIOD 3000000           // 3 sec
+#define BATTERY_STAT_MIN_RETRY_PERIOD 3000000           // 3 sec, failed reads aren't retried sooner than this
+
+// stats are polled for their subscribers. a stat is read again once it's BATTERY_STAT_REFRESH_PERCENT
+// of the shortest max age its subscribers asked for old, so it's fresh again before that runs out
+#define BATTERY_MAX_SUBSCRIPTIONS 32
+#define BATTERY_STAT_REFRESH_PERCENT 75
+#define BATTERY_POLL_MIN_INTERVAL 20000                 // 20 ms between reads, caps the poller at 50 reads/sec
+
+// adaptive stats (the ones with a noise level in battery.c) get read faster while they move and slower while
+// they're flat, starting at valid_for. fixed ones always use valid_for
+#define BATTERY_STAT_FIXED -1
+#define BATTERY_STAT_ADAPTIVE_MIN_PERIOD 1000000        // 1 sec
+#define BATTERY_STAT_ADAPTIVE_MAX_PERIOD 30000000       // 30 sec
+
+// the poller reads the requested stat that expires first. high priority ones count as expiring
+// BATTERY_STAT_PRIORITY_BOOST earlier per priority level, so they're read before the rest
+#define BATTERY_STAT_PRIORITY_NORMAL 0
+#define BATTERY_STAT_PRIORITY_HIGH 1
+#define BATTERY_STAT_PRIORITY_BOOST 2000000             // 2 sec
+
+#define BATTERY_STAT_MAX_RESULT_LENGTH 32               // longest stat (sbs strings/blocks are max 32 bytes)
 
 
 enum battery_stat_type {
@@ -95,36 +115,89 @@ struct battery_stat {
     uint32_t valid_for;
     battery_stat_type_t type;
 
+    // written by core0 only. sequence is odd while it's writing, readers use battery_stat_read()
+    volatile uint32_t sequence;
     battery_response_t cached_result;
     uint8_t result_length;
     bool result_valid;
     uint64_t last_updated;
 
-    bool update_requested;
+    // refresh period, changes with the readings unless noise is BATTERY_STAT_FIXED (see battery_stat_adapt())
+    uint32_t period;
+    int16_t noise;              // change between readings that still counts as flat
+    int32_t last_value;
+    uint32_t average_change;    // moving average of the change between readings, x16
+    bool has_last_value;
+
+    // written by core1 only (and core0 at boot), under their own seqlock. core0 reads them with battery_stat_get_max_age()
+    volatile uint32_t subscription_sequence;
+    uint8_t subscribers;
+    uint32_t max_age;           // shortest explicit max age the subscribers asked for, 0 if none did
+    bool follows_period;        // some subscriber asked for max age 0
+
+    uint8_t priority;           // BATTERY_STAT_PRIORITY_*
 };
 
 typedef struct battery_stat battery_stat_t;
 
+// handle of a subscription, negative if subscribing failed
+typedef int battery_subscription_t;
+
+// a consistent copy of a stat's result, see battery_stat_read()
+struct battery_stat_snapshot {
+    union {
+        uint16_t as_uint16[BATTERY_STAT_MAX_RESULT_LENGTH / 2];
+        uint8_t as_uint8[BATTERY_STAT_MAX_RESULT_LENGTH];
+        int16_t as_int16[BATTERY_STAT_MAX_RESULT_LENGTH / 2];
+        char as_string[BATTERY_STAT_MAX_RESULT_LENGTH + 1];     // always null terminated
+    } cached_result;
+    uint8_t result_length;
+    bool result_valid;
+    uint64_t last_updated;
+    uint32_t valid_for;
+};
+
+typedef struct battery_stat_snapshot battery_stat_snapshot_t;
+
 // IMPORTANT:
-// - listen to the warnings in the comments below when calling these functions
-// - accessing the battery_stat struct from core1 safely requires a lock
-// - make it quick, long locks will delay comms between the laptop and battery and could cause problems
+// - the stat cache is only written by core0 (the poller and the mitm), nobody waits on the battery bus while reading it
+// - don't touch the result fields of battery_stat_t from core1, copy them out with battery_stat_read()
 
-// only use these on core1, never in an interrupt
-// (doesn't apply to internal functions)
-void battery_stat_lock();
-void battery_stat_unlock();
+// copies a stat's result into a snapshot. never blocks on the bus, it only retries if core0 was writing the stat
+// at the same time (which takes a few hundred ns).
+// use on core1, never in an interrupt
+void battery_stat_read(battery_stat_t* batt_stat, battery_stat_snapshot_t* snapshot);
 
-// needs lock (on core1)
-bool battery_stat_is_error(battery_stat_t* batt_stat);
-bool battery_stat_is_expired(battery_stat_t* batt_stat);
-bool battery_stat_is_valid(battery_stat_t* batt_stat);  // true if the previous 2 are false
+bool battery_snapshot_is_error(battery_stat_snapshot_t* snapshot);
+bool battery_snapshot_is_expired(battery_stat_snapshot_t* snapshot);
+bool battery_snapshot_is_valid(battery_stat_snapshot_t* snapshot);  // true if the previous 2 are false
 
 // thread safe (ish)
-battery_stat_t* battery_get_stat(uint8_t cmd);  // note: the struct at the pointer is not thread-safe!
-void battery_stat_request_update(battery_stat_t* batt_stat);
-
+// the stat for a command, NULL if the firmware doesn't know it. subscribe and read take NULL as well
+// (a NULL stat reads as never updated)
+battery_stat_t* battery_get_stat(uint8_t cmd);  // note: the result fields at the pointer are not thread-safe!
+
+// keeps a stat from getting older than max_age microseconds until unsubscribed. with max_age 0 it follows the
+// stat's own (possibly adaptive) period. the poller reads each stat as often as its most demanding subscription needs,
+// so a long max_age only sets a floor and the stat still gets the readings the laptop and other subscribers cause.
+// returns a negative handle if the stat is NULL or all BATTERY_MAX_SUBSCRIPTIONS are taken.
+// use on core1, never in an interrupt. the one exception is boot: core0 may subscribe before it launches core1
+// (init_history and init_metrics do)
+battery_subscription_t battery_stat_subscribe(battery_stat_t* batt_stat, uint32_t max_age);
+void battery_stat_unsubscribe(battery_subscription_t subscription);
+
+// reads at most one subscribed stat per call, in the gaps between the laptop's transactions (see poll_schedule.h).
 // only call from core0, never in an interrupt
 void battery_update_cache();
 
-void init_battery();
+// stores a pec checked reply the laptop got from the battery, so the poller doesn't have to read it again.
+// reply is the data without block length or pec.
+// only call from core0, never in an interrupt
+void battery_stat_snoop_reply(uint8_t cmd, uint8_t* reply, uint8_t length);
+
+// stat reads done by the poller and replies taken from the laptop's traffic since boot
+void battery_get_poll_stats(unsigned long* polled, unsigned long* snooped);
+
+// active subscriptions and the reads per minute they add up to (before snooping and the poll rate cap)
+void battery_get_poll_demand(int* subscriptions, unsigned long* reads_per_minute);
+
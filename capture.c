@@ -0,0 +1,277 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "capture.h"
+#include "battery.h"
+#include "mitm.h"
+#include "smbus.h"
+#include "smbus_async.h"
+#include "poll_schedule.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+// one per value in a sample, read in this order
+struct capture_field {
+    uint8_t cmd;
+    uint8_t flag;
+};
+
+const struct capture_field capture_fields[] = {
+    {BATT_CMD_CURRENT, CAPTURE_HAS_CURRENT},
+    {BATT_CMD_VOLTAGE, CAPTURE_HAS_VOLTAGE},
+    {BATT_CMD_TEMPERATURE, CAPTURE_HAS_TEMPERATURE},
+};
+
+#define CAPTURE_FIELD_COUNT (sizeof(capture_fields) / sizeof(capture_fields[0]))
+
+// everything here is core0 only, the ring is never touched from an interrupt
+capture_sample_t capture_ring[CAPTURE_MAX_SAMPLES];
+uint32_t capture_written = 0;           // samples written since the capture started, wraps around the ring
+
+bool capture_is_running = false;
+uint64_t capture_start_time;
+uint32_t capture_slot;                  // number of the slot that's being filled
+capture_sample_t capture_sample;        // the sample of that slot
+uint8_t capture_wanted;                 // CAPTURE_HAS_* bits to read in this slot
+
+// read that's on the bus (BATT_I2C_ASYNC)
+smbus_transfer_t capture_transfer;
+uint8_t capture_transfer_flag = 0;      // the value it's for, 0 if there's none
+uint8_t capture_read_buffer[2];
+
+// samples capture_export_next up to capture_export_end still have to be sent
+uint32_t capture_export_next = 0;
+uint32_t capture_export_end = 0;
+char capture_flush_line[2 + CAPTURE_EXPORT_MAX_SAMPLES * sizeof(capture_sample_t) * 2 + 2];
+
+capture_stats_t capture_stats;
+
+_Static_assert(sizeof(capture_sample_t) == 12, "capture samples are part of the export format");
+
+
+const struct capture_field* capture_find_field(uint8_t cmd) {
+    for (int i = 0; i < CAPTURE_FIELD_COUNT; i++) {
+        if (capture_fields[i].cmd == cmd) return &capture_fields[i];
+    }
+    return NULL;
+}
+
+void capture_store(uint8_t flag, uint8_t* reply) {
+    uint16_t value = reply[0] | reply[1] << 8;
+
+    switch (flag) {
+        case CAPTURE_HAS_CURRENT: capture_sample.current = (int16_t) value; break;
+        case CAPTURE_HAS_VOLTAGE: capture_sample.voltage = value; break;
+        case CAPTURE_HAS_TEMPERATURE: capture_sample.temperature = value; break;
+    }
+
+    capture_sample.valid |= flag;
+}
+
+uint64_t capture_slot_start(uint32_t slot) {
+    return capture_start_time + (uint64_t) slot * CAPTURE_INTERVAL;
+}
+
+void capture_begin_slot(uint32_t slot) {
+    capture_slot = slot;
+
+    memset(&capture_sample, 0, sizeof(capture_sample));
+    capture_sample.timestamp = (uint64_t) slot * CAPTURE_INTERVAL;
+
+    capture_wanted = CAPTURE_HAS_CURRENT | CAPTURE_HAS_VOLTAGE;
+    if (slot % CAPTURE_TEMPERATURE_DIVIDER == 0) capture_wanted |= CAPTURE_HAS_TEMPERATURE;
+}
+
+void capture_end_slot() {
+    uint8_t missed = capture_wanted & ~capture_sample.valid;
+    for (int i = 0; i < CAPTURE_FIELD_COUNT; i++) {
+        if (missed & capture_fields[i].flag) capture_stats.missed++;
+    }
+
+    capture_ring[capture_written % CAPTURE_MAX_SAMPLES] = capture_sample;
+    capture_written++;
+    capture_stats.samples++;
+}
+
+void capture_finish_read(int ret) {
+    // a failed read is just a value missing from the sample, logging each one would flood the log at this rate
+    if (ret == 2) capture_store(capture_transfer_flag, capture_read_buffer);
+    capture_transfer_flag = 0;
+}
+
+
+void capture_start() {
+    // the slots of the last capture are gone, so is an export that's still running
+    capture_written = 0;
+    capture_export_next = 0;
+    capture_export_end = 0;
+    memset(&capture_stats, 0, sizeof(capture_stats));
+
+    capture_start_time = time_us_64();
+    capture_begin_slot(0);
+    capture_is_running = true;
+
+    printf("capture: started, one sample every %d us for %d sec\n", CAPTURE_INTERVAL, CAPTURE_DURATION / 1000000);
+}
+
+void capture_stop() {
+    if (!capture_is_running) return;
+
+    // the buffer has to stay around until the read is off the bus
+    if (capture_transfer_flag != 0) {
+        smbus_async_wait(&capture_transfer);
+        capture_transfer_flag = 0;
+    }
+
+    capture_is_running = false;
+
+    printf("capture: stopped, %lu samples (%lu reads, %lu values from the laptop, %lu missing, %lu slots skipped)\n",
+        capture_stats.samples, capture_stats.reads, capture_stats.snooped, capture_stats.missed, capture_stats.skipped_slots);
+}
+
+bool capture_running() {
+    return capture_is_running;
+}
+
+
+void capture_update() {
+    if (!capture_is_running) return;
+
+    // the read that's on the bus still belongs to the current slot
+    if (capture_transfer_flag != 0) {
+        if (!smbus_async_poll(&capture_transfer)) return;
+        capture_finish_read(capture_transfer.result);
+    }
+
+    uint64_t now = time_us_64();
+
+    if (now >= capture_slot_start(capture_slot + 1)) {
+        capture_end_slot();
+
+        if (now - capture_start_time >= CAPTURE_DURATION) {
+            capture_stop();
+            return;
+        }
+
+        // the main loop can get held up by the mitm, the slots that passed in the meantime are lost
+        uint32_t slot = (now - capture_start_time) / CAPTURE_INTERVAL;
+        capture_stats.skipped_slots += slot - capture_slot - 1;
+        capture_begin_slot(slot);
+    }
+
+    uint8_t pending = capture_wanted & ~capture_sample.valid;
+    if (pending == 0) return;
+
+    const struct capture_field* field = NULL;
+    for (int i = 0; i < CAPTURE_FIELD_COUNT; i++) {
+        if (pending & capture_fields[i].flag) {
+            field = &capture_fields[i];
+            break;
+        }
+    }
+
+    // a read that runs into the next slot would end up with the wrong timestamp.
+    // unlike the stat poller this never forces a read, a missing value is better than a laptop that waits
+    uint32_t duration = poll_schedule_estimate_read_us(2, false);
+    if (now + duration > capture_slot_start(capture_slot + 1)) return;
+    if (!poll_schedule_fits(duration)) return;
+
+    capture_stats.reads++;
+    capture_transfer_flag = field->flag;
+
+    // straight from the battery, overrides would defeat the point
+    if (BATT_I2C_ASYNC) {
+        smbus_transfer_read(&capture_transfer, get_bms_dev(), field->cmd, capture_read_buffer, 2);
+        if (smbus_async_submit(&capture_transfer) >= 0) return;
+        capture_finish_read(SMBUS_ERROR_GENERIC);
+        return;
+    }
+
+    capture_finish_read(smbus_read(get_bms_dev(), field->cmd, capture_read_buffer, 2));
+
+    // the laptop started a transaction while the bus was ours
+    if (mitm_laptop_pending()) poll_schedule_count_collision();
+}
+
+void capture_snoop_reply(uint8_t cmd, uint8_t* reply, uint8_t length) {
+    if (!capture_is_running || length != 2) return;
+
+    const struct capture_field* field = capture_find_field(cmd);
+    if (field == NULL || (capture_sample.valid & field->flag)) return;
+
+    // also taken when it isn't wanted in this slot, it's free
+    capture_store(field->flag, reply);
+    capture_sample.snooped |= field->flag;
+    capture_stats.snooped++;
+}
+
+
+void capture_export() {
+    capture_export_next = capture_written > CAPTURE_MAX_SAMPLES ? capture_written - CAPTURE_MAX_SAMPLES : 0;
+    capture_export_end = capture_written;
+
+    printf("capture: exporting %lu samples\n", (unsigned long) (capture_export_end - capture_export_next));
+}
+
+void capture_flush() {
+    const char hex[] = "0123456789abcdef";
+    if (capture_export_next == capture_export_end) return;
+
+    // a running capture wrote over samples that weren't sent yet
+    if (capture_written - capture_export_next > CAPTURE_MAX_SAMPLES) {
+        capture_export_next = capture_written - CAPTURE_MAX_SAMPLES;
+        if (capture_export_next >= capture_export_end) {
+            capture_export_end = capture_export_next;
+            return;
+        }
+    }
+
+    uint32_t count = capture_export_end - capture_export_next;
+    if (count > CAPTURE_EXPORT_MAX_SAMPLES) count = CAPTURE_EXPORT_MAX_SAMPLES;
+
+    // hex-encode the samples as they sit in memory (little endian)
+    size_t length = 0;
+    capture_flush_line[length++] = '$';
+    capture_flush_line[length++] = 'C';
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t* bytes = (uint8_t*) &capture_ring[(capture_export_next + i) % CAPTURE_MAX_SAMPLES];
+        for (size_t j = 0; j < sizeof(capture_sample_t); j++) {
+            capture_flush_line[length++] = hex[bytes[j] >> 4];
+            capture_flush_line[length++] = hex[bytes[j] & 0x0F];
+        }
+    }
+
+    capture_flush_line[length++] = '\n';
+    capture_flush_line[length] = 0;
+
+    fputs(capture_flush_line, stdout);
+
+    capture_export_next += count;
+    if (capture_export_next == capture_export_end) printf("capture: export done\n");
+}
+
+void capture_get_stats(capture_stats_t* stats) {
+    *stats = capture_stats;
+}
@@ -0,0 +1,107 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "config.h"
+
+// high rate capture of current, voltage and temperature, for watching the battery under load.
+// started from the usb console, it reads the three values every CAPTURE_INTERVAL into a ring of samples
+// that's set aside at build time. reads only go out in the gaps between the laptop's transactions
+// (see poll_schedule.h). a value the laptop read itself during a sample's slot is taken from its
+// reply instead, and a value that didn't fit into the slot is left out of the sample.
+//
+// sample format (12 bytes, little endian):
+//   offset 0   uint32  timestamp: microseconds since the capture started (start of the sample's slot)
+//   offset 4   int16   current in mA (BATT_CMD_CURRENT, negative = discharging)
+//   offset 6   uint16  voltage in mV (BATT_CMD_VOLTAGE)
+//   offset 8   uint16  temperature in 0.1 K (BATT_CMD_TEMPERATURE)
+//   offset 10  uint8   valid: CAPTURE_HAS_* bits for the values that are in the sample
+//   offset 11  uint8   snooped: CAPTURE_HAS_* bits for the values taken from the laptop's reads
+//
+// export format:
+//   like the bus trace (trace.h), samples go out over usb serial as text lines alongside the log output.
+//   each line is "$C" followed by one or more samples hex-encoded in byte order (24 hex chars per sample), then "\n".
+//   an export starts with the oldest sample still in the ring, so a gap in the timestamps at the
+//   beginning just means the ring wrapped.
+
+#define CAPTURE_MAX_SAMPLES 4096            // 48k of ram, about 2.7 min at the default interval
+#define CAPTURE_INTERVAL 40000              // time per sample in microseconds (25 Hz)
+#define CAPTURE_DURATION 150000000          // stops by itself after this long (2.5 min)
+#define CAPTURE_TEMPERATURE_DIVIDER 10      // temperature barely moves, only read it every nth sample
+#define CAPTURE_EXPORT_MAX_SAMPLES 16       // max samples sent per capture_flush() call
+
+#define CAPTURE_HAS_CURRENT (1 << 0)
+#define CAPTURE_HAS_VOLTAGE (1 << 1)
+#define CAPTURE_HAS_TEMPERATURE (1 << 2)
+
+
+#ifndef CAPTURE_SAMPLE_DEF
+#define CAPTURE_SAMPLE_DEF
+
+// part of the export format, don't reorder
+struct capture_sample {
+    uint32_t timestamp;
+    int16_t current;
+    uint16_t voltage;
+    uint16_t temperature;
+    uint8_t valid;
+    uint8_t snooped;
+};
+
+typedef struct capture_sample capture_sample_t;
+
+struct capture_stats {
+    unsigned long samples;          // samples put into the ring since the capture started
+    unsigned long reads;            // reads done by the capture
+    unsigned long snooped;          // values taken from the laptop's reads
+    unsigned long missed;           // values that didn't fit into their slot
+    unsigned long skipped_slots;    // whole slots lost because the main loop was held up
+};
+
+typedef struct capture_stats capture_stats_t;
+
+#endif
+
+
+// starts a new capture, the ring is cleared. only call from core0
+void capture_start();
+void capture_stop();
+bool capture_running();
+
+// runs the capture. call from the core0 main loop, doesn't block
+void capture_update();
+
+// called with every reply the laptop reads from the battery (see battery_stat_snoop_reply)
+void capture_snoop_reply(uint8_t cmd, uint8_t* reply, uint8_t length);
+
+// sends everything in the ring over usb serial in the background (see capture_flush).
+// works while a capture is running, samples that come in later aren't part of it
+void capture_export();
+
+// sends up to CAPTURE_EXPORT_MAX_SAMPLES of a running export.
+// call from core0 when nothing time critical is going on
+void capture_flush();
+
+void capture_get_stats(capture_stats_t* stats);
@@ -37,6 +37,8 @@
 #define BATT_I2C_ADDR 0x0b
 #define BATT_I2C_BAUD 32000
 #define BATT_I2C_TIMEOUT 200000          // in microseconds
+#define BATT_I2C_ASYNC true             // poll battery stats with dma transfers in the background instead of waiting on them
+#define BATT_POLL_SCHEDULE true         // only poll battery stats when the laptop isn't expected to use the bus (see poll_schedule.h)
 
 
 // i2c connected to laptop (as slave)
@@ -48,6 +50,24 @@
 #define LAPTOP_I2C_ADDR BATT_I2C_ADDR   // use the same address
 #define LAPTOP_I2C_BAUD BATT_I2C_BAUD   // use the same baud (for now)
 #define LAPTOP_I2C_TIMEOUT BATT_I2C_TIMEOUT
+// EXPERIMENTAL, never run on hardware. the cpu re-arms the pio at every start from an irq, so any time core0 has its
+// irqs off when the laptop starts a transfer loses the address and the whole transfer. needs FLASH_LOG off
+#define LAPTOP_I2C_PIO false            // use pio state machines instead of the i2c block (pio0 + pio1, scl must be sda + 1)
+
+
+// mitm
+#define MITM_REPLY_PREFETCH true        // read known replies from the battery all at once instead of byte by byte
+#define MITM_SNOOP_STATS true           // put battery replies the laptop reads into the stat cache instead of polling them again
+#define MITM_LATENCY_STATS true         // keep per command latency histograms (send 'l' over usb serial to dump them)
+
+
+// persistent log
+#define FLASH_LOG true                  // keep stat summaries and error counters in the last 512k of the flash (see flash_log.h)
+
+
+// usb serial logging
+#define LOG_LEVEL LOG_LEVEL_DEBUG       // LOG_LEVEL_DEBUG, LOG_LEVEL_INFO, LOG_LEVEL_ERROR or LOG_LEVEL_NONE
+#define BUS_TRACE true                  // stream a timestamped trace of all smbus traffic (see trace.h for the format)
 
 
 // spi display
@@ -61,6 +81,7 @@
 #define DISPLAY_RESET_PIN 5
 
 #define DISPLAY_FLIP_180 false
+#define DISPLAY_ASYNC_FLUSH true        // let dma send the frame in the background while the next one is drawn
 
 #define DISPLAY_BURN_SHIFT_MIN_INTERVAL 10000000    // microseconds
 #define DISPLAY_INACTIVITY_TIMEOUT 120000000         // microseconds
@@ -0,0 +1,217 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "console.h"
+#include "latency.h"
+#include "mitm.h"
+#include "battery.h"
+#include "poll_schedule.h"
+#include "capture.h"
+#include "history.h"
+#include "flash_log.h"
+#include "metrics.h"
+#include "display.h"
+#include "graphics.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+
+void console_print_mitm_stats() {
+    mitm_flow_stats_t stats;
+    mitm_get_flow_stats(&stats);
+
+    printf("mitm queue: high water %zu/%d, flow control engaged %lu times, %lu transactions dropped (%lu queued events flushed)\n",
+        stats.queue_high_water, MITM_QUEUE_MAX_ELEMENTS, stats.flow_control_count, stats.overflow_count, stats.discarded_events);
+
+    unsigned long pec_checked, pec_failed;
+    mitm_get_pec_stats(&pec_checked, &pec_failed);
+    printf("reply pec: %lu checked, %lu failed\n", pec_checked, pec_failed);
+
+    for (int cmd = 0; cmd < 256; cmd++) {
+        if (mitm_get_pec_failures(cmd) > 0) printf("  0x%02x: %lu bad pec\n", cmd, mitm_get_pec_failures(cmd));
+    }
+
+    unsigned long polled, snooped;
+    battery_get_poll_stats(&polled, &snooped);
+    printf("stat cache: %lu polled, %lu taken from the laptop's reads\n", polled, snooped);
+
+    int subscriptions;
+    unsigned long reads_per_minute;
+    battery_get_poll_demand(&subscriptions, &reads_per_minute);
+    printf("stat subscriptions: %d, asking for %lu reads/min\n", subscriptions, reads_per_minute);
+
+    for (int cmd = 0; cmd < 256; cmd++) {
+        battery_stat_t* batt_stat = battery_get_stat(cmd);
+        if (batt_stat == NULL || batt_stat->noise == BATTERY_STAT_FIXED) continue;
+        printf("  0x%02x (%s): read every %lu ms\n", cmd, batt_stat->friendly_name, (unsigned long) (batt_stat->period / 1000));
+    }
+
+    poll_schedule_stats_t schedule;
+    poll_schedule_get_stats(&schedule);
+    printf("poll schedule: %u laptop commands tracked, %lu reads started, %lu waited for a gap, %lu forced, %lu collided with the laptop\n",
+        schedule.tracked_commands, schedule.started, schedule.deferred, schedule.forced, schedule.collisions);
+
+    for (int cmd = 0; cmd < 256; cmd++) {
+        uint32_t period = poll_schedule_get_period(cmd);
+        if (period > 0) printf("  0x%02x: laptop reads every %lu ms\n", cmd, (unsigned long) (period / 1000));
+    }
+
+    capture_stats_t capture;
+    capture_get_stats(&capture);
+    printf("capture: %s, %lu samples, %lu reads, %lu values from the laptop, %lu missing, %lu slots skipped\n",
+        capture_running() ? "running" : "stopped", capture.samples, capture.reads, capture.snooped, capture.missed, capture.skipped_slots);
+}
+
+void console_print_history() {
+    const uint8_t cmds[] = {BATT_CMD_CURRENT, BATT_CMD_VOLTAGE, BATT_CMD_TEMPERATURE, BATT_CMD_RELATIVE_STATE_OF_CHARGE};
+    const uint32_t minutes[] = {5, 60, 6 * 60, 24 * 60, 48 * 60};
+    uint64_t now = time_us_64();
+
+    for (int i = 0; i < sizeof(cmds); i++) {
+        battery_stat_t* batt_stat = battery_get_stat(cmds[i]);
+        printf("0x%02x (%s):\n", cmds[i], batt_stat->friendly_name);
+
+        for (int j = 0; j < sizeof(minutes) / sizeof(minutes[0]); j++) {
+            uint64_t span = minutes[j] * HISTORY_MINUTE;
+            history_summary_t summary;
+
+            if (!history_summarize(cmds[i], now > span ? now - span : 0, now, &summary)) {
+                printf("  last %lu min: no readings\n", (unsigned long) minutes[j]);
+                continue;
+            }
+
+            printf("  last %lu min: min %d, mean %d, max %d (%lu readings)\n",
+                (unsigned long) minutes[j], summary.min, summary.mean, summary.max, (unsigned long) summary.count);
+        }
+    }
+}
+
+bool console_print_flash_log_record(flash_log_record_t* record, void* user_data) {
+    printf("  page %lu, boot %u, %lu s: type %u:", (unsigned long) record->sequence, record->boot, (unsigned long) record->time, record->type);
+    for (int i = 0; i < record->field_count; i++) printf(" %ld", (long) record->fields[i]);
+    printf("\n");
+    return true;
+}
+
+void console_print_flash_log() {
+    flash_log_stats_t stats;
+    flash_log_get_stats(&stats);
+
+    if (stats.disabled) {
+        printf("flash log: disabled, the firmware doesn't leave room for it\n");
+        return;
+    }
+
+    printf("flash log: boot %u, next page %lu, oldest page %lu, %lu pages written, %lu sectors erased, %lu records dropped, %lu writes failed, %lu waited for a gap\n",
+        stats.boot, (unsigned long) stats.next_sequence, (unsigned long) stats.oldest_sequence, (unsigned long) stats.pages_written,
+        (unsigned long) stats.sectors_erased, (unsigned long) stats.records_dropped, (unsigned long) stats.write_failures,
+        (unsigned long) stats.deferred);
+
+    flash_log_read(2, console_print_flash_log_record, NULL);
+}
+
+void console_print_session(const char* name, metrics_session_t* session) {
+    const char* directions[] = {"none", "charging", "discharging"};
+
+    printf("%s session: %s", name, directions[session->direction]);
+    if (session->direction == METRICS_IDLE) {
+        printf("\n");
+        return;
+    }
+
+    printf(", %lu s, %lu mAh, %lu mWh, peak %ld mW, %d%% -> %d%%\n", (unsigned long) session->duration, (unsigned long) session->charge,
+        (unsigned long) session->energy, (long) session->peak_power, session->start_charge, session->end_charge);
+}
+
+void console_print_metrics() {
+    metrics_t metrics;
+    metrics_read(&metrics);
+
+    if (metrics.has_power) printf("power: %ld mW\n", (long) metrics.power);
+    else printf("power: unknown\n");
+
+    printf("since boot: %lu mAh / %lu mWh in, %lu mAh / %lu mWh out\n", (unsigned long) metrics.charge_in,
+        (unsigned long) metrics.energy_in, (unsigned long) metrics.charge_out, (unsigned long) metrics.energy_out);
+
+    int wear = metrics.wear < 0 ? -metrics.wear : metrics.wear;
+    if (metrics.has_wear) printf("wear: %s%d.%d%%\n", metrics.wear < 0 ? "-" : "", wear / 10, wear % 10);
+    if (metrics.time_to_empty > 0) printf("empty in %lu min\n", (unsigned long) metrics.time_to_empty);
+    if (metrics.time_to_full > 0) printf("full in %lu min\n", (unsigned long) metrics.time_to_full);
+
+    console_print_session("current", &metrics.session);
+    console_print_session("last", &metrics.last_session);
+    printf("%lu sessions since boot\n", (unsigned long) metrics.session_count);
+}
+
+
+void console_poll() {
+    int c = getchar_timeout_us(0);
+    if (c == PICO_ERROR_TIMEOUT) return;
+
+    switch (c) {
+        case 'l':
+            latency_dump();
+            break;
+        case 'L':
+            latency_reset();
+            printf("latency histograms cleared\n");
+            break;
+        case 'm':
+            console_print_mitm_stats();
+            break;
+        case 'c':
+            if (capture_running()) capture_stop();
+            else capture_start();
+            break;
+        case 'x':
+            capture_export();
+            break;
+        case 'h':
+            console_print_history();
+            break;
+        case 'f':
+            console_print_flash_log();
+            break;
+        case 'p':
+            console_print_metrics();
+            break;
+        case 'd': {
+            display_refresh_stats_t stats;
+            display_get_refresh_stats(&stats);
+            printf("display: last refresh sent %lu pixels in %lu us, held up the gui for %lu us\n",
+                (unsigned long) stats.pixels, (unsigned long) stats.duration, (unsigned long) stats.blocked);
+            printf("  left to the panel: %lu filled, %lu copied, %lu already there (%lu fills, %lu copies since boot)\n",
+                (unsigned long) stats.filled, (unsigned long) stats.copied, (unsigned long) stats.skipped,
+                (unsigned long) stats.fill_commands, (unsigned long) stats.copy_commands);
+
+            graphics_render_stats_t render_stats;
+            graphics_get_render_stats(&render_stats);
+            printf("gui: %lu frames, last one redrew %lu regions and sent %lu pixels, %lu pixels per frame on average\n",
+                (unsigned long) render_stats.frames, (unsigned long) render_stats.regions, (unsigned long) render_stats.pixels,
+                (unsigned long) (render_stats.frames > 0 ? render_stats.total_pixels / render_stats.frames : 0));
+            break;
+        }
+        default:
+            break;
+    }
+}
@@ -0,0 +1,36 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+// single key commands over usb serial:
+//   l  dump the mitm latency histograms
+//   L  clear the mitm latency histograms
+//   m  print the mitm queue / flow control counters
+//   c  start/stop a high rate capture of current, voltage and temperature (see capture.h)
+//   x  export the capture over usb serial
+//   h  print min/mean/max of the stats with a history over the last few minutes, hours and days
+//   f  print the state of the flash log and its newest records
+//   p  print power, charge/energy counters, wear, time estimates and sessions (see metrics.h)
+//   d  print how long the last display refresh took and how many pixels the gui sends per frame
+
+// handles any pending command. doesn't block
+void console_poll();
@@ -45,19 +45,19 @@ void defused_aod_on_cancel_select() {}
 void defused_aod_on_select() {}
 bool defused_aod_on_select_held() { return false; }
 
-void aod_update_stats() {
-    battery_stat_request_update(aod_charge);
-    battery_stat_request_update(aod_voltage);
-    battery_stat_request_update(aod_current);
-    battery_stat_request_update(aod_remaining_capacity);
+void aod_subscribe_stats() {
+    defused_subscribe_stat(aod_charge);
+    defused_subscribe_stat(aod_voltage);
+    defused_subscribe_stat(aod_current);
+    defused_subscribe_stat(aod_remaining_capacity);
 }
 
-bool aod_print_stat_error(battery_stat_t* stat, g_text_box_t* text_box) {
-    if (battery_stat_is_expired(stat)) {
+bool aod_print_stat_error(battery_stat_snapshot_t* stat, g_text_box_t* text_box) {
+    if (battery_snapshot_is_expired(stat)) {
         text_box->color = COLOR_GRAY;
         g_text_box_print(text_box, "...");
         return true;
-    } else if (battery_stat_is_error(stat)) {
+    } else if (battery_snapshot_is_error(stat)) {
         text_box->color = COLOR_RED;
         g_text_box_print(text_box, "error");
         return true;
@@ -68,36 +68,33 @@ bool aod_print_stat_error(battery_stat_t* stat, g_text_box_t* text_box) {
 void defused_aod_update_display() {
 
 
-    battery_stat_lock();
+    battery_stat_snapshot_t charge_stat, remaining_capacity_stat, voltage_stat, current_stat;
+    battery_stat_read(aod_charge, &charge_stat);
+    battery_stat_read(aod_remaining_capacity, &remaining_capacity_stat);
+    battery_stat_read(aod_voltage, &voltage_stat);
+    battery_stat_read(aod_current, &current_stat);
 
-    if (!defused_print_batt_stat_error(aod_charge_text, aod_charge, COLOR_WHITE, "--%", "ERR%")) {
+    if (!defused_print_batt_stat_error(aod_charge_text, &charge_stat, COLOR_WHITE, "--%", "ERR%")) {
         g_text_box_printf(aod_charge_text, 
-            "%d%%", *aod_charge->cached_result.as_uint16);
+            "%d%%", *charge_stat.cached_result.as_uint16);
     }
     
-    if (!defused_print_batt_stat_error(aod_remaining_capacity_text, aod_remaining_capacity, COLOR_GRAY, "--.-- Wh", "error")) {
+    if (!defused_print_batt_stat_error(aod_remaining_capacity_text, &remaining_capacity_stat, COLOR_GRAY, "--.-- Wh", "error")) {
         aod_remaining_capacity_text->color = COLOR_GRAY;
-        g_text_box_printf(aod_remaining_capacity_text, 
-            "%.2f Wh", (*aod_remaining_capacity->cached_result.as_uint16) / 100.0);
+        defused_print_fixed(aod_remaining_capacity_text, *remaining_capacity_stat.cached_result.as_uint16, 100, 2, false, " Wh");
     }
 
-    if (!defused_print_batt_stat_error(aod_voltage_text, aod_voltage, COLOR_GREEN, "--.-- V", "error")) {
-        g_text_box_printf(aod_voltage_text, 
-            "%.2f V", (*aod_voltage->cached_result.as_uint16) / 1000.0);
+    if (!defused_print_batt_stat_error(aod_voltage_text, &voltage_stat, COLOR_GREEN, "--.-- V", "error")) {
+        defused_print_fixed(aod_voltage_text, *voltage_stat.cached_result.as_uint16, 1000, 2, false, " V");
     }
 
-    if (!defused_print_batt_stat_error(aod_current_text, aod_current, COLOR_RED, "--.-- A", "error")) {
-        g_text_box_printf(aod_current_text, 
-            "%+.2f A", (*aod_current->cached_result.as_int16) / 1000.0);
+    if (!defused_print_batt_stat_error(aod_current_text, &current_stat, COLOR_RED, "--.-- A", "error")) {
+        defused_print_fixed(aod_current_text, *current_stat.cached_result.as_int16, 1000, 2, true, " A");
     }
 
-    battery_stat_unlock();
-
 
     graphics_render();
     display_burn_update(true);
-
-    aod_update_stats();
 }
 
 void defused_aod_init() {
@@ -108,7 +105,7 @@ void defused_aod_init() {
     aod_current = battery_get_stat(BATT_CMD_CURRENT);
     aod_remaining_capacity = battery_get_stat(BATT_CMD_REMAINING_CAPACITY);
     
-    aod_update_stats();
+    aod_subscribe_stats();
     
     graphics_reset();
     
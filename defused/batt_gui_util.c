@@ -23,18 +23,41 @@
  */
 #include "defused/batt_gui_util.h"
 #include "display.h"
+#include <stdio.h>
 
 
-bool defused_print_batt_stat_error(g_text_box_t* text_box, battery_stat_t* stat, color_t color, char* loading_text, char* error_text) {
-    if (battery_stat_is_expired(stat)) {
+bool defused_print_batt_stat_error(g_text_box_t* text_box, battery_stat_snapshot_t* stat, color_t color, char* loading_text, char* error_text) {
+    if (battery_snapshot_is_expired(stat)) {
         text_box->color = COLOR_GRAY;
         g_text_box_print(text_box, loading_text);
         return true;
-    } else if (battery_stat_is_error(stat)) {
+    } else if (battery_snapshot_is_error(stat)) {
         text_box->color = COLOR_RED;
         g_text_box_print(text_box, error_text);
         return true;
     }
     text_box->color = color;
     return false;
-}
\ No newline at end of file
+}
+
+void defused_format_fixed(char* buffer, size_t size, int32_t value, int32_t scale, int decimals, bool show_sign) {
+    int32_t step = scale;
+    uint32_t factor = 1;
+    for (int i = 0; i < decimals; i++) {
+        step /= 10;
+        factor *= 10;
+    }
+
+    uint32_t magnitude = value < 0 ? -value : value;
+    uint32_t rounded = (magnitude + step / 2) / step;
+    char* sign = value < 0 && rounded > 0 ? "-" : show_sign ? "+" : "";
+
+    if (decimals == 0) snprintf(buffer, size, "%s%lu", sign, (unsigned long) rounded);
+    else snprintf(buffer, size, "%s%lu.%0*lu", sign, (unsigned long) (rounded / factor), decimals, (unsigned long) (rounded % factor));
+}
+
+void defused_print_fixed(g_text_box_t* text_box, int32_t value, int32_t scale, int decimals, bool show_sign, char* unit) {
+    char number[16];
+    defused_format_fixed(number, sizeof(number), value, scale, decimals, show_sign);
+    g_text_box_printf(text_box, "%s%s", number, unit);
+}
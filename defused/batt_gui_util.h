@@ -24,4 +24,11 @@
 #include "battery.h"
 #include "graphics.h"
 
-bool defused_print_batt_stat_error(g_text_box_t* text_box, battery_stat_t* stat, color_t color, char* loading_text, char* error_text);
\ No newline at end of file
+bool defused_print_batt_stat_error(g_text_box_t* text_box, battery_stat_snapshot_t* stat, color_t color, char* loading_text, char* error_text);
+
+// formats value / scale with the given number of decimals (rounded), without floats.
+// scale has to be a power of 10 with at least that many zeros, e.g. mV -> "12.34" is (12345, 1000, 2)
+void defused_format_fixed(char* buffer, size_t size, int32_t value, int32_t scale, int decimals, bool show_sign);
+
+// same, printed into the text box with the unit after it
+void defused_print_fixed(g_text_box_t* text_box, int32_t value, int32_t scale, int decimals, bool show_sign, char* unit);
\ No newline at end of file
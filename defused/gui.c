@@ -26,6 +26,8 @@
 #include "display.h"
 #include "config.h"
 #include "graphics.h"
+#include "battery.h"
+#include "pico/flash.h"
 
 #include "defused/aod.h"
 #include "defused/stat_browser.h"
@@ -44,6 +46,10 @@ uint8_t defused_contrast_current = DISPLAY_CONTRAST;
 uint8_t defused_contrast_target = DISPLAY_CONTRAST;
 uint64_t defused_contrast_last_attenuated = 0;
 
+// stat subscriptions of the bound menu
+battery_subscription_t defused_subscriptions[DEFUSED_MAX_SUBSCRIPTIONS];
+size_t defused_subscription_count = 0;
+
 // display updates
 uint64_t defused_last_display_update = 0;
 bool defused_force_display_update = false;
@@ -129,7 +135,21 @@ void defused_update_display_now() {
     defused_force_display_update = true;
 }
 
+void defused_subscribe_stat(struct battery_stat* stat) {
+    if (defused_subscription_count >= DEFUSED_MAX_SUBSCRIPTIONS) return;
+
+    battery_subscription_t subscription = battery_stat_subscribe(stat, 0);
+    if (subscription < 0) return;
+    defused_subscriptions[defused_subscription_count++] = subscription;
+}
+
 void defused_bind(menu_binding_t* binding) {
+    // the new menu subscribes to what it shows in init
+    for (size_t i = 0; i < defused_subscription_count; i++) {
+        battery_stat_unsubscribe(defused_subscriptions[i]);
+    }
+    defused_subscription_count = 0;
+
     defused_current_binding = binding;
     display_set_burn_limits(binding->burn_margin_x, binding->burn_margin_y);
     defused_current_binding->init();
@@ -187,6 +207,9 @@ void defused_loop() {
 }
 
 void init_gui() {
+    // core0 pauses this core while it writes the flash (see flash_log.h)
+    flash_safe_execute_core_init();
+
     init_button();
     init_display();
     init_graphics();
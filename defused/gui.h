@@ -24,6 +24,7 @@
 // the gui is codename "defused" because I think it's funny
 
 #define DISPLAY_CONTRAST_ATTENUATION_INTERVAL 5000      // in microseconds
+#define DEFUSED_MAX_SUBSCRIPTIONS 16
 
 
 #ifndef MENU_BINDING_DEF
@@ -62,6 +63,11 @@ void defused_update_display_now();
 
 void defused_bind(menu_binding_t* binding);
 
+// subscribes to a stat for the bound menu (with the stat's valid_for as max age), call it in the menu's init.
+// the subscriptions are dropped when the next menu gets bound
+struct battery_stat;
+void defused_subscribe_stat(struct battery_stat* stat);
+
 bool defused_enter_inactive_mode();
 bool defused_exit_inactive_mode();
 
@@ -24,6 +24,7 @@
 #include "defused/stat_browser.h"
 #include "graphics.h"
 #include "display.h"
+#include "config.h"
 #include <stdlib.h>
 
 #include "defused/main_menu.h"
@@ -32,6 +33,8 @@
 #include "defused/stat_page/health_info.h"
 #include "defused/stat_page/cell_voltage_info.h"
 #include "defused/stat_page/manufacture_info.h"
+#include "defused/stat_page/latency_info.h"
+#include "defused/stat_page/trend_info.h"
 
 g_text_box_t* stat_browser_page_number_text;
 g_text_box_t* stat_browser_page_title_text;
@@ -56,6 +59,11 @@ stat_browser_page_t stat_browser_page_defs[] = {
         update_display: &defused_stat_page_health_info_update,
         init: &defused_stat_page_health_info_init,
     },
+    (stat_browser_page_t){
+        title: "trends",
+        update_display: &defused_stat_page_trend_info_update,
+        init: &defused_stat_page_trend_info_init,
+    },
 #ifdef CELL_VOLTAGE_INFO_AVAILABLE 
     (stat_browser_page_t){
         title: "cell voltage",
@@ -68,6 +76,13 @@ stat_browser_page_t stat_browser_page_defs[] = {
         update_display: &defused_stat_page_manufacture_info_update,
         init: &defused_stat_page_manufacture_info_init,
     },
+#if MITM_LATENCY_STATS
+    (stat_browser_page_t){
+        title: "mitm latency",
+        update_display: &defused_stat_page_latency_info_update,
+        init: &defused_stat_page_latency_info_init,
+    },
+#endif
 };
 
 
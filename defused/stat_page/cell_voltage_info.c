@@ -34,7 +34,7 @@ battery_stat_t* stat_page_cell_voltage_mf_data;
 void defused_stat_page_cell_voltage_info_init() {
     stat_page_cell_voltage_mf_data = battery_get_stat(BATT_CMD_MANUFACTURER_DATA);
     
-    battery_stat_request_update(stat_page_cell_voltage_mf_data);
+    defused_subscribe_stat(stat_page_cell_voltage_mf_data);
     
     for (uint i = 0; i < CELL_VOLTAGE_INFO_CELL_COUNT; i++) {
         stat_page_cell_voltage_label_texts[i] = get_g_text_box_inst();
@@ -65,20 +65,19 @@ void defused_stat_page_cell_voltage_info_init() {
 }
 
 void defused_stat_page_cell_voltage_info_update() {
-    battery_stat_request_update(stat_page_cell_voltage_mf_data);
-    
 #ifdef LENOVO_CELL_VOLTAGES
 
-    battery_stat_lock();
+    battery_stat_snapshot_t mf_data_stat;
+    battery_stat_read(stat_page_cell_voltage_mf_data, &mf_data_stat);
     
     g_text_box_t* value_text;
-    uint16_t* mf_data = stat_page_cell_voltage_mf_data->cached_result.as_uint16;
+    uint16_t* mf_data = mf_data_stat.cached_result.as_uint16;
     uint16_t cell_voltage;
 
     for (uint i = 0; i < CELL_VOLTAGE_INFO_CELL_COUNT; i++) {
         value_text = stat_page_cell_voltage_value_texts[i];
-        if (defused_print_batt_stat_error(value_text, stat_page_cell_voltage_mf_data, COLOR_BLUE, "-.--- V", "error")) continue;
-        if (stat_page_cell_voltage_mf_data->result_length != 14) {
+        if (defused_print_batt_stat_error(value_text, &mf_data_stat, COLOR_BLUE, "-.--- V", "error")) continue;
+        if (mf_data_stat.result_length != 14) {
             value_text->color = COLOR_RED;
             g_text_box_print(value_text, "invalid");
             continue;
@@ -86,10 +85,8 @@ void defused_stat_page_cell_voltage_info_update() {
         
         cell_voltage = mf_data[2 + i];
 
-        g_text_box_printf(value_text, "%.3f V", cell_voltage / 1000.0);
+        defused_print_fixed(value_text, cell_voltage, 1000, 3, false, " V");
     }
 
-    battery_stat_unlock();
-
 #endif
 }
@@ -25,6 +25,7 @@
 #include "defused/batt_gui_util.h"
 #include "defused/gui.h"
 #include "display.h"
+#include "metrics.h"
 
 g_text_box_t* stat_page_general_charge_text;
 g_text_box_t* stat_page_general_max_error_text;
@@ -51,12 +52,12 @@ void defused_stat_page_general_info_init() {
     stat_page_general_temperature = battery_get_stat(BATT_CMD_TEMPERATURE);
     stat_page_general_remaining_capacity = battery_get_stat(BATT_CMD_REMAINING_CAPACITY);
 
-    battery_stat_request_update(stat_page_general_charge);
-    battery_stat_request_update(stat_page_general_max_error);
-    battery_stat_request_update(stat_page_general_voltage);
-    battery_stat_request_update(stat_page_general_current);
-    battery_stat_request_update(stat_page_general_temperature);
-    battery_stat_request_update(stat_page_general_remaining_capacity);
+    defused_subscribe_stat(stat_page_general_charge);
+    defused_subscribe_stat(stat_page_general_max_error);
+    defused_subscribe_stat(stat_page_general_voltage);
+    defused_subscribe_stat(stat_page_general_current);
+    defused_subscribe_stat(stat_page_general_temperature);
+    defused_subscribe_stat(stat_page_general_remaining_capacity);
     
     stat_page_general_charge_text = get_g_text_box_inst();
     stat_page_general_max_error_text = get_g_text_box_inst();
@@ -143,20 +144,18 @@ void defused_stat_page_general_info_init() {
 
 void defused_stat_page_general_info_update() {
     uint16_t max_error;
-    float voltage;
-    float current;
-    battery_stat_request_update(stat_page_general_charge);
-    battery_stat_request_update(stat_page_general_max_error);
-    battery_stat_request_update(stat_page_general_voltage);
-    battery_stat_request_update(stat_page_general_current);
-    battery_stat_request_update(stat_page_general_temperature);
-    battery_stat_request_update(stat_page_general_remaining_capacity);
-    
-    
-    battery_stat_lock();
-
-    if (battery_stat_is_valid(stat_page_general_max_error)) {
-        max_error = *stat_page_general_max_error->cached_result.as_uint16;
+    metrics_t metrics;
+
+    battery_stat_snapshot_t max_error_stat, charge_stat, remaining_capacity_stat, voltage_stat, current_stat, temperature_stat;
+    battery_stat_read(stat_page_general_max_error, &max_error_stat);
+    battery_stat_read(stat_page_general_charge, &charge_stat);
+    battery_stat_read(stat_page_general_remaining_capacity, &remaining_capacity_stat);
+    battery_stat_read(stat_page_general_voltage, &voltage_stat);
+    battery_stat_read(stat_page_general_current, &current_stat);
+    battery_stat_read(stat_page_general_temperature, &temperature_stat);
+
+    if (battery_snapshot_is_valid(&max_error_stat)) {
+        max_error = *max_error_stat.cached_result.as_uint16;
     } else {
         max_error = 0;
     }
@@ -170,42 +169,36 @@ void defused_stat_page_general_info_update() {
     }
 
     // battery %
-    if (!defused_print_batt_stat_error(stat_page_general_charge_text, stat_page_general_charge, COLOR_WHITE, "--%", "ERR%")) {
+    if (!defused_print_batt_stat_error(stat_page_general_charge_text, &charge_stat, COLOR_WHITE, "--%", "ERR%")) {
         g_text_box_printf(stat_page_general_charge_text, 
-            "%d%%", (*stat_page_general_charge->cached_result.as_uint16) + (max_error / 2));
+            "%d%%", (*charge_stat.cached_result.as_uint16) + (max_error / 2));
     }
 
     // battery remaining capacity
-    if (!defused_print_batt_stat_error(stat_page_general_remaining_capacity_text, stat_page_general_remaining_capacity, COLOR_GRAY, "--.-- Wh", "error")) {
-        g_text_box_printf(stat_page_general_remaining_capacity_text, 
-            "%.2f Wh", (*stat_page_general_remaining_capacity->cached_result.as_uint16) / 100.0);
+    if (!defused_print_batt_stat_error(stat_page_general_remaining_capacity_text, &remaining_capacity_stat, COLOR_GRAY, "--.-- Wh", "error")) {
+        defused_print_fixed(stat_page_general_remaining_capacity_text, *remaining_capacity_stat.cached_result.as_uint16, 100, 2, false, " Wh");
     }
 
     // battery voltage
-    if (!defused_print_batt_stat_error(stat_page_general_voltage_text, stat_page_general_voltage, COLOR_GREEN, "--.-- V", "error")) {
-        voltage = (*stat_page_general_voltage->cached_result.as_uint16) / 1000.0;
-        g_text_box_printf(stat_page_general_voltage_text, "%.2f V", voltage);
+    if (!defused_print_batt_stat_error(stat_page_general_voltage_text, &voltage_stat, COLOR_GREEN, "--.-- V", "error")) {
+        defused_print_fixed(stat_page_general_voltage_text, *voltage_stat.cached_result.as_uint16, 1000, 2, false, " V");
     }
     
     // battery current
-    if (!defused_print_batt_stat_error(stat_page_general_current_text, stat_page_general_current, COLOR_RED, "--.-- A", "error")) {
-        current = (*stat_page_general_current->cached_result.as_int16) / 1000.0;
-        g_text_box_printf(stat_page_general_current_text, "%+.2f A", current);
+    if (!defused_print_batt_stat_error(stat_page_general_current_text, &current_stat, COLOR_RED, "--.-- A", "error")) {
+        defused_print_fixed(stat_page_general_current_text, *current_stat.cached_result.as_int16, 1000, 2, true, " A");
     }
     
     // battery temperature
-    if (!defused_print_batt_stat_error(stat_page_general_temperature_text, stat_page_general_temperature, COLOR_BLUE, "---.- K", "error")) {
-        g_text_box_printf(stat_page_general_temperature_text, 
-            "%.1f K", (*stat_page_general_temperature->cached_result.as_uint16) / 10.0);
+    if (!defused_print_batt_stat_error(stat_page_general_temperature_text, &temperature_stat, COLOR_BLUE, "---.- K", "error")) {
+        defused_print_fixed(stat_page_general_temperature_text, *temperature_stat.cached_result.as_uint16, 10, 1, false, " K");
     }
     
     // wattage
-    if (!battery_stat_is_valid(stat_page_general_voltage) || !battery_stat_is_valid(stat_page_general_current)) {
+    metrics_read(&metrics);
+    if (!battery_snapshot_is_valid(&voltage_stat) || !battery_snapshot_is_valid(&current_stat) || !metrics.has_power) {
         g_text_box_printf(stat_page_general_wattage_text, "--.- W");
     } else {
-        g_text_box_printf(stat_page_general_wattage_text, 
-            "%+.1f W", voltage * current);
+        defused_print_fixed(stat_page_general_wattage_text, metrics.power, 1000, 1, true, " W");
     }
-
-    battery_stat_unlock();
 }
\ No newline at end of file
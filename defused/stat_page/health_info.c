@@ -25,6 +25,7 @@
 #include "defused/batt_gui_util.h"
 #include "defused/gui.h"
 #include "display.h"
+#include "metrics.h"
 
 g_text_box_t* stat_page_health_capacity_ratio_text;
 g_text_box_t* stat_page_health_wear_label_text;
@@ -79,12 +80,13 @@ health_verdict_t* health_info_verdicts_cycle_wear_matrix[6][6] = {
 /* >1500  */{   &VERDICT_CALIBRATE, &VERDICT_CALIBRATE, &VERDICT_LUCK,      &VERDICT_GOOD,      &VERDICT_WORN,      &VERDICT_EOL            },
 };
 
-uint health_info_get_wear_verdict_index(float calculated_wear) {
-    if (calculated_wear < -10) return 0;          // likely very mis-calibrated
-    else if (calculated_wear <= 10) return 1;
-    else if (calculated_wear <= 20) return 2;
-    else if (calculated_wear <= 30) return 3;
-    else if (calculated_wear <= 40) return 4;
+// wear in 0.1 %
+uint health_info_get_wear_verdict_index(int16_t wear) {
+    if (wear < -100) return 0;          // likely very mis-calibrated
+    else if (wear <= 100) return 1;
+    else if (wear <= 200) return 2;
+    else if (wear <= 300) return 3;
+    else if (wear <= 400) return 4;
     else return 5;
 }
 
@@ -102,10 +104,10 @@ void defused_stat_page_health_info_init() {
     stat_page_health_design_capacity = battery_get_stat(BATT_CMD_DESIGN_CAPACITY);
     stat_page_health_cycle_count = battery_get_stat(BATT_CMD_CYCLE_COUNT);
 
-    battery_stat_request_update(stat_page_health_temperature);
-    battery_stat_request_update(stat_page_health_full_capacity);
-    battery_stat_request_update(stat_page_health_design_capacity);
-    battery_stat_request_update(stat_page_health_cycle_count);
+    defused_subscribe_stat(stat_page_health_temperature);
+    defused_subscribe_stat(stat_page_health_full_capacity);
+    defused_subscribe_stat(stat_page_health_design_capacity);
+    defused_subscribe_stat(stat_page_health_cycle_count);
 
     stat_page_health_capacity_ratio_text = get_g_text_box_inst();
     stat_page_health_wear_label_text = get_g_text_box_inst();
@@ -187,10 +189,11 @@ void defused_stat_page_health_info_init() {
 }
 
 void defused_stat_page_health_info_update() {
-    float full_capacity;
-    float design_capacity;
+    char full_capacity[16];
+    char design_capacity[16];
+    char wear[16];
+    metrics_t metrics;
 
-    float calculated_wear;
     uint wear_verdict_i = 0;
 
     uint16_t cycle_count;
@@ -198,21 +201,20 @@ void defused_stat_page_health_info_update() {
     
     health_verdict_t* grand_verdict;
 
-    battery_stat_request_update(stat_page_health_temperature);
-    battery_stat_request_update(stat_page_health_full_capacity);
-    battery_stat_request_update(stat_page_health_design_capacity);
-    battery_stat_request_update(stat_page_health_cycle_count);
-
-
-    battery_stat_lock();
+    battery_stat_snapshot_t full_capacity_stat, design_capacity_stat, cycle_count_stat, temperature_stat;
+    battery_stat_read(stat_page_health_full_capacity, &full_capacity_stat);
+    battery_stat_read(stat_page_health_design_capacity, &design_capacity_stat);
+    battery_stat_read(stat_page_health_cycle_count, &cycle_count_stat);
+    battery_stat_read(stat_page_health_temperature, &temperature_stat);
+    metrics_read(&metrics);
 
     // capacity ratio + health
-    if (battery_stat_is_expired(stat_page_health_full_capacity) || battery_stat_is_expired(stat_page_health_design_capacity)) {
+    if (battery_snapshot_is_expired(&full_capacity_stat) || battery_snapshot_is_expired(&design_capacity_stat) || !metrics.has_wear) {
         stat_page_health_capacity_ratio_text->color = COLOR_GRAY;
         g_text_box_print(stat_page_health_capacity_ratio_text, "--.-/--.- Wh");
         stat_page_health_wear_text->color = COLOR_GRAY;
         g_text_box_print(stat_page_health_wear_text, "--.-%");
-    } else if (battery_stat_is_error(stat_page_health_full_capacity) || battery_stat_is_error(stat_page_health_design_capacity)) {
+    } else if (battery_snapshot_is_error(&full_capacity_stat) || battery_snapshot_is_error(&design_capacity_stat)) {
         stat_page_health_capacity_ratio_text->color = COLOR_RED;
         g_text_box_print(stat_page_health_capacity_ratio_text, "error");
         stat_page_health_wear_text->color = COLOR_RED;
@@ -220,26 +222,26 @@ void defused_stat_page_health_info_update() {
     } else {
         
         // capacity ratio
-        full_capacity = (*stat_page_health_full_capacity->cached_result.as_uint16) / 100.0;
-        design_capacity = (*stat_page_health_design_capacity->cached_result.as_uint16) / 100.0;
+        defused_format_fixed(full_capacity, sizeof(full_capacity), *full_capacity_stat.cached_result.as_uint16, 100, 1, false);
+        defused_format_fixed(design_capacity, sizeof(design_capacity), *design_capacity_stat.cached_result.as_uint16, 100, 1, false);
         stat_page_health_capacity_ratio_text->color = COLOR_GRAY;
         g_text_box_printf(stat_page_health_capacity_ratio_text,
-            "%.1f/%.1f Wh", full_capacity, design_capacity);
+            "%s/%s Wh", full_capacity, design_capacity);
         
         // wear %
-        calculated_wear = 100 - (100 * full_capacity / design_capacity);
-        wear_verdict_i = health_info_get_wear_verdict_index(calculated_wear);
+        wear_verdict_i = health_info_get_wear_verdict_index(metrics.wear);
+        defused_format_fixed(wear, sizeof(wear), metrics.wear, 10, 0, false);
 
         stat_page_health_wear_text->color = health_info_verdicts_single_dimensional[wear_verdict_i]->color;
         g_text_box_printf(stat_page_health_wear_text,
-            "%.0f%% %s", calculated_wear, health_info_verdicts_single_dimensional[wear_verdict_i]->text);
+            "%s%% %s", wear, health_info_verdicts_single_dimensional[wear_verdict_i]->text);
 
     }
     
     // cycle count
-    if (!defused_print_batt_stat_error(stat_page_health_cycle_count_text, stat_page_health_cycle_count, COLOR_GRAY, "---", "error")) {
+    if (!defused_print_batt_stat_error(stat_page_health_cycle_count_text, &cycle_count_stat, COLOR_GRAY, "---", "error")) {
 
-        cycle_count = *stat_page_health_cycle_count->cached_result.as_uint16;
+        cycle_count = *cycle_count_stat.cached_result.as_uint16;
         cycle_verdict_i = health_info_get_cycle_verdict_index(cycle_count);
         
         stat_page_health_cycle_count_text->color = health_info_verdicts_single_dimensional[cycle_verdict_i]->color;
@@ -248,13 +250,12 @@ void defused_stat_page_health_info_update() {
     }
     
     // temperature
-    if (!defused_print_batt_stat_error(stat_page_health_temperature_text, stat_page_health_temperature, COLOR_BLUE, "---.- K", "error")) {
-        g_text_box_printf(stat_page_health_temperature_text, 
-            "%.1f K", (*stat_page_health_temperature->cached_result.as_uint16) / 10.0);
+    if (!defused_print_batt_stat_error(stat_page_health_temperature_text, &temperature_stat, COLOR_BLUE, "---.- K", "error")) {
+        defused_print_fixed(stat_page_health_temperature_text, *temperature_stat.cached_result.as_uint16, 10, 1, false, " K");
     }
     
     // grand verdict (doesn't take temp into account)
-    if (!battery_stat_is_valid(stat_page_health_full_capacity) || !battery_stat_is_valid(stat_page_health_design_capacity) || !battery_stat_is_valid(stat_page_health_cycle_count)) {
+    if (!battery_snapshot_is_valid(&full_capacity_stat) || !battery_snapshot_is_valid(&design_capacity_stat) || !battery_snapshot_is_valid(&cycle_count_stat)) {
         grand_verdict = &VERDICT_UNKNOWN;
     } else {
         grand_verdict = health_info_verdicts_cycle_wear_matrix[cycle_verdict_i][wear_verdict_i];
@@ -262,6 +263,4 @@ void defused_stat_page_health_info_update() {
 
     stat_page_health_verdict_text->color = grand_verdict->color;
     g_text_box_print(stat_page_health_verdict_text, grand_verdict->text);
-
-    battery_stat_unlock();
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "defused/stat_page/latency_info.h"
+#include "defused/gui.h"
+#include "graphics.h"
+#include "display.h"
+#include "latency.h"
+
+// shows the commands that made the laptop wait the longest (turnaround latency, see latency.h)
+
+#define LATENCY_INFO_ROWS 3
+
+g_text_box_t* stat_page_latency_header_text;
+g_text_box_t* stat_page_latency_row_texts[LATENCY_INFO_ROWS];
+
+
+void defused_stat_page_latency_info_init() {
+    stat_page_latency_header_text = get_g_text_box_inst();
+    for (uint i = 0; i < LATENCY_INFO_ROWS; i++) {
+        stat_page_latency_row_texts[i] = get_g_text_box_inst();
+    }
+
+
+    // layout
+    coord_t line_spacing = 3;
+    coord_t y = 0;
+
+    setup_g_text_box(stat_page_latency_header_text, 0, y, display_area_width() - 1, 1, COLOR_GRAY);
+    g_text_box_print(stat_page_latency_header_text, "cmd  p50   max");
+    y += g_text_box_height(stat_page_latency_header_text) + line_spacing;
+
+    for (uint i = 0; i < LATENCY_INFO_ROWS; i++) {
+        setup_g_text_box(stat_page_latency_row_texts[i], 0, y, display_area_width() - 1, 1, COLOR_WHITE);
+        y += g_text_box_height(stat_page_latency_row_texts[i]) + line_spacing;
+
+        graphics_add_text_box(stat_page_latency_row_texts[i]);
+    }
+
+    graphics_add_text_box(stat_page_latency_header_text);
+}
+
+void defused_stat_page_latency_info_update() {
+    int row_cmds[LATENCY_INFO_ROWS];
+    int row_max_buckets[LATENCY_INFO_ROWS];
+    char p50_text[8];
+    char max_text[8];
+
+    for (uint i = 0; i < LATENCY_INFO_ROWS; i++) {
+        row_cmds[i] = -1;
+        row_max_buckets[i] = -1;
+    }
+
+    // find the slowest commands by worst case
+    for (int cmd = 0; cmd < 256; cmd++) {
+        int max_bucket = latency_get_percentile_bucket(LATENCY_TURNAROUND, cmd, 100);
+        if (max_bucket < 0) continue;
+
+        for (uint i = 0; i < LATENCY_INFO_ROWS; i++) {
+            if (max_bucket <= row_max_buckets[i]) continue;
+
+            // shift the slower ones down
+            for (uint j = LATENCY_INFO_ROWS - 1; j > i; j--) {
+                row_cmds[j] = row_cmds[j - 1];
+                row_max_buckets[j] = row_max_buckets[j - 1];
+            }
+            row_cmds[i] = cmd;
+            row_max_buckets[i] = max_bucket;
+            break;
+        }
+    }
+
+    for (uint i = 0; i < LATENCY_INFO_ROWS; i++) {
+        g_text_box_t* row_text = stat_page_latency_row_texts[i];
+
+        if (row_cmds[i] < 0) {
+            row_text->color = COLOR_GRAY;
+            g_text_box_print(row_text, i == 0 ? "no data" : "");
+            continue;
+        }
+
+        latency_format_bucket(latency_get_percentile_bucket(LATENCY_TURNAROUND, row_cmds[i], 50), p50_text, sizeof(p50_text));
+        latency_format_bucket(row_max_buckets[i], max_text, sizeof(max_text));
+
+        row_text->color = COLOR_WHITE;
+        g_text_box_printf(row_text, "%02x %5s %5s", row_cmds[i], p50_text, max_text);
+    }
+}
@@ -52,11 +52,11 @@ void defused_stat_page_manufacture_info_init() {
     stat_page_manufacture_chemistry = battery_get_stat(BATT_CMD_DEVICE_CHEMISTRY);
     stat_page_manufacture_serial = battery_get_stat(BATT_CMD_SERIAL_NUMBER);
 
-    battery_stat_request_update(stat_page_manufacture_mf_name);
-    battery_stat_request_update(stat_page_manufacture_dev_name);
-    battery_stat_request_update(stat_page_manufacture_date);
-    battery_stat_request_update(stat_page_manufacture_chemistry);
-    battery_stat_request_update(stat_page_manufacture_serial);
+    defused_subscribe_stat(stat_page_manufacture_mf_name);
+    defused_subscribe_stat(stat_page_manufacture_dev_name);
+    defused_subscribe_stat(stat_page_manufacture_date);
+    defused_subscribe_stat(stat_page_manufacture_chemistry);
+    defused_subscribe_stat(stat_page_manufacture_serial);
 
 
     stat_page_manufacture_mf_name_label_text = get_g_text_box_inst();
@@ -145,45 +145,41 @@ void defused_stat_page_manufacture_info_init() {
 void defused_stat_page_manufacture_info_update() {
     uint16_t date;
 
-    battery_stat_request_update(stat_page_manufacture_mf_name);
-    battery_stat_request_update(stat_page_manufacture_dev_name);
-    battery_stat_request_update(stat_page_manufacture_date);
-    battery_stat_request_update(stat_page_manufacture_chemistry);
-    battery_stat_request_update(stat_page_manufacture_serial);
-
-
-    battery_stat_lock();
+    battery_stat_snapshot_t mf_name_stat, dev_name_stat, serial_stat, chemistry_stat, date_stat;
+    battery_stat_read(stat_page_manufacture_mf_name, &mf_name_stat);
+    battery_stat_read(stat_page_manufacture_dev_name, &dev_name_stat);
+    battery_stat_read(stat_page_manufacture_serial, &serial_stat);
+    battery_stat_read(stat_page_manufacture_chemistry, &chemistry_stat);
+    battery_stat_read(stat_page_manufacture_date, &date_stat);
 
     // manufacturer name
-    if (!defused_print_batt_stat_error(stat_page_manufacture_mf_name_text, stat_page_manufacture_mf_name, COLOR_GRAY, "...", "error")) {
+    if (!defused_print_batt_stat_error(stat_page_manufacture_mf_name_text, &mf_name_stat, COLOR_GRAY, "...", "error")) {
         g_text_box_printf(stat_page_manufacture_mf_name_text,
-            "%.*s", stat_page_manufacture_mf_name->result_length, stat_page_manufacture_mf_name->cached_result.as_uint8);
+            "%.*s", mf_name_stat.result_length, mf_name_stat.cached_result.as_uint8);
     }
 
     // device name
-    if (!defused_print_batt_stat_error(stat_page_manufacture_dev_name_text, stat_page_manufacture_dev_name, COLOR_GRAY, "...", "error")) {
+    if (!defused_print_batt_stat_error(stat_page_manufacture_dev_name_text, &dev_name_stat, COLOR_GRAY, "...", "error")) {
         g_text_box_printf(stat_page_manufacture_dev_name_text,
-            "%.*s", stat_page_manufacture_dev_name->result_length, stat_page_manufacture_dev_name->cached_result.as_uint8);
+            "%.*s", dev_name_stat.result_length, dev_name_stat.cached_result.as_uint8);
     }
     
     // serial number
-    if (!defused_print_batt_stat_error(stat_page_manufacture_serial_text, stat_page_manufacture_serial, COLOR_GRAY, "---.- K", "error")) {
+    if (!defused_print_batt_stat_error(stat_page_manufacture_serial_text, &serial_stat, COLOR_GRAY, "---.- K", "error")) {
         g_text_box_printf(stat_page_manufacture_serial_text, 
-            "%d", *stat_page_manufacture_serial->cached_result.as_uint16);
+            "%d", *serial_stat.cached_result.as_uint16);
     }
 
     // device chemistry
-    if (!defused_print_batt_stat_error(stat_page_manufacture_chemistry_text, stat_page_manufacture_chemistry, COLOR_GRAY, "...", "error")) {
+    if (!defused_print_batt_stat_error(stat_page_manufacture_chemistry_text, &chemistry_stat, COLOR_GRAY, "...", "error")) {
         g_text_box_printf(stat_page_manufacture_chemistry_text,
-            "%.*s", stat_page_manufacture_chemistry->result_length, stat_page_manufacture_chemistry->cached_result.as_uint8);
+            "%.*s", chemistry_stat.result_length, chemistry_stat.cached_result.as_uint8);
     }
 
     // manufacture date
-    if (!defused_print_batt_stat_error(stat_page_manufacture_date_text, stat_page_manufacture_date, COLOR_GRAY, "...", "error")) {
-        date = *stat_page_manufacture_date->cached_result.as_uint16;
+    if (!defused_print_batt_stat_error(stat_page_manufacture_date_text, &date_stat, COLOR_GRAY, "...", "error")) {
+        date = *date_stat.cached_result.as_uint16;
         g_text_box_printf(stat_page_manufacture_date_text,
             "%d/%02d/%02d", 1980 + (date >> 9), (date >> 5) & 0x0F, date & 0x1F);
     }
-    
-    battery_stat_unlock();
 }
@@ -0,0 +1,115 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "defused/stat_page/trend_info.h"
+#include "defused/batt_gui_util.h"
+#include "defused/gui.h"
+#include "display.h"
+#include "history.h"
+
+// min and max of the core stats over the last hour, from the history (see history.h).
+// the mark after them is where the last few minutes are compared to the start of the hour
+
+#define TREND_INFO_WINDOW 3600000000ull          // 1 hour
+#define TREND_INFO_COMPARE_WINDOW 600000000ull   // 10 minutes at each end
+
+struct trend_info_row {
+    uint8_t cmd;
+    char label;
+    color_t color;
+    int32_t scale;
+    int decimals;
+    bool show_sign;
+};
+
+const struct trend_info_row stat_page_trend_rows[] = {
+    { cmd: BATT_CMD_VOLTAGE, label: 'V', color: COLOR_GREEN, scale: 1000, decimals: 2, show_sign: false },
+    { cmd: BATT_CMD_CURRENT, label: 'A', color: COLOR_RED, scale: 1000, decimals: 2, show_sign: true },
+    { cmd: BATT_CMD_TEMPERATURE, label: 'K', color: COLOR_BLUE, scale: 10, decimals: 1, show_sign: false },
+    { cmd: BATT_CMD_RELATIVE_STATE_OF_CHARGE, label: '%', color: COLOR_WHITE, scale: 1, decimals: 0, show_sign: false },
+};
+
+#define TREND_INFO_ROWS (sizeof(stat_page_trend_rows) / sizeof(stat_page_trend_rows[0]))
+
+g_text_box_t* stat_page_trend_header_text;
+g_text_box_t* stat_page_trend_row_texts[TREND_INFO_ROWS];
+
+
+void defused_stat_page_trend_info_init() {
+    // no subscriptions needed, the history keeps these stats read (init_history)
+    stat_page_trend_header_text = get_g_text_box_inst();
+    for (uint i = 0; i < TREND_INFO_ROWS; i++) {
+        stat_page_trend_row_texts[i] = get_g_text_box_inst();
+    }
+
+
+    // layout
+    coord_t line_spacing = 2;
+    coord_t y = 0;
+
+    setup_g_text_box(stat_page_trend_header_text, 0, y, display_area_width() - 1, 1, COLOR_GRAY);
+    g_text_box_print(stat_page_trend_header_text, "1h  min   max");
+    y += g_text_box_height(stat_page_trend_header_text) + line_spacing;
+
+    for (uint i = 0; i < TREND_INFO_ROWS; i++) {
+        setup_g_text_box(stat_page_trend_row_texts[i], 0, y, display_area_width() - 1, 1, stat_page_trend_rows[i].color);
+        y += g_text_box_height(stat_page_trend_row_texts[i]) + line_spacing;
+
+        graphics_add_text_box(stat_page_trend_row_texts[i]);
+    }
+
+    graphics_add_text_box(stat_page_trend_header_text);
+}
+
+void defused_stat_page_trend_info_update() {
+    uint64_t now = time_us_64();
+    uint64_t from = now > TREND_INFO_WINDOW ? now - TREND_INFO_WINDOW : 0;
+    history_summary_t summary, first, last;
+    char min_text[8];
+    char max_text[8];
+
+    for (uint i = 0; i < TREND_INFO_ROWS; i++) {
+        const struct trend_info_row* row = &stat_page_trend_rows[i];
+        g_text_box_t* row_text = stat_page_trend_row_texts[i];
+
+        if (!history_summarize(row->cmd, from, now, &summary)) {
+            g_text_box_printf(row_text, "%c    --    --", row->label);
+            continue;
+        }
+
+        defused_format_fixed(min_text, sizeof(min_text), summary.min, row->scale, row->decimals, row->show_sign);
+        defused_format_fixed(max_text, sizeof(max_text), summary.max, row->scale, row->decimals, row->show_sign);
+
+        // rising / falling, blank while there's less than the two windows
+        char trend = ' ';
+        if (now - from > TREND_INFO_COMPARE_WINDOW * 2
+                && history_summarize(row->cmd, from, from + TREND_INFO_COMPARE_WINDOW, &first)
+                && history_summarize(row->cmd, now - TREND_INFO_COMPARE_WINDOW, now, &last)) {
+            if (last.mean > first.mean) trend = '+';
+            else if (last.mean < first.mean) trend = '-';
+            else trend = '=';
+        }
+
+        g_text_box_printf(row_text, "%c%6s%6s%c", row->label, min_text, max_text, trend);
+    }
+}
@@ -25,6 +25,8 @@
 #include "font.h"
 #include "config.h"
 #include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "pico/stdlib.h"
 #include "pico/rand.h"
 #include <string.h>
@@ -47,13 +49,47 @@
 #define DISPLAY_CMD_CLEAR_WINDOW 0x25
 
 
-uint16_t display_framebuffer[DISPLAY_RESOLUTION_WIDTH][DISPLAY_RESOLUTION_HEIGHT];
+// colors are kept the way the panel takes them: rgb565, high byte first
+#define DISPLAY_NATIVE_COLOR(color) ((uint16_t) (((color) >> 8) | ((color) << 8)))
+
+// back buffer, everything is drawn in here. row-major in panel order, so any row of a region can go out as is
+uint16_t display_framebuffer[DISPLAY_RESOLUTION_HEIGHT][DISPLAY_RESOLUTION_WIDTH];
+
+// front buffer. display_refresh_region copies the rows of a region into it and a dma channel feeds it
+// to the spi from there, so the next frame can be drawn while this one is still going out
+uint16_t display_flush_buffer[DISPLAY_RESOLUTION_WIDTH * DISPLAY_RESOLUTION_HEIGHT];
+uint display_flush_dma;
+volatile bool display_flushing = false;
+uint32_t display_flush_start;
+
+// what the panel shows, in framebuffer coordinates. refreshes leave out rows that are already there,
+// and let the panel fill solid rows and move rows that are somewhere else on it by itself
+uint16_t display_panel_shadow[DISPLAY_RESOLUTION_HEIGHT][DISPLAY_RESOLUTION_WIDTH];
+bool display_panel_shadow_valid = false;
+
+// the panel doesn't say when it's done with a fill or copy, so whatever comes next waits as long as it could take.
+// the accelerator goes through the area pixel by pixel, so the wait is the old blind 1ms (enough for a whole screen,
+// the datasheet doesn't give a number) scaled to the area, plus a bit for the command itself.
+// if fills or copies ever leave garbage on a panel, DISPLAY_ACCEL_SCREEN_DELAY is what to raise
+#define DISPLAY_ACCEL_SCREEN_DELAY 1000     // us for all 96x64 pixels
+#define DISPLAY_ACCEL_COMMAND_DELAY 10      // us on top of that for every command
+
+bool display_accel_busy = false;
+uint32_t display_accel_ready_at;
 
 bool display_cs_state = 0;
 bool display_dc_state = 0;
 
 bool display_rect_fill_mode = false;
 
+// drawing outside of this is dropped (see display_set_clip)
+uint8_t clip_x1 = 0;
+uint8_t clip_y1 = 0;
+uint8_t clip_x2 = DISPLAY_RESOLUTION_WIDTH - 1;
+uint8_t clip_y2 = DISPLAY_RESOLUTION_HEIGHT - 1;
+
+display_refresh_stats_t display_refresh_stats;
+
 // burn-in protection
 uint8_t burn_limit_x = 0;
 uint8_t burn_limit_y = 0;
@@ -87,13 +123,56 @@ void display_set_dc(bool state) {
 }
 
 
+uint32_t display_accel_delay_ns(uint32_t pixels) {
+    return DISPLAY_ACCEL_COMMAND_DELAY * 1000 + pixels * (DISPLAY_ACCEL_SCREEN_DELAY * 1000 / (DISPLAY_RESOLUTION_WIDTH * DISPLAY_RESOLUTION_HEIGHT));
+}
+
+// a command is only worth it if sending its pixels would take longer than the wait
+bool display_accel_worth_it(uint32_t pixels) {
+    uint32_t send_ns = (uint64_t) pixels * 16 * 1000000000 / DISPLAY_SPI_BAUD;
+    return display_accel_delay_ns(pixels) < send_ns;
+}
+
+bool display_accel_done() {
+    if (display_accel_busy && (int32_t) (time_us_32() - display_accel_ready_at) < 0) return false;
+    display_accel_busy = false;
+    return true;
+}
+
+void display_accel_started(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+    uint32_t pixels = (x2 - x1 + 1) * (y2 - y1 + 1);
+    display_accel_ready_at = time_us_32() + (display_accel_delay_ns(pixels) + 999) / 1000;
+    display_accel_busy = true;
+}
+
+bool display_flush_done() {
+    // the dma is done once the last bytes are in the fifo, they still have to be shifted out
+    return !display_flushing && !spi_is_busy(DISPLAY_SPI) && display_accel_done();
+}
+
+void display_wait_flush() {
+    while (!display_flush_done()) tight_loop_contents();
+}
+
+void display_flush_irq_handler() {
+    if (!dma_channel_get_irq0_status(display_flush_dma)) return;
+    dma_channel_acknowledge_irq0(display_flush_dma);
+
+    display_refresh_stats.duration = time_us_32() - display_flush_start;
+    display_flushing = false;
+}
+
+
+// both wait for a running flush, dc and cs can't change under it
 void display_send_cmd(uint8_t cmd) {
+    display_wait_flush();
     display_set_dc(0);
     display_set_cs(0);
     spi_write_blocking(DISPLAY_SPI, &cmd, 1);
 }
 
 void display_send_buffer(uint8_t* buffer, size_t length) {
+    display_wait_flush();
     display_set_dc(1);
     display_set_cs(0);
     spi_write_blocking(DISPLAY_SPI, buffer, length);
@@ -156,7 +235,8 @@ void display_draw_rectangle_accellerated(uint8_t x1, uint8_t y1, uint8_t x2, uin
     display_send_cmd(rgb565_red(fill_color));
     display_send_cmd(rgb565_green(fill_color));
     display_send_cmd(rgb565_blue(fill_color));
-    sleep_ms(1);
+    display_accel_started(x1, y1, x2, y2);
+    display_refresh_stats.fill_commands++;
 }
 
 void display_copy_accellerated(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t dest_x, uint8_t dest_y) {
@@ -169,7 +249,8 @@ void display_copy_accellerated(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, u
     
     display_send_cmd(dest_x);
     display_send_cmd(dest_y);
-    sleep_ms(1);
+    display_accel_started(x1, y1, x2, y2);
+    display_refresh_stats.copy_commands++;
 }
 
 void display_shift_accellerated(int x, int y, uint16_t negative_color) {
@@ -177,7 +258,7 @@ void display_shift_accellerated(int x, int y, uint16_t negative_color) {
     uint x_offset, y_offset;
     uint8_t x_start, y_start;
     if (x > 95 || x < -95) x %= 96;
-    if (y > 63 || y < -63) x %= 64;
+    if (y > 63 || y < -63) y %= 64;
 
     x_start = x < 0 ? -x : 0;
     y_start = y < 0 ? -y : 0;
@@ -188,7 +269,7 @@ void display_shift_accellerated(int x, int y, uint16_t negative_color) {
 
     if (x < 0) display_draw_rectangle_accellerated(96 - x_start, 0, 95, 63, negative_color, negative_color);
     else if (x > 0) display_draw_rectangle_accellerated(0, 0, x_offset - 1, 63, negative_color, negative_color);
-    if (y < 0) display_draw_rectangle_accellerated(0, 63 - y_start, 95, 63, negative_color, negative_color);
+    if (y < 0) display_draw_rectangle_accellerated(0, 64 - y_start, 95, 63, negative_color, negative_color);
     else if (y > 0) display_draw_rectangle_accellerated(0, 0, 95, y_offset - 1, negative_color, negative_color);
 }
 
@@ -200,6 +281,20 @@ void display_draw_rectangle_outline(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t
     display_draw_line(x1, y1, x1, y2, color);   // left
 }
 
+// fills a box (inclusive) one row span at a time. takes coordinates that are off the screen, negative ones too
+void display_fill_native(int x1, int y1, int x2, int y2, uint16_t native_color) {
+    if (x1 < clip_x1) x1 = clip_x1;
+    if (y1 < clip_y1) y1 = clip_y1;
+    if (x2 > clip_x2) x2 = clip_x2;
+    if (y2 > clip_y2) y2 = clip_y2;
+    if (x1 > x2 || y1 > y2) return;
+
+    for (int y = y1; y <= y2; y++) {
+        uint16_t* span = &display_framebuffer[y][x1];
+        for (int i = x2 - x1; i >= 0; i--) *span++ = native_color;
+    }
+}
+
 void display_draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t color) {
     if (x2 < x1) {
         uint8_t xt = x2;
@@ -211,15 +306,7 @@ void display_draw_rectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint
         y2 = y1;
         y1 = yt;
     }
-    if (x1 >= DISPLAY_RESOLUTION_WIDTH || y1 >= DISPLAY_RESOLUTION_HEIGHT) return;
-    if (x2 >= DISPLAY_RESOLUTION_WIDTH) x2 = DISPLAY_RESOLUTION_WIDTH - 1;
-    if (y2 >= DISPLAY_RESOLUTION_HEIGHT) y2 = DISPLAY_RESOLUTION_HEIGHT - 1;
-
-    for (uint x = x1; x <= x2; x++) {
-        for (uint y = y1; y <= y2; y++) {
-            display_framebuffer[x][y] = color;
-        }
-    }
+    display_fill_native(x1, y1, x2, y2, DISPLAY_NATIVE_COLOR(color));
 }
 
 void display_draw_line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t color) {
@@ -235,24 +322,21 @@ void display_draw_line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t
     }
     if (x1 >= DISPLAY_RESOLUTION_WIDTH || y1 >= DISPLAY_RESOLUTION_HEIGHT) return;
     
-    if (x1 == x2) {
-        // vertical line
-        if (y2 >= DISPLAY_RESOLUTION_HEIGHT) y2 = DISPLAY_RESOLUTION_HEIGHT - 1;
-        for (uint y = y1; y <= y2; y++) {
-            display_framebuffer[x1][y] = color;
-        }
-    } else if (y1 == y2) {
-        // horizontal line
-        if (x2 >= DISPLAY_RESOLUTION_WIDTH) x2 = DISPLAY_RESOLUTION_WIDTH - 1;
-        for (uint x = x1; x <= x2; x++) {
-            display_framebuffer[x][y1] = color;
-        }
+    if (x1 == x2 || y1 == y2) {
+        // vertical or horizontal line
+        display_draw_rectangle(x1, y1, x2, y2, color);
     } else if (x2 - x1 > y2 - y1) {
-        // horizontal-ish line
+        // horizontal-ish line, one span per row it goes through
+        uint16_t native_color = DISPLAY_NATIVE_COLOR(color);
+        uint span_x = x1;
+        uint span_y = y1;
         uint y;
-        for (uint x = x1; x <= x2; x++) {
-            y = y1 + (y2 - y1 + 1) * (x - x1) / (x2 - x1 + 1);
-            display_draw_pixel(x, y, color);    // checks bounds
+        for (uint x = x1 + 1; x <= x2 + 1; x++) {
+            y = x <= x2 ? y1 + (y2 - y1 + 1) * (x - x1) / (x2 - x1 + 1) : UINT32_MAX;
+            if (y == span_y) continue;
+            display_fill_native(span_x, span_y, x - 1, span_y, native_color);   // checks bounds
+            span_x = x;
+            span_y = y;
         }
     } else {
         // vertical-ish line
@@ -301,13 +385,16 @@ void display_burn_update(bool shift_content) {
     burn_offset_x += shift_x;
     burn_offset_y += shift_y;
     
+    // moving the panel's content along keeps it where the framebuffer says it is
     if (shift_content) display_shift_accellerated(shift_x, shift_y, 0);
+    else if (shift_x != 0 || shift_y != 0) display_panel_shadow_valid = false;
 }
 
 // set maximum offset for burn-in reduction
 void display_set_burn_limits(uint8_t x_limit, uint8_t y_limit) {
     burn_limit_x = x_limit;
     burn_limit_y = y_limit;
+    if (burn_offset_x > x_limit || burn_offset_y > y_limit) display_panel_shadow_valid = false;
     if (burn_offset_x > x_limit) burn_offset_x = x_limit;
     if (burn_offset_y > y_limit) burn_offset_y = y_limit;
 }
@@ -324,30 +411,52 @@ uint8_t display_area_height() {
 
 
 void display_draw_pixel(uint8_t x, uint8_t y, uint16_t color) {
-    if (x >= DISPLAY_RESOLUTION_WIDTH || y >= DISPLAY_RESOLUTION_HEIGHT) return;
-    display_framebuffer[x][y] = color;
+    if (x < clip_x1 || x > clip_x2 || y < clip_y1 || y > clip_y2) return;
+    display_framebuffer[y][x] = DISPLAY_NATIVE_COLOR(color);
 }
 
+void display_set_clip(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+    clip_x1 = x1;
+    clip_y1 = y1;
+    clip_x2 = x2 < DISPLAY_RESOLUTION_WIDTH ? x2 : DISPLAY_RESOLUTION_WIDTH - 1;
+    clip_y2 = y2 < DISPLAY_RESOLUTION_HEIGHT ? y2 : DISPLAY_RESOLUTION_HEIGHT - 1;
+}
+
+void display_reset_clip() {
+    display_set_clip(0, 0, DISPLAY_RESOLUTION_WIDTH - 1, DISPLAY_RESOLUTION_HEIGHT - 1);
+}
+
+
+bool display_font_pixel(uint8_t* char_data, uint x, uint y) {
+    uint i = x + y * FONT_WIDTH;
+    return (char_data[i / 8] >> (7 - i % 8)) & 1;
+}
 
 void display_draw_char(uint8_t x_pos, uint8_t y_pos, uint8_t scale_factor, uint16_t color, char c) {
     uint8_t* char_data = font_get_char(c);
-    uint i;
-
-    // position relative to "text line"
-    y_pos -= scale_factor * FONT_HEIGHT;
-
-    // for whatever reason if I push it all as one big buffer it doesn't work
-    for (uint x = 0; x < FONT_WIDTH; x++) {
-        for (uint y = 0; y < FONT_HEIGHT; y++) {
-            i = x + y * FONT_WIDTH;
-            if (!((char_data[i / 8] >> (7 - i % 8)) & 1)) continue;
-
-            for (uint j = 0; j < scale_factor * scale_factor; j++) {
-                display_draw_pixel(
-                    x_pos + x * scale_factor + j % scale_factor, 
-                    y_pos + y * scale_factor + j / scale_factor, 
-                    color);
+    uint16_t native_color = DISPLAY_NATIVE_COLOR(color);
+
+    // position relative to "text line". the coordinates wrap around like any uint8, so a char that starts
+    // a bit left of or above the screen still shows the part that's on it. the upper half counts as negative
+    int left = (int8_t) x_pos;
+    int top = (int8_t) (uint8_t) (y_pos - scale_factor * FONT_HEIGHT);
+
+    // every run of set pixels in a glyph row is one scaled up span
+    for (uint y = 0; y < FONT_HEIGHT; y++) {
+        uint x = 0;
+        while (x < FONT_WIDTH) {
+            if (!display_font_pixel(char_data, x, y)) {
+                x++;
+                continue;
             }
+
+            uint run_start = x;
+            while (x < FONT_WIDTH && display_font_pixel(char_data, x, y)) x++;
+
+            display_fill_native(
+                left + run_start * scale_factor, top + y * scale_factor, 
+                left + x * scale_factor - 1, top + (y + 1) * scale_factor - 1, 
+                native_color);
         }
     }
 }
@@ -414,17 +523,186 @@ void display_printf(char* text, ...) {
 }
 
 
-void set_display_address_window(uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+// start and end are inclusive, in panel coordinates (burn offset already applied)
+void set_display_address_window(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
     display_send_cmd(DISPLAY_CMD_COLUMN_ADDRESS);
-    display_send_cmd(x);
-    display_send_cmd(width);
+    display_send_cmd(x1);
+    display_send_cmd(x2);
 
     display_send_cmd(DISPLAY_CMD_ROW_ADDRESS);
-    display_send_cmd(y);
-    display_send_cmd(height);
+    display_send_cmd(y1);
+    display_send_cmd(y2);
+}
+
+// a region being refreshed, clipped to the panel
+struct display_region {
+    uint x1;
+    uint y1;
+    uint panel_x1;
+    uint panel_y1;
+    uint panel_x2;
+    uint width;
+    uint height;
+};
+typedef struct display_region display_region_t;
+
+enum display_row_kind {
+    DISPLAY_ROW_SEND,
+    DISPLAY_ROW_SAME,       // the panel shows it already
+    DISPLAY_ROW_FILL,       // one color, value is the color (panel order)
+    DISPLAY_ROW_COPY,       // the panel has it value rows further down (negative: up)
+};
+typedef enum display_row_kind display_row_kind_t;
+
+struct display_row {
+    display_row_kind_t kind;
+    int value;
+};
+typedef struct display_row display_row_t;
+
+bool display_rows_match(display_row_t* a, display_row_t* b) {
+    return a->kind == b->kind && (a->kind == DISPLAY_ROW_SEND || a->kind == DISPLAY_ROW_SAME || a->value == b->value);
+}
+
+uint32_t display_row_hash(uint16_t* row, uint width) {
+    uint32_t hash = 2166136261u;
+    for (uint i = 0; i < width; i++) {
+        hash = (hash ^ row[i]) * 16777619;
+    }
+    return hash;
 }
 
-void display_refresh_region(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+// sorts the rows of the packed region (in the flush buffer) into what has to be sent and what the panel can do itself
+void display_plan_rows(display_region_t* region, display_row_t* rows) {
+    uint width = region->width;
+    uint32_t hashes[DISPLAY_RESOLUTION_HEIGHT];
+    uint32_t shadow_hashes[DISPLAY_RESOLUTION_HEIGHT];
+    uint16_t votes[DISPLAY_RESOLUTION_HEIGHT * 2] = {0};
+    bool any_send = false;
+
+    for (uint i = 0; i < region->height; i++) {
+        uint16_t* row = &display_flush_buffer[i * width];
+        rows[i].kind = DISPLAY_ROW_SEND;
+
+        if (display_panel_shadow_valid && memcmp(row, &display_panel_shadow[region->y1 + i][region->x1], width * sizeof(uint16_t)) == 0) {
+            rows[i].kind = DISPLAY_ROW_SAME;
+            continue;
+        }
+
+        uint x = 1;
+        while (x < width && row[x] == row[0]) x++;
+        if (x == width) {
+            rows[i].kind = DISPLAY_ROW_FILL;
+            rows[i].value = row[0];
+            continue;
+        }
+
+        any_send = true;
+    }
+
+    // look for rows that moved (a list that scrolled). the shift most rows agree on wins
+    uint shadow_rows = DISPLAY_RESOLUTION_HEIGHT - burn_offset_y;
+    int best_shift = 0;
+    if (display_panel_shadow_valid && any_send) {
+        for (uint j = 0; j < shadow_rows; j++) {
+            shadow_hashes[j] = display_row_hash(&display_panel_shadow[j][region->x1], width);
+        }
+
+        uint16_t best_votes = 0;
+        for (uint i = 0; i < region->height; i++) {
+            if (rows[i].kind != DISPLAY_ROW_SEND) continue;
+            hashes[i] = display_row_hash(&display_flush_buffer[i * width], width);
+
+            for (uint j = 0; j < shadow_rows; j++) {
+                if (shadow_hashes[j] != hashes[i] || j == region->y1 + i) continue;
+                int shift = (int) j - (int) (region->y1 + i);
+                uint16_t count = ++votes[shift + DISPLAY_RESOLUTION_HEIGHT];
+                if (count > best_votes) {
+                    best_votes = count;
+                    best_shift = shift;
+                }
+                break;
+            }
+        }
+
+        if (!display_accel_worth_it(best_votes * width)) best_shift = 0;
+    }
+
+    if (best_shift != 0) {
+        for (uint i = 0; i < region->height; i++) {
+            if (rows[i].kind != DISPLAY_ROW_SEND) continue;
+            int source = (int) (region->y1 + i) + best_shift;
+            if (source < 0 || source >= (int) shadow_rows || shadow_hashes[source] != hashes[i]) continue;
+            if (memcmp(&display_flush_buffer[i * width], &display_panel_shadow[source][region->x1], width * sizeof(uint16_t)) != 0) continue;
+
+            rows[i].kind = DISPLAY_ROW_COPY;
+            rows[i].value = best_shift;
+        }
+    }
+
+    // fills and copies that are too small aren't worth it. copies go in steps no taller than the shift
+    // (see display_send_copies), each one its own command
+    uint start = 0;
+    for (uint i = 1; i <= region->height; i++) {
+        if (i < region->height && display_rows_match(&rows[i], &rows[start])) continue;
+
+        bool accelerated = rows[start].kind == DISPLAY_ROW_FILL || rows[start].kind == DISPLAY_ROW_COPY;
+        uint command_rows = i - start;
+        if (rows[start].kind == DISPLAY_ROW_COPY) {
+            uint chunk = rows[start].value > 0 ? rows[start].value : -rows[start].value;
+            if (chunk < command_rows) command_rows = chunk;
+        }
+        if (accelerated && !display_accel_worth_it(command_rows * width)) {
+            for (uint j = start; j < i; j++) rows[j].kind = DISPLAY_ROW_SEND;
+        }
+
+        start = i;
+    }
+}
+
+// moves the copy rows into place on the panel. a copy never reads rows it (or an earlier one) already wrote,
+// so it's done in steps no taller than the shift, starting on the side the rows move towards
+void display_send_copies(display_region_t* region, display_row_t* rows) {
+    int height = region->height;
+    int step = 1;
+    int i = 0;
+
+    // all copies in a region have the same shift
+    int shift = 0;
+    for (int j = 0; j < height; j++) {
+        if (rows[j].kind != DISPLAY_ROW_COPY) continue;
+        shift = rows[j].value;
+        break;
+    }
+    if (shift == 0) return;
+
+    int chunk = shift > 0 ? shift : -shift;
+    if (shift < 0) {
+        // moving down, start at the bottom
+        step = -1;
+        i = height - 1;
+    }
+
+    while (i >= 0 && i < height) {
+        if (rows[i].kind != DISPLAY_ROW_COPY) {
+            i += step;
+            continue;
+        }
+
+        int end = i;
+        while (end + step >= 0 && end + step < height && rows[end + step].kind == DISPLAY_ROW_COPY && (end + step - i) * step < chunk) end += step;
+
+        int top = i < end ? i : end;
+        int bottom = i < end ? end : i;
+        display_copy_accellerated(
+            region->panel_x1, region->panel_y1 + top + shift, region->panel_x2, region->panel_y1 + bottom + shift, 
+            region->panel_x1, region->panel_y1 + top);
+
+        i = end + step;
+    }
+}
+
+uint32_t display_refresh_region(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
     if (x2 < x1) {
         uint8_t xt = x2;
         x2 = x1;
@@ -435,32 +713,113 @@ void display_refresh_region(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
         y2 = y1;
         y1 = yt;
     }
-    if (x1 >= DISPLAY_RESOLUTION_WIDTH || y1 >= DISPLAY_RESOLUTION_HEIGHT) return;
+    if (x1 >= DISPLAY_RESOLUTION_WIDTH || y1 >= DISPLAY_RESOLUTION_HEIGHT) return 0;
     if (x2 >= DISPLAY_RESOLUTION_WIDTH) x2 = DISPLAY_RESOLUTION_WIDTH - 1;
     if (y2 >= DISPLAY_RESOLUTION_HEIGHT) y2 = DISPLAY_RESOLUTION_HEIGHT - 1;
 
-    uint8_t color_bytes[2];
-    for (uint x = x1; x <= x2; x++) {
-        for (uint y = y1; y <= y2; y++) {
-            set_display_address_window(burn_offset_x + x, burn_offset_y + y, 1, 1);
-
-            // out of bounds, but still clear it
-            if (x >= display_area_width() || y >= display_area_height()) {
-                color_bytes[0] = 0;
-                color_bytes[1] = 0;
-                display_send_buffer(color_bytes, 2);
-                continue;
-            }
+    // the front buffer is still being sent
+    display_wait_flush();
+    uint32_t start_time = time_us_32();
+
+    // the part of the region that's on the panel after the burn-in offset
+    uint8_t panel_x1 = burn_offset_x + x1;
+    uint8_t panel_y1 = burn_offset_y + y1;
+    if (panel_x1 >= DISPLAY_RESOLUTION_WIDTH || panel_y1 >= DISPLAY_RESOLUTION_HEIGHT) return 0;
+    uint8_t panel_x2 = burn_offset_x + x2 < DISPLAY_RESOLUTION_WIDTH ? burn_offset_x + x2 : DISPLAY_RESOLUTION_WIDTH - 1;
+    uint8_t panel_y2 = burn_offset_y + y2 < DISPLAY_RESOLUTION_HEIGHT ? burn_offset_y + y2 : DISPLAY_RESOLUTION_HEIGHT - 1;
+
+    uint8_t area_width = display_area_width();
+    uint8_t area_height = display_area_height();
+    uint width = panel_x2 - panel_x1 + 1;
+    uint height = panel_y2 - panel_y1 + 1;
+
+    // the framebuffer is in the panel's order already, every row is a plain copy. out of bounds is still cleared
+    uint visible = x1 < area_width ? area_width - x1 : 0;
+    if (visible > width) visible = width;
+
+    uint16_t* row = display_flush_buffer;
+    for (uint y = y1; y < y1 + height; y++) {
+        uint row_visible = y < area_height ? visible : 0;
+        memcpy(row, &display_framebuffer[y][x1], row_visible * sizeof(uint16_t));
+        memset(row + row_visible, 0, (width - row_visible) * sizeof(uint16_t));
+        row += width;
+    }
 
-            color_bytes[0] = display_framebuffer[x][y] >> 8;
-            color_bytes[1] = display_framebuffer[x][y] & 0xFF;
-            display_send_buffer(color_bytes, 2);
+    display_region_t region = {
+        x1: x1,
+        y1: y1,
+        panel_x1: panel_x1,
+        panel_y1: panel_y1,
+        panel_x2: panel_x2,
+        width: width,
+        height: height,
+    };
+    display_row_t rows[DISPLAY_RESOLUTION_HEIGHT];
+    display_plan_rows(&region, rows);
+
+    display_refresh_stats.pixels = 0;
+    display_refresh_stats.filled = 0;
+    display_refresh_stats.copied = 0;
+    display_refresh_stats.skipped = 0;
+
+    // copies first, they need what's on the panel before anything gets written
+    display_send_copies(&region, rows);
+
+    uint start = 0;
+    for (uint i = 1; i <= height; i++) {
+        if (i < height && display_rows_match(&rows[i], &rows[start])) continue;
+
+        uint band_pixels = (i - start) * width;
+        switch (rows[start].kind) {
+            case DISPLAY_ROW_SAME:
+                display_refresh_stats.skipped += band_pixels;
+                break;
+
+            case DISPLAY_ROW_FILL:
+                display_set_rectangle_fill(true);
+                display_draw_rectangle_accellerated(panel_x1, panel_y1 + start, panel_x2, panel_y1 + i - 1, 
+                    DISPLAY_NATIVE_COLOR(rows[start].value), DISPLAY_NATIVE_COLOR(rows[start].value));
+                display_refresh_stats.filled += band_pixels;
+                break;
+
+            case DISPLAY_ROW_COPY:
+                display_refresh_stats.copied += band_pixels;
+                break;
+
+            case DISPLAY_ROW_SEND:
+                // the window is set once, the panel moves to the next row by itself (horizontal address increment).
+                // the whole band goes out in one dma burst
+                set_display_address_window(panel_x1, panel_y1 + start, panel_x2, panel_y1 + i - 1);
+                display_set_dc(1);
+                display_set_cs(0);
+
+                display_flush_start = start_time;
+                display_flushing = true;
+                dma_channel_transfer_from_buffer_now(display_flush_dma, &display_flush_buffer[start * width], band_pixels * sizeof(uint16_t));
+                display_refresh_stats.pixels += band_pixels;
+                break;
         }
+
+        start = i;
     }
+
+    // this is what the panel shows now
+    for (uint i = 0; i < height; i++) {
+        memcpy(&display_panel_shadow[y1 + i][x1], &display_flush_buffer[i * width], width * sizeof(uint16_t));
+    }
+    if (x1 == 0 && y1 == 0 && x2 == DISPLAY_RESOLUTION_WIDTH - 1 && y2 == DISPLAY_RESOLUTION_HEIGHT - 1) display_panel_shadow_valid = true;
+
+    display_refresh_stats.blocked = time_us_32() - start_time;
+    if (!DISPLAY_ASYNC_FLUSH) display_wait_flush();
+    return display_refresh_stats.pixels;
 }
 
-void display_refresh() {
-    display_refresh_region(0, 0, DISPLAY_RESOLUTION_WIDTH - 1, DISPLAY_RESOLUTION_HEIGHT - 1);
+void display_get_refresh_stats(display_refresh_stats_t* stats) {
+    *stats = display_refresh_stats;
+}
+
+uint32_t display_refresh() {
+    return display_refresh_region(0, 0, DISPLAY_RESOLUTION_WIDTH - 1, DISPLAY_RESOLUTION_HEIGHT - 1);
 }
 
 
@@ -483,6 +842,19 @@ void init_display() {
     spi_init(DISPLAY_SPI, DISPLAY_SPI_BAUD);
     spi_set_format(DISPLAY_SPI, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
 
+    // front buffer -> spi. the irq fires on the core that runs the display
+    display_flush_dma = dma_claim_unused_channel(true);
+    dma_channel_config dma_config = dma_channel_get_default_config(display_flush_dma);
+    channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&dma_config, true);
+    channel_config_set_write_increment(&dma_config, false);
+    channel_config_set_dreq(&dma_config, spi_get_dreq(DISPLAY_SPI, true));
+    dma_channel_configure(display_flush_dma, &dma_config, &spi_get_hw(DISPLAY_SPI)->dr, display_flush_buffer, 0, false);
+
+    dma_channel_set_irq0_enabled(display_flush_dma, true);
+    irq_add_shared_handler(DMA_IRQ_0, &display_flush_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
     // reset
     gpio_init(DISPLAY_RESET_PIN);
     gpio_set_dir(DISPLAY_RESET_PIN, GPIO_OUT);
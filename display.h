@@ -51,6 +51,10 @@ void display_draw_line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t
 void display_draw_pixel(uint8_t x, uint8_t y, uint16_t color);
 void display_draw_char(uint8_t x_pos, uint8_t y_pos, uint8_t scale_factor, uint16_t color, char c);
 
+// all drawing above only touches pixels inside the clip rectangle (inclusive). it's the whole screen by default
+void display_set_clip(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+void display_reset_clip();
+
 void display_clear();
 
 void display_set_contrast(uint8_t contrast);
@@ -70,7 +74,38 @@ void display_set_text_line_spacing(uint8_t spacing);
 void display_print(char* text);
 void display_printf(char* text, ...);
 
-void display_refresh_region(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
-void display_refresh();
+#ifndef DISPLAY_REFRESH_STATS_DEF
+#define DISPLAY_REFRESH_STATS_DEF
+
+// the last display_refresh_region call
+struct display_refresh_stats {
+    uint32_t pixels;        // sent
+    uint32_t filled;        // left to the panel: filled with one color,
+    uint32_t copied;        // moved from somewhere else on it
+    uint32_t skipped;       // or already there
+    uint32_t duration;      // microseconds until the last pixel left the dma
+    uint32_t blocked;       // microseconds the caller was held up (waiting for the previous flush, packing)
+    uint32_t fill_commands; // since boot, how often the panel filled an area by itself
+    uint32_t copy_commands; // and copied one
+};
+
+typedef struct display_refresh_stats display_refresh_stats_t;
+
+#endif
+
+// sends a region of the framebuffer to the panel. rows the panel already shows are left out, solid ones are filled
+// and rows that moved (a scrolled list) are copied by the panel itself, the rest goes out in one burst per band.
+// the rows of the region are copied to the front buffer as they are and sent by dma, so this returns before it's on the panel
+// (unless DISPLAY_ASYNC_FLUSH is off). drawing the next frame right away is fine.
+// returns how many pixels had to be sent
+uint32_t display_refresh_region(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+uint32_t display_refresh();
+
+// true once the last refresh is completely on the wire and the panel is done with fills and copies. everything else that talks to the panel waits for it by itself
+bool display_flush_done();
+void display_wait_flush();
+
+// written by core1 while it refreshes, so from core0 it's only good for a rough look
+void display_get_refresh_stats(display_refresh_stats_t* stats);
 
 void init_display();
\ No newline at end of file
@@ -0,0 +1,428 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "flash_log.h"
+#include "history.h"
+#include "battery.h"
+#include "mitm.h"
+#include "smbus_async.h"
+#include "poll_schedule.h"
+#include "capture.h"
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FLASH_LOG_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_LOG_SIZE)
+#define FLASH_LOG_PAGES (FLASH_LOG_SIZE / FLASH_PAGE_SIZE)
+#define FLASH_LOG_PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define FLASH_LOG_HEADER_SIZE 12
+#define FLASH_LOG_RECORD_MAX_LENGTH (5 + FLASH_LOG_MAX_FIELDS * 5)     // a varint is at most 5 bytes
+#define FLASH_LOG_SAFE_TIMEOUT 100      // ms to wait for core1 to get out of the way
+
+_Static_assert(FLASH_LOG_SIZE % FLASH_SECTOR_SIZE == 0, "the log has to be whole sectors");
+
+struct flash_log_page_header {
+    uint16_t magic;
+    uint16_t boot;
+    uint32_t sequence;
+    uint32_t time;
+};
+
+_Static_assert(sizeof(struct flash_log_page_header) == FLASH_LOG_HEADER_SIZE, "the page header is part of the format");
+
+// what the deltas in a page are relative to. the writer keeps one for the page it's filling, readers one per page
+struct flash_log_page_state {
+    uint32_t time;
+    int32_t last_fields[FLASH_LOG_MAX_TYPES][FLASH_LOG_MAX_FIELDS];
+};
+
+// pages waiting in ram, page n is in slot n % FLASH_LOG_PENDING_PAGES.
+// everything from flash_log_next_program up to flash_log_next_sequence is in there, the last one is open
+// for more records if flash_log_open is set
+uint8_t flash_log_pages[FLASH_LOG_PENDING_PAGES][FLASH_PAGE_SIZE];
+uint32_t flash_log_next_program = 0;
+uint32_t flash_log_next_sequence = 0;
+bool flash_log_open = false;
+bool flash_log_disabled = false;
+uint64_t flash_log_open_time;
+size_t flash_log_fill;                          // bytes used in the open page
+struct flash_log_page_state flash_log_state;    // of the open page
+
+uint32_t flash_log_erased_through = 0;          // pages before this sequence number are erased and ready
+uint16_t flash_log_boot = 0;
+uint64_t flash_log_next_summary = FLASH_LOG_SUMMARY_INTERVAL;
+
+flash_log_stats_t flash_log_stats;
+bool flash_log_waiting = false;     // a write is waiting for a gap, counted in deferred once
+
+// what flash_log_write does inside flash_safe_execute
+struct flash_log_operation {
+    bool erase;
+    uint32_t offset;
+    uint8_t* data;
+};
+
+
+uint32_t flash_log_page_offset(uint32_t sequence) {
+    return FLASH_LOG_OFFSET + (sequence % FLASH_LOG_PAGES) * FLASH_PAGE_SIZE;
+}
+
+// read through xip
+const uint8_t* flash_log_flash_page(uint32_t sequence) {
+    return (const uint8_t*) (uintptr_t) (XIP_BASE + flash_log_page_offset(sequence));
+}
+
+// the page from the flash, or from ram if it isn't written yet
+const uint8_t* flash_log_page(uint32_t sequence) {
+    if (sequence >= flash_log_next_program) return flash_log_pages[sequence % FLASH_LOG_PENDING_PAGES];
+    return flash_log_flash_page(sequence);
+}
+
+bool flash_log_page_is_valid(const uint8_t* page, uint32_t sequence) {
+    struct flash_log_page_header header;
+    memcpy(&header, page, sizeof(header));
+    return header.magic == FLASH_LOG_MAGIC && header.sequence == sequence;
+}
+
+bool flash_log_page_is_blank(uint32_t sequence) {
+    const uint8_t* page = flash_log_flash_page(sequence);
+    for (int i = 0; i < FLASH_PAGE_SIZE; i++) {
+        if (page[i] != 0xff) return false;
+    }
+    return true;
+}
+
+
+size_t flash_log_put_varint(uint8_t* buffer, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        buffer[length++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    buffer[length++] = value;
+    return length;
+}
+
+// returns the bytes used, 0 if it ran past the end
+size_t flash_log_get_varint(const uint8_t* buffer, size_t length, uint32_t* value) {
+    *value = 0;
+    for (size_t i = 0; i < length && i < 5; i++) {
+        *value |= (uint32_t) (buffer[i] & 0x7f) << (7 * i);
+        if (!(buffer[i] & 0x80)) return i + 1;
+    }
+    return 0;
+}
+
+uint32_t flash_log_zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+int32_t flash_log_unzigzag(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+
+void flash_log_open_page(uint32_t now_s) {
+    uint8_t* page = flash_log_pages[flash_log_next_sequence % FLASH_LOG_PENDING_PAGES];
+    struct flash_log_page_header header = {
+        magic: FLASH_LOG_MAGIC,
+        boot: flash_log_boot,
+        sequence: flash_log_next_sequence,
+        time: now_s
+    };
+
+    memset(page, 0xff, FLASH_PAGE_SIZE);
+    memcpy(page, &header, sizeof(header));
+
+    memset(&flash_log_state, 0, sizeof(flash_log_state));
+    flash_log_state.time = now_s;
+
+    flash_log_next_sequence++;
+    flash_log_open = true;
+    flash_log_open_time = time_us_64();
+    flash_log_fill = FLASH_LOG_HEADER_SIZE;
+}
+
+// encodes the record against the open page's deltas, returns the length of type + length + payload
+size_t flash_log_encode(uint8_t* buffer, flash_log_record_type_t type, int32_t* fields, int field_count, uint32_t now_s) {
+    size_t length = 2;
+    int32_t* last_fields = flash_log_state.last_fields[type - 1];
+
+    length += flash_log_put_varint(&buffer[length], now_s - flash_log_state.time);
+    for (int i = 0; i < field_count; i++) {
+        length += flash_log_put_varint(&buffer[length], flash_log_zigzag(fields[i] - last_fields[i]));
+    }
+
+    buffer[0] = type;
+    buffer[1] = length - 2;
+    return length;
+}
+
+bool flash_log_append(flash_log_record_type_t type, int32_t* fields, int field_count) {
+    uint8_t record[2 + FLASH_LOG_RECORD_MAX_LENGTH];
+    uint32_t now_s = time_us_64() / 1000000;
+
+    if (flash_log_disabled) return false;
+    if (type < 1 || type > FLASH_LOG_MAX_TYPES || field_count > FLASH_LOG_MAX_FIELDS) return false;
+
+    size_t length = 0;
+    if (flash_log_open) {
+        length = flash_log_encode(record, type, fields, field_count, now_s);
+        if (flash_log_fill + length > FLASH_PAGE_SIZE) flash_log_open = false;
+    }
+
+    if (!flash_log_open) {
+        // every slot holds a page that still has to be written
+        if (flash_log_next_sequence - flash_log_next_program >= FLASH_LOG_PENDING_PAGES) {
+            flash_log_stats.records_dropped++;
+            return false;
+        }
+
+        // deltas start over in the new page, so the record gets encoded again
+        flash_log_open_page(now_s);
+        length = flash_log_encode(record, type, fields, field_count, now_s);
+    }
+
+    memcpy(&flash_log_pages[(flash_log_next_sequence - 1) % FLASH_LOG_PENDING_PAGES][flash_log_fill], record, length);
+    flash_log_fill += length;
+
+    flash_log_state.time = now_s;
+    memcpy(flash_log_state.last_fields[type - 1], fields, field_count * sizeof(int32_t));
+    return true;
+}
+
+
+void flash_log_append_summaries() {
+    const uint8_t cmds[] = {BATT_CMD_CURRENT, BATT_CMD_VOLTAGE, BATT_CMD_TEMPERATURE, BATT_CMD_RELATIVE_STATE_OF_CHARGE};
+    int32_t fields[FLASH_LOG_MAX_FIELDS];
+    int field_count = 0;
+    uint64_t now = time_us_64();
+
+    for (int i = 0; i < sizeof(cmds); i++) {
+        history_summary_t summary;
+
+        // 0 readings if there weren't any, the rest is 0 as well then
+        if (!history_summarize(cmds[i], now - FLASH_LOG_SUMMARY_INTERVAL, now, &summary)) memset(&summary, 0, sizeof(summary));
+
+        fields[field_count++] = summary.min;
+        fields[field_count++] = summary.mean;
+        fields[field_count++] = summary.max;
+        fields[field_count++] = summary.count;
+    }
+
+    flash_log_append(FLASH_LOG_STATS, fields, field_count);
+
+    mitm_flow_stats_t flow;
+    mitm_get_flow_stats(&flow);
+    unsigned long pec_checked, pec_failed;
+    mitm_get_pec_stats(&pec_checked, &pec_failed);
+    poll_schedule_stats_t schedule;
+    poll_schedule_get_stats(&schedule);
+
+    int32_t counters[] = {pec_checked, pec_failed, flow.overflow_count, flow.flow_control_count, schedule.collisions};
+    flash_log_append(FLASH_LOG_COUNTERS, counters, sizeof(counters) / sizeof(counters[0]));
+}
+
+// the sector that gets erased next holds the oldest pages
+void flash_log_update_oldest() {
+    flash_log_stats.oldest_sequence = flash_log_erased_through > FLASH_LOG_PAGES ? flash_log_erased_through - FLASH_LOG_PAGES : 0;
+}
+
+void flash_log_write(void* param) {
+    struct flash_log_operation* operation = param;
+
+    if (operation->erase) flash_range_erase(operation->offset, FLASH_SECTOR_SIZE);
+    else flash_range_program(operation->offset, operation->data, FLASH_PAGE_SIZE);
+}
+
+// erases or writes, one per call since each needs its own gap. returns false if it has to wait
+bool flash_log_write_next() {
+    // the flash stalls everything running from it, and the irqs are off while it's busy
+    if (smbus_async_busy() || mitm_laptop_pending() || !mitm_transaction_finished() || capture_running()) return false;
+
+    bool erase = flash_log_next_program >= flash_log_erased_through;
+    if (!poll_schedule_is_quiet(erase ? FLASH_LOG_ERASE_TIME : FLASH_LOG_PROGRAM_TIME)) {
+        if (!flash_log_waiting) flash_log_stats.deferred++;
+        flash_log_waiting = true;
+        return false;
+    }
+
+    // an erase can outlast the smbus timeout, the laptop shouldn't be on the bus for it (see flash_log.h)
+    if (erase && !mitm_laptop_detach()) return false;
+    flash_log_waiting = false;
+
+    struct flash_log_operation operation = {
+        erase: erase,
+        offset: erase ? flash_log_page_offset(flash_log_next_program) & ~(FLASH_SECTOR_SIZE - 1) : flash_log_page_offset(flash_log_next_program),
+        data: flash_log_pages[flash_log_next_program % FLASH_LOG_PENDING_PAGES]
+    };
+
+    int result = flash_safe_execute(flash_log_write, &operation, FLASH_LOG_SAFE_TIMEOUT);
+    if (erase) mitm_laptop_attach();
+
+    if (result != PICO_OK) {
+        flash_log_stats.write_failures++;
+        return false;
+    }
+
+    if (erase) {
+        flash_log_erased_through = (flash_log_next_program / FLASH_LOG_PAGES_PER_SECTOR + 1) * FLASH_LOG_PAGES_PER_SECTOR;
+        flash_log_stats.sectors_erased++;
+        flash_log_update_oldest();
+    } else {
+        flash_log_next_program++;
+        flash_log_stats.pages_written++;
+    }
+
+    return true;
+}
+
+void flash_log_update() {
+    if (!FLASH_LOG || flash_log_disabled) return;
+
+    uint64_t now = time_us_64();
+
+    if (now >= flash_log_next_summary) {
+        flash_log_next_summary += FLASH_LOG_SUMMARY_INTERVAL;
+        flash_log_append_summaries();
+    }
+
+    // close a page that's been open for too long so it gets written
+    if (flash_log_open && now - flash_log_open_time >= FLASH_LOG_PAGE_MAX_AGE) flash_log_open = false;
+
+    uint32_t ready = flash_log_next_sequence - (flash_log_open ? 1 : 0);
+    if (flash_log_next_program < ready) flash_log_write_next();
+}
+
+
+void flash_log_read(uint32_t max_pages, flash_log_callback callback, void* user_data) {
+    uint32_t first = flash_log_next_sequence > max_pages ? flash_log_next_sequence - max_pages : 0;
+    if (first < flash_log_stats.oldest_sequence) first = flash_log_stats.oldest_sequence;
+
+    for (uint32_t sequence = first; sequence < flash_log_next_sequence; sequence++) {
+        const uint8_t* page = flash_log_page(sequence);
+        if (!flash_log_page_is_valid(page, sequence)) continue;
+
+        struct flash_log_page_header header;
+        memcpy(&header, page, sizeof(header));
+
+        struct flash_log_page_state state;
+        memset(&state, 0, sizeof(state));
+        state.time = header.time;
+
+        size_t position = FLASH_LOG_HEADER_SIZE;
+        while (position + 2 <= FLASH_PAGE_SIZE && page[position] != 0xff) {
+            uint8_t type = page[position];
+            size_t end = position + 2 + page[position + 1];
+            if (end > FLASH_PAGE_SIZE || type < 1 || type > FLASH_LOG_MAX_TYPES) break;
+            position += 2;
+
+            flash_log_record_t record = {
+                sequence: sequence,
+                boot: header.boot,
+                type: type,
+                field_count: 0
+            };
+
+            uint32_t value;
+            size_t used = flash_log_get_varint(&page[position], end - position, &value);
+            if (used == 0) break;
+            position += used;
+            state.time += value;
+            record.time = state.time;
+
+            while (position < end && record.field_count < FLASH_LOG_MAX_FIELDS) {
+                used = flash_log_get_varint(&page[position], end - position, &value);
+                if (used == 0) break;
+                position += used;
+
+                int32_t* last_field = &state.last_fields[type - 1][record.field_count];
+                *last_field += flash_log_unzigzag(value);
+                record.fields[record.field_count++] = *last_field;
+            }
+
+            position = end;
+            if (!callback(&record, user_data)) return;
+        }
+    }
+}
+
+void flash_log_get_stats(flash_log_stats_t* stats) {
+    *stats = flash_log_stats;
+    stats->disabled = flash_log_disabled;
+    stats->boot = flash_log_boot;
+    stats->next_sequence = flash_log_next_sequence;
+}
+
+
+// end of the firmware image in flash, from the linker script
+extern char __flash_binary_end;
+
+void init_flash_log() {
+    bool found = false;
+    uint32_t newest = 0;
+    uint16_t boot = 0;
+
+    // the first erase would take code out from under us
+    if ((uintptr_t) &__flash_binary_end > XIP_BASE + FLASH_LOG_OFFSET) {
+        printf("FATAL: the firmware ends at 0x%08lx, past the start of the flash log at 0x%08lx. flash log disabled\n",
+            (unsigned long) (uintptr_t) &__flash_binary_end, (unsigned long) (XIP_BASE + FLASH_LOG_OFFSET));
+        flash_log_disabled = true;
+        return;
+    }
+
+    // page n can only be at n % FLASH_LOG_PAGES, anything else is left over from something else
+    for (uint32_t i = 0; i < FLASH_LOG_PAGES; i++) {
+        struct flash_log_page_header header;
+        memcpy(&header, flash_log_flash_page(i), sizeof(header));
+        if (header.magic != FLASH_LOG_MAGIC || header.sequence % FLASH_LOG_PAGES != i) continue;
+
+        if (!found || header.sequence > newest) {
+            newest = header.sequence;
+            boot = header.boot;
+            found = true;
+        }
+    }
+
+    if (found) {
+        flash_log_next_program = newest + 1;
+        flash_log_boot = boot + 1;
+    }
+
+    // the rest of the newest page's sector is still erased, unless a write got cut off by a reset.
+    // in that case the log carries on at the next sector, which gets erased first
+    flash_log_erased_through = (flash_log_next_program + FLASH_LOG_PAGES_PER_SECTOR - 1) / FLASH_LOG_PAGES_PER_SECTOR * FLASH_LOG_PAGES_PER_SECTOR;
+    for (uint32_t sequence = flash_log_next_program; sequence < flash_log_erased_through; sequence++) {
+        if (!flash_log_page_is_blank(sequence)) {
+            flash_log_next_program = flash_log_erased_through;
+            break;
+        }
+    }
+
+    flash_log_next_sequence = flash_log_next_program;
+    flash_log_update_oldest();
+
+    flash_log_append(FLASH_LOG_BOOT, NULL, 0);
+}
@@ -0,0 +1,134 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+// persistent log in a reserved region at the end of the flash, so battery health trends survive a reset.
+// the region is one big ring of 256 byte pages, written in order and erased a sector (16 pages) at a time
+// right before the ring comes around to it again. every sector gets erased once per lap, that's the wear levelling.
+// page n of the log always sits at page n % FLASH_LOG_PAGES of the region, so finding a recent page is just math,
+// and the newest page is found at boot by looking at the page headers.
+//
+// records collect in ram and a page is only written once it's full (or FLASH_LOG_PAGE_MAX_AGE old), so
+// whatever hasn't been written yet is lost on reset. writing stops the flash (and core1) for a moment,
+// so pages are only written when the battery bus is idle and the laptop isn't expected (see poll_schedule.h).
+//
+// a page write keeps the irqs off for about 0.8 ms (3 ms at most), the laptop just gets its clock stretched.
+// a sector erase is typically 45 ms but can take up to 400 ms (W25Q16JV datasheet), way past the smbus timeout
+// (25 ms), and a sector is the smallest thing the flash can erase. so during an erase the laptop side is
+// detached (mitm_laptop_detach): the laptop's address isn't acked and it sees no battery for up to 400 ms
+// instead of a bus that hangs, and retries like it would after any other nack.
+//
+// page format (little endian):
+//   offset 0   uint16  magic FLASH_LOG_MAGIC
+//   offset 2   uint16  boot number, goes up by one every time the firmware starts
+//   offset 4   uint32  page sequence number
+//   offset 8   uint32  seconds since boot when the page was started
+//   offset 12  records, until a type of 0xff or the end of the page
+//
+// record format:
+//   uint8      type (see flash_log_record_type)
+//   uint8      length of the rest of the record
+//   varint     seconds since the previous record in the page (or the page start)
+//   varints    the fields, zigzag encoded, each one as the difference to the same field of the previous
+//              record of that type in the page (the first one in a page is relative to 0)
+// varints are 7 bits per byte, lowest first, with the top bit set on every byte but the last.
+
+#define FLASH_LOG_SIZE (512 * 1024)     // at the very end of the flash, the firmware has to stay below it (checked at boot)
+#define FLASH_LOG_MAGIC 0x4c42
+#define FLASH_LOG_PENDING_PAGES 4       // pages that can wait in ram for a gap to be written
+#define FLASH_LOG_MAX_FIELDS 16
+#define FLASH_LOG_MAX_TYPES 8
+
+#define FLASH_LOG_PAGE_MAX_AGE 3600000000ull        // a page that isn't full yet is written after this long (1 hour)
+#define FLASH_LOG_SUMMARY_INTERVAL 900000000ull     // how often stats and counters are logged (15 min)
+#define FLASH_LOG_ERASE_TIME 100000                 // the gap needed for a sector erase (typically 45 ms, up to 400 ms)
+#define FLASH_LOG_PROGRAM_TIME 2000                 // the gap needed for a page write (typically 0.8 ms)
+
+
+#ifndef FLASH_LOG_RECORD_DEF
+#define FLASH_LOG_RECORD_DEF
+
+// values are part of the format, don't reorder
+enum flash_log_record_type {
+    FLASH_LOG_BOOT = 0x01,          // no fields, the boot number is in the page header
+    FLASH_LOG_STATS = 0x02,         // min, mean, max and readings of current, voltage, temperature and charge
+                                    // over the last FLASH_LOG_SUMMARY_INTERVAL (units like history.h)
+    FLASH_LOG_COUNTERS = 0x03,      // since boot: replies pec checked, pec failed, transactions dropped,
+                                    // flow control engaged, background reads the laptop ran into
+    FLASH_LOG_SESSION = 0x04,       // a charge/discharge session that ended: direction, duration in s, mAh, mWh,
+                                    // peak power in mW, charge % at the start and end (see metrics.h)
+};
+
+typedef enum flash_log_record_type flash_log_record_type_t;
+
+struct flash_log_record {
+    uint32_t sequence;              // page it's in
+    uint16_t boot;
+    uint32_t time;                  // seconds since that boot
+    uint8_t type;
+    uint8_t field_count;
+    int32_t fields[FLASH_LOG_MAX_FIELDS];
+};
+
+typedef struct flash_log_record flash_log_record_t;
+
+// return false to stop reading
+typedef bool (*flash_log_callback)(flash_log_record_t* record, void* user_data);
+
+struct flash_log_stats {
+    bool disabled;                  // the firmware runs into the log region, nothing is read or written
+    uint16_t boot;
+    uint32_t pages_written;         // since boot
+    uint32_t sectors_erased;
+    uint32_t records_dropped;       // no room left in ram, the flash couldn't keep up
+    uint32_t write_failures;
+    uint32_t deferred;              // times a write or erase had to wait for the laptop to leave a gap
+    uint32_t next_sequence;         // of the page that's filled next
+    uint32_t oldest_sequence;       // oldest page still in the flash
+};
+
+typedef struct flash_log_stats flash_log_stats_t;
+
+#endif
+
+
+// adds a record. the fields are encoded as varints, small changes from the last record of the same
+// type take the least space. returns false if it was dropped. only call from core0
+bool flash_log_append(flash_log_record_type_t type, int32_t* fields, int field_count);
+
+// logs the periodic summaries and writes pages when there's a gap for it.
+// call from the core0 main loop, it only blocks for the flash write itself
+void flash_log_update();
+
+// calls back for every record in the newest max_pages pages (the ones still in ram included), oldest first.
+// only call from core0
+void flash_log_read(uint32_t max_pages, flash_log_callback callback, void* user_data);
+
+void flash_log_get_stats(flash_log_stats_t* stats);
+
+// finds the end of the log. call from core0 at boot, core1 has to call flash_safe_execute_core_init().
+// if the firmware is too big to leave FLASH_LOG_SIZE free at the end of the flash, the log stays disabled
+void init_flash_log();
@@ -61,6 +61,25 @@ size_t graphics_line_alloc_index = 0;
 g_object_holder_t graphics_objects_internal[GRAPHICS_MAX_OBJECTS];
 size_t graphics_object_count = 0;
 
+struct g_region {
+    coord_t x1;
+    coord_t y1;
+    coord_t x2;
+    coord_t y2;
+};
+typedef struct g_region g_region_t;
+
+// damage tracking: what has to be redrawn and sent by the next graphics_render
+g_region_t graphics_damage[GRAPHICS_MAX_DAMAGE];
+size_t graphics_damage_count = 0;
+bool graphics_damage_all = true;
+
+// the usable display area the screen was last drawn for
+uint8_t graphics_area_width = 0;
+uint8_t graphics_area_height = 0;
+
+graphics_render_stats_t graphics_render_stats;
+
 
 void init_g_text_box(g_text_box_t* inst) {
     inst->enabled = true;
@@ -80,6 +99,7 @@ void init_g_text_box(g_text_box_t* inst) {
         index: 0,
         last_updated: 0,
     };
+    inst->_rendered = (_g_render_state_t){drawn: false};
 }
 
 void init_g_rectangle(g_rectangle_t* inst) {
@@ -90,6 +110,7 @@ void init_g_rectangle(g_rectangle_t* inst) {
     inst->y2 = 0;
     inst->color = COLOR_WHITE;
     inst->filled = true;
+    inst->_rendered = (_g_render_state_t){drawn: false};
 }
 
 void init_g_line(g_line_t* inst) {
@@ -99,6 +120,7 @@ void init_g_line(g_line_t* inst) {
     inst->x2 = 0;
     inst->y2 = 0;
     inst->color = COLOR_WHITE;
+    inst->_rendered = (_g_render_state_t){drawn: false};
 }
 
 coord_t g_text_box_chars_per_line(g_text_box_t* inst) {
@@ -228,6 +250,224 @@ void render_g_line(g_line_t* inst) {
     display_draw_line(inst->x1, inst->y1, inst->x2, inst->y2, inst->color);
 }
 
+
+// damage tracking
+
+#define GRAPHICS_HASH_START 2166136261u
+#define GRAPHICS_HASH_FIELD(hash, field) graphics_hash(hash, &(field), sizeof(field))
+
+// fnv-1a
+uint32_t graphics_hash(uint32_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619;
+    }
+    return hash;
+}
+
+// clips to the screen, false if nothing's left
+bool graphics_clip_region(g_region_t* region, uint x1, uint y1, uint x2, uint y2) {
+    if (x1 > x2 || y1 > y2) return false;
+    if (x1 >= DISPLAY_RESOLUTION_WIDTH || y1 >= DISPLAY_RESOLUTION_HEIGHT) return false;
+    region->x1 = x1;
+    region->y1 = y1;
+    region->x2 = x2 < DISPLAY_RESOLUTION_WIDTH ? x2 : DISPLAY_RESOLUTION_WIDTH - 1;
+    region->y2 = y2 < DISPLAY_RESOLUTION_HEIGHT ? y2 : DISPLAY_RESOLUTION_HEIGHT - 1;
+    return true;
+}
+
+// margin 1 also counts regions that are right next to each other
+bool graphics_regions_overlap(g_region_t* a, g_region_t* b, uint margin) {
+    return a->x1 <= b->x2 + margin && b->x1 <= a->x2 + margin && a->y1 <= b->y2 + margin && b->y1 <= a->y2 + margin;
+}
+
+g_region_t graphics_region_union(g_region_t* a, g_region_t* b) {
+    return (g_region_t){
+        x1: a->x1 < b->x1 ? a->x1 : b->x1,
+        y1: a->y1 < b->y1 ? a->y1 : b->y1,
+        x2: a->x2 > b->x2 ? a->x2 : b->x2,
+        y2: a->y2 > b->y2 ? a->y2 : b->y2,
+    };
+}
+
+uint graphics_region_area(g_region_t* region) {
+    return (region->x2 - region->x1 + 1) * (region->y2 - region->y1 + 1);
+}
+
+void graphics_add_damage(g_region_t region) {
+    if (graphics_damage_all) return;
+
+    // swallow everything it touches, one bigger region is cheaper to redraw and send than two overlapping ones
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < graphics_damage_count; i++) {
+            if (!graphics_regions_overlap(&region, &graphics_damage[i], 1)) continue;
+            region = graphics_region_union(&region, &graphics_damage[i]);
+            graphics_damage[i] = graphics_damage[--graphics_damage_count];
+            merged = true;
+            break;
+        }
+    }
+
+    if (graphics_damage_count < GRAPHICS_MAX_DAMAGE) {
+        graphics_damage[graphics_damage_count++] = region;
+        return;
+    }
+
+    // out of slots, merge with the one that grows the least
+    size_t best = 0;
+    uint best_growth = UINT32_MAX;
+    for (size_t i = 0; i < graphics_damage_count; i++) {
+        g_region_t merged_region = graphics_region_union(&region, &graphics_damage[i]);
+        uint growth = graphics_region_area(&merged_region) - graphics_region_area(&graphics_damage[i]);
+        if (growth >= best_growth) continue;
+        best = i;
+        best_growth = growth;
+    }
+
+    region = graphics_region_union(&region, &graphics_damage[best]);
+    graphics_damage[best] = graphics_damage[--graphics_damage_count];
+    graphics_add_damage(region);
+}
+
+// damages where the object was and where it is now if anything about it changed
+void graphics_track(_g_render_state_t* state, bool drawn, g_region_t* region, uint32_t signature) {
+    bool changed = drawn != state->drawn || signature != state->signature;
+    if (drawn && state->drawn) {
+        changed = changed || region->x1 != state->x1 || region->y1 != state->y1 || region->x2 != state->x2 || region->y2 != state->y2;
+    }
+    if (!changed) return;
+
+    if (state->drawn) {
+        graphics_add_damage((g_region_t){
+            x1: state->x1,
+            y1: state->y1,
+            x2: state->x2,
+            y2: state->y2,
+        });
+    }
+    if (drawn) graphics_add_damage(*region);
+
+    state->drawn = drawn;
+    state->signature = signature;
+    if (!drawn) return;
+    state->x1 = region->x1;
+    state->y1 = region->y1;
+    state->x2 = region->x2;
+    state->y2 = region->y2;
+}
+
+// what the text box can cover. a bit generous, it doesn't have to be exact
+bool g_text_box_region(g_text_box_t* inst, g_region_t* region) {
+    if (!inst->enabled || inst->text == NULL || inst->length == 0) return false;
+
+    uint char_width = FONT_WIDTH * inst->scale_factor;
+    uint x1 = inst->x1;
+    uint x2 = inst->x2;
+
+    if (x2 < x1) {
+        // the width wraps around, who knows where that ends up
+        x1 = 0;
+        x2 = DISPLAY_RESOLUTION_WIDTH - 1;
+    } else if (x2 + 1 < x1 + char_width) {
+        // one char is always drawn, even if the box is narrower than that. it can stick out on either side
+        x1 = x2 + 1 >= char_width ? x2 + 1 - char_width : 0;
+        x2 = inst->x1 + char_width - 1;
+    }
+
+    // a marquee that only fits one char still draws both arrows
+    if (inst->truncation_mode == TEXT_MARQUEE) x2 += char_width + inst->scale_factor;
+
+    uint lines = inst->truncation_mode == TEXT_MARQUEE ? 1 : inst->max_lines;
+    uint line_height = FONT_HEIGHT * inst->scale_factor;
+    uint y2 = lines == 0 ? DISPLAY_RESOLUTION_HEIGHT - 1 : inst->y1 + lines * (line_height + inst->line_spacing) - inst->line_spacing - 1;
+
+    return graphics_clip_region(region, x1, inst->y1, x2, y2);
+}
+
+uint32_t g_text_box_signature(g_text_box_t* inst) {
+    uint32_t hash = GRAPHICS_HASH_START;
+    if (inst->text != NULL) hash = graphics_hash(hash, inst->text, inst->length);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->length);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->x1);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->y1);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->x2);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->max_lines);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->line_spacing);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->scale_factor);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->color);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->alignment_mode);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->truncation_mode);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->_marquee.index);
+    return hash;
+}
+
+// rectangles and lines cover the box between their corners
+bool graphics_corners_region(bool enabled, coord_t x1, coord_t y1, coord_t x2, coord_t y2, g_region_t* region) {
+    if (!enabled) return false;
+    return graphics_clip_region(region, 
+        x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, 
+        x1 > x2 ? x1 : x2, y1 > y2 ? y1 : y2);
+}
+
+uint32_t g_rectangle_signature(g_rectangle_t* inst) {
+    uint32_t hash = GRAPHICS_HASH_START;
+    hash = GRAPHICS_HASH_FIELD(hash, inst->x1);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->y1);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->x2);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->y2);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->color);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->filled);
+    return hash;
+}
+
+uint32_t g_line_signature(g_line_t* inst) {
+    uint32_t hash = GRAPHICS_HASH_START;
+    hash = GRAPHICS_HASH_FIELD(hash, inst->x1);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->y1);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->x2);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->y2);
+    hash = GRAPHICS_HASH_FIELD(hash, inst->color);
+    return hash;
+}
+
+void graphics_track_object(g_object_holder_t* holder) {
+    g_region_t region;
+    bool drawn;
+
+    switch (holder->type) {
+        case GRAPHICS_TEXT_BOX: {
+            g_text_box_t* text_box = holder->ptr.text_box;
+            drawn = g_text_box_region(text_box, &region);
+            graphics_track(&text_box->_rendered, drawn, &region, g_text_box_signature(text_box));
+            break;
+        }
+        case GRAPHICS_RECTANGLE: {
+            g_rectangle_t* rectangle = holder->ptr.rectangle;
+            drawn = graphics_corners_region(rectangle->enabled, rectangle->x1, rectangle->y1, rectangle->x2, rectangle->y2, &region);
+            graphics_track(&rectangle->_rendered, drawn, &region, g_rectangle_signature(rectangle));
+            break;
+        }
+        case GRAPHICS_LINE: {
+            g_line_t* line = holder->ptr.line;
+            drawn = graphics_corners_region(line->enabled, line->x1, line->y1, line->x2, line->y2, &region);
+            graphics_track(&line->_rendered, drawn, &region, g_line_signature(line));
+            break;
+        }
+    }
+}
+
+_g_render_state_t* graphics_object_render_state(g_object_holder_t* holder) {
+    switch (holder->type) {
+        case GRAPHICS_TEXT_BOX: return &holder->ptr.text_box->_rendered;
+        case GRAPHICS_RECTANGLE: return &holder->ptr.rectangle->_rendered;
+        case GRAPHICS_LINE: return &holder->ptr.line->_rendered;
+    }
+    return NULL;
+}
+
+
 void graphics_add_object(g_object_holder_t holder) {
     if (graphics_object_count >= GRAPHICS_MAX_OBJECTS) {
         printf("ERROR: can't add any more graphics objects\n");
@@ -402,27 +642,88 @@ color_t graphics_calculate_foreground_color(color_t background_color) {
     return COLOR_WHITE;
 }
 
+void graphics_invalidate() {
+    graphics_damage_all = true;
+    graphics_damage_count = 0;
+}
+
 void graphics_render() {
     g_object_holder_t* holder;
-
-    display_clear();
+    _g_render_state_t* state;
+    g_region_t* region;
+    g_region_t object_region;
+    uint32_t pixels = 0;
+
+    // the burn-in margins changed, nothing on the screen is where it should be
+    if (display_area_width() != graphics_area_width || display_area_height() != graphics_area_height) {
+        graphics_area_width = display_area_width();
+        graphics_area_height = display_area_height();
+        graphics_invalidate();
+    }
 
     for (size_t i = 0; i < graphics_object_count; i++) {
-        holder = &graphics_objects_internal[i];
-        switch (holder->type) {
-            case GRAPHICS_TEXT_BOX:
-                render_g_text_box(holder->ptr.text_box);
-                break;
-            case GRAPHICS_RECTANGLE:
-                render_g_rectangle(holder->ptr.rectangle);
-                break;
-            case GRAPHICS_LINE:
-                render_g_line(holder->ptr.line);
-                break;
+        graphics_track_object(&graphics_objects_internal[i]);
+    }
+
+    if (graphics_damage_all) {
+        graphics_damage[0] = (g_region_t){
+            x1: 0,
+            y1: 0,
+            x2: DISPLAY_RESOLUTION_WIDTH - 1,
+            y2: DISPLAY_RESOLUTION_HEIGHT - 1,
+        };
+        graphics_damage_count = 1;
+        graphics_damage_all = false;
+    }
+
+    for (size_t d = 0; d < graphics_damage_count; d++) {
+        region = &graphics_damage[d];
+
+        // clear the region and draw everything that reaches into it again, in order. nothing outside of it is touched
+        display_set_clip(region->x1, region->y1, region->x2, region->y2);
+        display_draw_rectangle(region->x1, region->y1, region->x2, region->y2, COLOR_BLACK);
+
+        for (size_t i = 0; i < graphics_object_count; i++) {
+            holder = &graphics_objects_internal[i];
+            state = graphics_object_render_state(holder);
+            if (!state->drawn) continue;
+
+            object_region = (g_region_t){
+                x1: state->x1,
+                y1: state->y1,
+                x2: state->x2,
+                y2: state->y2,
+            };
+            if (!graphics_regions_overlap(&object_region, region, 0)) continue;
+
+            switch (holder->type) {
+                case GRAPHICS_TEXT_BOX:
+                    render_g_text_box(holder->ptr.text_box);
+                    break;
+                case GRAPHICS_RECTANGLE:
+                    render_g_rectangle(holder->ptr.rectangle);
+                    break;
+                case GRAPHICS_LINE:
+                    render_g_line(holder->ptr.line);
+                    break;
+            }
         }
+
+        pixels += display_refresh_region(region->x1, region->y1, region->x2, region->y2);
     }
-    
-    display_refresh();
+
+    display_reset_clip();
+
+    graphics_render_stats.frames++;
+    graphics_render_stats.regions = graphics_damage_count;
+    graphics_render_stats.pixels = pixels;
+    graphics_render_stats.total_pixels += pixels;
+
+    graphics_damage_count = 0;
+}
+
+void graphics_get_render_stats(graphics_render_stats_t* stats) {
+    *stats = graphics_render_stats;
 }
 
 void graphics_update() {
@@ -476,6 +777,9 @@ void graphics_reset() {
     graphics_line_alloc_index = 0;
 
     graphics_object_count = 0;
+
+    // whatever the next page draws, the old one has to go
+    graphics_invalidate();
 }
 
 void init_graphics() {
@@ -32,6 +32,9 @@
 #define GRAPHICS_MAX_LINES          8
 #define GRAPHICS_MAX_OBJECTS        GRAPHICS_MAX_TEXT_BOXES + GRAPHICS_MAX_RECTS + GRAPHICS_MAX_LINES
 
+// damaged regions redrawn per frame. more than that get merged with the closest one
+#define GRAPHICS_MAX_DAMAGE         6
+
 #define MARQUEE_START_DELAY 2000000
 #define MARQUEE_INTERVAL 200000
 
@@ -45,6 +48,17 @@ struct _g_marquee_state {
 };
 typedef struct _g_marquee_state _g_marquee_state_t;
 
+// what an object looked like when it was last drawn, so graphics_render can tell if it changed
+struct _g_render_state {
+    bool drawn;             // on the screen with these bounds
+    coord_t x1;
+    coord_t y1;
+    coord_t x2;
+    coord_t y2;
+    uint32_t signature;     // hash of everything that changes how it looks
+};
+typedef struct _g_render_state _g_render_state_t;
+
 enum g_text_truncation_mode {
     TEXT_WRAP,
     TEXT_MARQUEE,
@@ -78,6 +92,7 @@ struct g_text_box {
     g_text_truncation_mode_t truncation_mode;
 
     _g_marquee_state_t _marquee;
+    _g_render_state_t _rendered;
 };
 typedef struct g_text_box g_text_box_t;
 
@@ -91,6 +106,8 @@ struct g_rectangle {
 
     color_t color;
     bool filled;
+
+    _g_render_state_t _rendered;
 };
 typedef struct g_rectangle g_rectangle_t;
 
@@ -103,9 +120,19 @@ struct g_line {
     coord_t y2;
 
     color_t color;
+
+    _g_render_state_t _rendered;
 };
 typedef struct g_line g_line_t;
 
+struct graphics_render_stats {
+    uint32_t frames;        // graphics_render calls
+    uint32_t regions;       // damaged regions redrawn by the last frame
+    uint32_t pixels;        // sent to the panel by the last frame
+    uint64_t total_pixels;
+};
+typedef struct graphics_render_stats graphics_render_stats_t;
+
 
 coord_t g_text_box_height(g_text_box_t* inst);
 void g_text_box_print(g_text_box_t* inst, char* text);
@@ -128,9 +155,17 @@ void graphics_add_line(g_line_t* inst);
 coord_t graphics_calculate_text_width(size_t chars, coord_t scale_factor);
 color_t graphics_calculate_foreground_color(color_t background_color);
 
-// renders everything to the framebuffer
+// renders what changed since the last call to the framebuffer and sends it to the display.
+// objects are compared to how they were last drawn, so the gui can just set everything again every update.
+// only the regions they covered before and cover now are cleared, redrawn (everything in there, in order) and sent
 void graphics_render();
 
+// the next graphics_render redraws and sends the whole screen
+void graphics_invalidate();
+
+// written by core1, only good for a rough look from core0
+void graphics_get_render_stats(graphics_render_stats_t* stats);
+
 // updates stuff like marquees
 void graphics_update();
 
@@ -0,0 +1,265 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "history.h"
+#include "battery.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include <stddef.h>
+
+// the stats that get a history
+const uint8_t history_cmds[] = {
+    BATT_CMD_CURRENT,
+    BATT_CMD_VOLTAGE,
+    BATT_CMD_TEMPERATURE,
+    BATT_CMD_RELATIVE_STATE_OF_CHARGE,
+};
+
+#define HISTORY_STAT_COUNT (sizeof(history_cmds) / sizeof(history_cmds[0]))
+
+struct history_raw {
+    uint32_t time;          // lower 32 bits of the timestamp in ms, raw readings are never that old
+    int16_t value;
+};
+
+struct history_bucket {
+    uint32_t number;        // timestamp / bucket width
+    int32_t sum;
+    int16_t min;
+    int16_t max;
+    uint16_t count;         // 0 if it was never used. stops going up at 65535, so sum can't overflow
+};
+
+struct history {
+    volatile uint32_t sequence;     // seqlock, same as the stat cache (see battery.c)
+    uint32_t raw_written;           // readings since boot, wraps around the raw ring
+    struct history_raw raw[HISTORY_RAW_SAMPLES];
+    struct history_bucket minutes[HISTORY_MINUTE_BUCKETS];
+    struct history_bucket quarters[HISTORY_QUARTER_BUCKETS];
+};
+
+// about 9k per stat
+struct history history_stats[HISTORY_STAT_COUNT];
+
+
+struct history* history_find(uint8_t cmd) {
+    for (int i = 0; i < HISTORY_STAT_COUNT; i++) {
+        if (history_cmds[i] == cmd) return &history_stats[i];
+    }
+    return NULL;
+}
+
+bool history_has_stat(uint8_t cmd) {
+    return history_find(cmd) != NULL;
+}
+
+void history_add_to_bucket(struct history_bucket* buckets, int bucket_count, uint64_t width, uint64_t timestamp, int16_t value) {
+    uint32_t number = timestamp / width;
+    struct history_bucket* bucket = &buckets[number % bucket_count];
+
+    // a slot that's never been used, or still holds the bucket from one lap around the ring ago
+    if (bucket->count == 0 || bucket->number != number) {
+        bucket->number = number;
+        bucket->sum = value;
+        bucket->min = value;
+        bucket->max = value;
+        bucket->count = 1;
+        return;
+    }
+
+    if (value < bucket->min) bucket->min = value;
+    if (value > bucket->max) bucket->max = value;
+
+    if (bucket->count < UINT16_MAX) {
+        bucket->sum += value;
+        bucket->count++;
+    }
+}
+
+void history_add(uint8_t cmd, int32_t value, uint64_t timestamp) {
+    struct history* history = history_find(cmd);
+    if (history == NULL) return;
+
+    if (value > INT16_MAX) value = INT16_MAX;
+    if (value < INT16_MIN) value = INT16_MIN;
+
+    history->sequence++;
+    __dmb();
+
+    struct history_raw* raw = &history->raw[history->raw_written % HISTORY_RAW_SAMPLES];
+    raw->time = timestamp / 1000;
+    raw->value = value;
+    history->raw_written++;
+
+    history_add_to_bucket(history->minutes, HISTORY_MINUTE_BUCKETS, HISTORY_MINUTE, timestamp, value);
+    history_add_to_bucket(history->quarters, HISTORY_QUARTER_BUCKETS, HISTORY_QUARTER, timestamp, value);
+
+    __dmb();
+    history->sequence++;
+}
+
+
+// goes through one level between from and to (to is at most now). every bucket is copied to buckets (if not
+// NULL, up to max_buckets) and added up in total (if not NULL). returns the number of buckets.
+// has to run inside the seqlock, it starts over from scratch when the reader retries
+int history_collect(struct history* history, history_level_t level, uint64_t from, uint64_t to, uint64_t now,
+        history_summary_t* buckets, int max_buckets, history_summary_t* total, int64_t* total_sum) {
+    int count = 0;
+
+    if (level == HISTORY_LEVEL_RAW) {
+        uint32_t now_ms = now / 1000;
+        uint32_t raw_count = history->raw_written < HISTORY_RAW_SAMPLES ? history->raw_written : HISTORY_RAW_SAMPLES;
+
+        for (uint32_t i = 0; i < raw_count; i++) {
+            struct history_raw* raw = &history->raw[(history->raw_written - raw_count + i) % HISTORY_RAW_SAMPLES];
+            uint64_t time = now - (uint64_t) (uint32_t) (now_ms - raw->time) * 1000;
+            if (time < from || time > to) continue;
+
+            history_summary_t bucket = {
+                start: time,
+                end: time,
+                min: raw->value,
+                max: raw->value,
+                mean: raw->value,
+                count: 1
+            };
+
+            if (buckets != NULL && count < max_buckets) buckets[count] = bucket;
+            if (total != NULL) {
+                if (total->count == 0 || bucket.min < total->min) total->min = bucket.min;
+                if (total->count == 0 || bucket.max > total->max) total->max = bucket.max;
+                *total_sum += raw->value;
+                total->count++;
+            }
+            count++;
+        }
+
+        return count;
+    }
+
+    struct history_bucket* level_buckets = level == HISTORY_LEVEL_MINUTE ? history->minutes : history->quarters;
+    int bucket_count = level == HISTORY_LEVEL_MINUTE ? HISTORY_MINUTE_BUCKETS : HISTORY_QUARTER_BUCKETS;
+    uint64_t width = level == HISTORY_LEVEL_MINUTE ? HISTORY_MINUTE : HISTORY_QUARTER;
+
+    uint32_t first = from / width;
+    uint32_t last = to / width;
+    if (last - first >= bucket_count) first = last - bucket_count + 1;
+
+    for (uint32_t number = first; number <= last; number++) {
+        struct history_bucket* level_bucket = &level_buckets[number % bucket_count];
+        if (level_bucket->count == 0 || level_bucket->number != number) continue;
+
+        if (buckets != NULL && count < max_buckets) {
+            buckets[count] = (history_summary_t) {
+                start: (uint64_t) number * width,
+                end: (uint64_t) (number + 1) * width,
+                min: level_bucket->min,
+                max: level_bucket->max,
+                mean: level_bucket->sum / level_bucket->count,
+                count: level_bucket->count
+            };
+        }
+        if (total != NULL) {
+            if (total->count == 0 || level_bucket->min < total->min) total->min = level_bucket->min;
+            if (total->count == 0 || level_bucket->max > total->max) total->max = level_bucket->max;
+            *total_sum += level_bucket->sum;
+            total->count += level_bucket->count;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+int history_read(uint8_t cmd, history_level_t level, uint64_t from, uint64_t to, history_summary_t* buckets, int max_buckets) {
+    struct history* history = history_find(cmd);
+    if (history == NULL) return 0;
+
+    uint64_t now = time_us_64();
+    if (to > now) to = now;
+    if (from > to) return 0;
+
+    uint32_t sequence;
+    int count;
+
+    do {
+        while ((sequence = history->sequence) & 1) tight_loop_contents();
+        __dmb();
+
+        count = history_collect(history, level, from, to, now, buckets, max_buckets, NULL, NULL);
+
+        __dmb();
+    } while (sequence != history->sequence);
+
+    return count < max_buckets ? count : max_buckets;
+}
+
+bool history_summarize(uint8_t cmd, uint64_t from, uint64_t to, history_summary_t* summary) {
+    struct history* history = history_find(cmd);
+    if (history == NULL) return false;
+
+    uint64_t now = time_us_64();
+    if (to > now) to = now;
+    if (from > to) return false;
+
+    uint32_t sequence;
+    int64_t sum;
+
+    do {
+        while ((sequence = history->sequence) & 1) tight_loop_contents();
+        __dmb();
+
+        // the raw ring goes back to boot until it fills up, then to its oldest reading
+        uint64_t raw_oldest = 0;
+        if (history->raw_written >= HISTORY_RAW_SAMPLES) {
+            struct history_raw* oldest = &history->raw[history->raw_written % HISTORY_RAW_SAMPLES];
+            raw_oldest = now - (uint64_t) (uint32_t) ((uint32_t) (now / 1000) - oldest->time) * 1000;
+        }
+
+        history_level_t level = HISTORY_LEVEL_QUARTER;
+        if (from >= raw_oldest) level = HISTORY_LEVEL_RAW;
+        else if (from / HISTORY_MINUTE + HISTORY_MINUTE_BUCKETS > now / HISTORY_MINUTE) level = HISTORY_LEVEL_MINUTE;
+
+        summary->start = from;
+        summary->end = to;
+        summary->count = 0;
+        sum = 0;
+        history_collect(history, level, from, to, now, NULL, 0, summary, &sum);
+
+        __dmb();
+    } while (sequence != history->sequence);
+
+    if (summary->count == 0) return false;
+
+    summary->mean = sum / (int64_t) summary->count;
+    return true;
+}
+
+
+void init_history() {
+    // the history takes every reading it gets (polled for the screens or snooped from the laptop),
+    // the subscription only makes sure the buckets don't stay empty when nobody else wants the stat
+    for (int i = 0; i < HISTORY_STAT_COUNT; i++) {
+        battery_stat_subscribe(battery_get_stat(history_cmds[i]), HISTORY_MAX_AGE);
+    }
+}
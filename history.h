@@ -0,0 +1,89 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+// history of the core battery stats, at three resolutions:
+//   raw      every reading, for the last few minutes
+//   minute   min/mean/max per minute, for a few hours
+//   quarter  min/mean/max per 15 minutes, for a couple of days
+// it's built from the readings that go into the stat cache anyway (polled or snooped, see battery.c),
+// every reading updates all three levels at once, so nothing is ever rescanned. buckets are found by
+// their number (time / bucket width), a query only touches the buckets in its range.
+//
+// values are kept as int16: current in mA, voltage in mV, temperature in 0.1 K, charge in %.
+// anything that doesn't fit (a pack over 32.7 V) is clamped.
+
+#define HISTORY_RAW_SAMPLES 256         // per stat, about 4 min at the fastest read rate
+#define HISTORY_MINUTE_BUCKETS 240      // 4 hours
+#define HISTORY_QUARTER_BUCKETS 192     // 2 days
+
+#define HISTORY_MINUTE 60000000ull
+#define HISTORY_QUARTER 900000000ull
+
+#define HISTORY_MAX_AGE 30000000        // us, at least 2 readings per minute bucket when nothing else reads the stat
+
+
+#ifndef HISTORY_SUMMARY_DEF
+#define HISTORY_SUMMARY_DEF
+
+enum history_level {
+    HISTORY_LEVEL_RAW,
+    HISTORY_LEVEL_MINUTE,
+    HISTORY_LEVEL_QUARTER
+};
+
+typedef enum history_level history_level_t;
+
+struct history_summary {
+    uint64_t start;         // time_us_64() of the bucket start (or of the reading for raw ones)
+    uint64_t end;           // end of the bucket, same as start for raw readings
+    int16_t min;
+    int16_t max;
+    int16_t mean;
+    uint32_t count;         // readings that went in
+};
+
+typedef struct history_summary history_summary_t;
+
+#endif
+
+
+// true if the command has a history
+bool history_has_stat(uint8_t cmd);
+
+// adds a reading. only call from core0 (battery.c does it for every reading of the stat)
+void history_add(uint8_t cmd, int32_t value, uint64_t timestamp);
+
+// copies the buckets of one level that overlap from..to (time_us_64() values) into buckets, oldest first.
+// returns how many there were, up to max_buckets. empty buckets are left out. safe to call from both cores
+int history_read(uint8_t cmd, history_level_t level, uint64_t from, uint64_t to, history_summary_t* buckets, int max_buckets);
+
+// min/mean/max of everything between from and to, from the finest level that still goes back to from.
+// buckets that overlap the range count whole. returns false if there aren't any readings in it
+bool history_summarize(uint8_t cmd, uint64_t from, uint64_t to, history_summary_t* summary);
+
+// keeps the stats with a history read at least every HISTORY_MAX_AGE. call before core1 starts, subscriptions are core1's after that
+void init_history();
@@ -0,0 +1,118 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "latency.h"
+#include <stdio.h>
+#include <string.h>
+
+const char* latency_type_names[LATENCY_TYPES] = {
+    [LATENCY_TURNAROUND] = "turnaround",
+    [LATENCY_TRANSACTION] = "transaction",
+};
+
+// counts saturate instead of wrapping
+uint16_t latency_histograms[LATENCY_TYPES][256][LATENCY_BUCKETS];
+
+
+int latency_get_bucket_index(uint32_t us) {
+    int bucket = 0;
+
+    us >>= LATENCY_BUCKET_MIN_SHIFT + 1;
+    while (us > 0 && bucket < LATENCY_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void latency_record(latency_type_t type, uint8_t cmd, uint32_t us) {
+    uint16_t* count = &latency_histograms[type][cmd][latency_get_bucket_index(us)];
+    if (*count < UINT16_MAX) (*count)++;
+}
+
+
+uint16_t latency_get_bucket(latency_type_t type, uint8_t cmd, int bucket) {
+    return latency_histograms[type][cmd][bucket];
+}
+
+uint32_t latency_get_sample_count(latency_type_t type, uint8_t cmd) {
+    uint32_t count = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        count += latency_histograms[type][cmd][i];
+    }
+
+    return count;
+}
+
+int latency_get_percentile_bucket(latency_type_t type, uint8_t cmd, int percentile) {
+    uint32_t count = latency_get_sample_count(type, cmd);
+    uint32_t seen = 0;
+
+    if (count == 0) return -1;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += latency_histograms[type][cmd][i];
+        if (seen * 100 >= count * percentile && seen > 0) return i;
+    }
+
+    return LATENCY_BUCKETS - 1;
+}
+
+void latency_format_bucket(int bucket, char* buffer, size_t length) {
+    bool last = bucket >= LATENCY_BUCKETS - 1;
+    uint32_t limit = 1 << (bucket + LATENCY_BUCKET_MIN_SHIFT + (last ? 0 : 1));
+
+    if (limit < 1000) snprintf(buffer, length, "%c%luu", last ? '>' : '<', (unsigned long) limit);
+    else snprintf(buffer, length, "%c%lum", last ? '>' : '<', (unsigned long) limit / 1000);
+}
+
+
+void latency_dump() {
+    char label[8];
+
+    printf("latency histograms (log2 buckets):\n");
+    printf("%-22s", "cmd");
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        latency_format_bucket(i, label, sizeof(label));
+        printf(" %6s", label);
+    }
+    printf("\n");
+
+    for (int cmd = 0; cmd < 256; cmd++) {
+        for (int type = 0; type < LATENCY_TYPES; type++) {
+            if (latency_get_sample_count(type, cmd) == 0) continue;
+
+            printf("0x%02x %-17s", cmd, latency_type_names[type]);
+            for (int i = 0; i < LATENCY_BUCKETS; i++) {
+                printf(" %6u", latency_histograms[type][cmd][i]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+void latency_reset() {
+    memset(latency_histograms, 0, sizeof(latency_histograms));
+}
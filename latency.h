@@ -0,0 +1,67 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "config.h"
+
+// per command latency histograms for the mitm.
+// every sbs command gets a log2 histogram for each latency type, with bucket n holding samples
+// from 2^(n + LATENCY_BUCKET_MIN_SHIFT) to 2^(n + LATENCY_BUCKET_MIN_SHIFT + 1) microseconds.
+// the first bucket also takes everything faster and the last one everything slower.
+
+#define LATENCY_BUCKETS 12
+#define LATENCY_BUCKET_MIN_SHIFT 7      // first bucket is < 256 us
+
+
+#ifndef LATENCY_TYPE_DEF
+#define LATENCY_TYPE_DEF
+
+enum latency_type {
+    LATENCY_TURNAROUND,     // repeated start from the laptop -> first reply byte sent back (how long the clock got stretched)
+    LATENCY_TRANSACTION,    // first start from the laptop -> stop
+    LATENCY_TYPES
+};
+
+typedef enum latency_type latency_type_t;
+
+#endif
+
+
+// adds a sample. only call this from core0
+void latency_record(latency_type_t type, uint8_t cmd, uint32_t us);
+
+// the histograms are written by core0 without locking, so reading them from core1 can be slightly off (fine for stats)
+uint16_t latency_get_bucket(latency_type_t type, uint8_t cmd, int bucket);
+uint32_t latency_get_sample_count(latency_type_t type, uint8_t cmd);
+
+// index of the bucket the given percentile (0-100) of samples falls in, or -1 if there are no samples
+int latency_get_percentile_bucket(latency_type_t type, uint8_t cmd, int percentile);
+
+// writes the upper limit of a bucket as short text ("<256u", "<4m", ">131m") into the buffer
+void latency_format_bucket(int bucket, char* buffer, size_t length);
+
+// prints all non-empty histograms over usb serial
+void latency_dump();
+void latency_reset();
@@ -0,0 +1,136 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "log.h"
+#include "spsc_ring.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+
+// format strings for each log event. the record args get passed to printf in order
+const char* log_event_formats[LOG_EVENTS] = {
+    [LOG_MITM_TX] = "TX 0x%02x\n",
+    [LOG_MITM_RX] = "RX 0x%02x\n",
+    [LOG_MITM_START] = "START\n",
+    [LOG_MITM_STOP] = "STOP\n",
+    [LOG_MITM_ABORT] = "ABORT\n",
+    [LOG_MITM_ABORT_PREFIX] = "ABORT - ",
+    [LOG_MITM_END_OF_TX] = "end of TX (%d bytes)\n",
+    [LOG_MITM_END_OF_RX] = "end of RX (%d bytes)\n",
+    [LOG_MITM_START_END_OF_RX] = "START - end of RX (%d bytes)\n",
+    [LOG_MITM_SWITCH_TX_RX] = "switching TX -> RX after sending (%d bytes)\n",
+    [LOG_MITM_BATT_ERROR] = "BATT ERROR %d!\n",
+    [LOG_MITM_BATT_ERROR_PREFIX] = "BATT ERROR %d! - ",
+    [LOG_MITM_NO_STOP_AFTER_READ] = "ERROR: no stop after read before write!!!\n",
+    [LOG_MITM_NO_STOP_AFTER_WRITE] = "ERROR: no stop after write before read!!!\n",
+    [LOG_MITM_CMD_BUFFER_OVERRUN] = "ERROR: cmd buffer overrun!!!\n",
+    [LOG_MITM_REPLY_BUFFER_OVERRUN] = "ERROR: reply buffer overrun!!!\n",
+    [LOG_MITM_QUEUE_OVERFLOW] = "ERROR: mitm transfer queue overflow!!! dropped the current transaction\n",
+    [LOG_MITM_PEC_FAILED] = "ERROR: bad pec in the battery's reply to 0x%02x\n",
+    [LOG_MITM_OVERRIDE] = "read command reply override!\n",
+    [LOG_MITM_OVERRIDE_FAILED] = "read command reply override returned %d, trashing response\n",
+    [LOG_MITM_PREFETCHED] = "prefetched %d byte reply\n",
+    [LOG_MITM_PREFETCH_FAILED] = "BATT ERROR %d! - prefetch failed\n",
+    [LOG_MITM_PREFETCH_TOO_LONG] = "block length %d won't fit in reply buffer, not prefetching\n",
+    [LOG_MITM_OVERRIDE_READ] = "reading cmd 0x%02x with override\n",
+    [LOG_MITM_OVERRIDE_READ_OVERRIDE_FAILED] = "failed, override returned %d\n",
+    [LOG_MITM_OVERRIDE_READ_BLOCK_TOO_LONG] = "failed, block length %d doesn't fit in reply buffer size!\n",
+    [LOG_MITM_OVERRIDE_READ_BLOCK_TOO_LARGE] = "failed, block length %d is larger than max result length %d!\n",
+
+    [LOG_SMBUS_READ] = "reading %d bytes from command 0x%02x\n",
+    [LOG_SMBUS_READ_BLOCK] = "reading block from command 0x%02x (max %d bytes)\n",
+    [LOG_SMBUS_WRITE_FAILED] = "failed, write returned %d\n",
+    [LOG_SMBUS_READ_FAILED] = "failed, read returned %d\n",
+    [LOG_SMBUS_BLOCK_SIZE_READ_FAILED] = "failed, block size read returned %d\n",
+    [LOG_SMBUS_BLOCK_READ_FAILED] = "failed, block read returned %d\n",
+    [LOG_SMBUS_CRC_READ_FAILED] = "failed, crc read returned %d\n",
+    [LOG_SMBUS_BLOCK_TOO_LONG] = "block is longer than max_length! block_length = %d, max_length = %d\n",
+    [LOG_SMBUS_CRC_INVALID] = "CRC invalid! recieved 0x%02x != calculated 0x%02x\n",
+    [LOG_SMBUS_ASYNC_FAILED] = "transfer for command 0x%02x failed, returned %d\n",
+    [LOG_SMBUS_ASYNC_UPDATE] = "updating 0x%02x in the background\n",
+
+    [LOG_BATTERY_UPDATE] = "updating 0x%02x\n",
+    [LOG_BATTERY_UPDATE_OVERRIDE] = "using read cmd override for 0x%02x\n",
+};
+
+
+spsc_ring_t log_ring;
+log_record_t log_ring_data[LOG_BUFFER_RECORDS];
+long log_ring_dropped_reported = 0;
+
+// records currently being printed
+log_record_t log_flush_batch[LOG_FLUSH_MAX_RECORDS];
+
+// some messages are printed in multiple parts, only timestamp the start of a line
+bool log_line_start = true;
+
+
+void log_write(uint8_t level, log_event_t event, int arg0, int arg1, int arg2) {
+    log_record_t* record = spsc_ring_claim(&log_ring);
+    if (record == NULL) return;    // counted in log_ring.dropped
+
+    record->timestamp = time_us_32();
+    record->event = event;
+    record->level = level;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+
+    spsc_ring_publish(&log_ring);
+}
+
+void log_flush() {
+    log_record_t* record;
+    const char* format;
+    size_t count = spsc_ring_drain(&log_ring, log_flush_batch, LOG_FLUSH_MAX_RECORDS);
+
+    for (size_t i = 0; i < count; i++) {
+        record = &log_flush_batch[i];
+        format = record->event < LOG_EVENTS ? log_event_formats[record->event] : NULL;
+
+        if (log_line_start) printf("[%10lu] ", (unsigned long) record->timestamp);
+
+        if (format == NULL) {
+            printf("unknown log event %d\n", record->event);
+            log_line_start = true;
+            continue;
+        }
+
+        printf(format, record->args[0], record->args[1], record->args[2]);
+
+        // multi-part lines don't end in a newline
+        log_line_start = format[strlen(format) - 1] == '\n';
+    }
+
+    if (log_ring.dropped != log_ring_dropped_reported) {
+        if (!log_line_start) printf("\n");
+        printf("WARNING: %ld log records dropped\n", log_ring.dropped - log_ring_dropped_reported);
+        log_ring_dropped_reported = log_ring.dropped;
+        log_line_start = true;
+    }
+}
+
+void init_log() {
+    init_spsc_ring(&log_ring, log_ring_data, LOG_BUFFER_RECORDS, sizeof(log_record_t));
+}
@@ -0,0 +1,145 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+// deferred logging
+// instead of formatting and printing right away (slow, especially while the laptop is waiting on us),
+// log calls store a small binary record in a ring buffer. log_flush() formats and prints them later.
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_NONE  3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_BUFFER_RECORDS 256      // must be a power of two
+#define LOG_FLUSH_MAX_RECORDS 16    // max records printed per log_flush() call
+#define LOG_RECORD_MAX_ARGS 3
+
+
+#ifndef LOG_EVENT_DEF
+#define LOG_EVENT_DEF
+
+// every log message has an id. the format string for each one lives in log.c
+enum log_event {
+    // mitm
+    LOG_MITM_TX,
+    LOG_MITM_RX,
+    LOG_MITM_START,
+    LOG_MITM_STOP,
+    LOG_MITM_ABORT,
+    LOG_MITM_ABORT_PREFIX,
+    LOG_MITM_END_OF_TX,
+    LOG_MITM_END_OF_RX,
+    LOG_MITM_START_END_OF_RX,
+    LOG_MITM_SWITCH_TX_RX,
+    LOG_MITM_BATT_ERROR,
+    LOG_MITM_BATT_ERROR_PREFIX,
+    LOG_MITM_NO_STOP_AFTER_READ,
+    LOG_MITM_NO_STOP_AFTER_WRITE,
+    LOG_MITM_CMD_BUFFER_OVERRUN,
+    LOG_MITM_REPLY_BUFFER_OVERRUN,
+    LOG_MITM_QUEUE_OVERFLOW,
+    LOG_MITM_PEC_FAILED,
+    LOG_MITM_OVERRIDE,
+    LOG_MITM_OVERRIDE_FAILED,
+    LOG_MITM_PREFETCHED,
+    LOG_MITM_PREFETCH_FAILED,
+    LOG_MITM_PREFETCH_TOO_LONG,
+    LOG_MITM_OVERRIDE_READ,
+    LOG_MITM_OVERRIDE_READ_OVERRIDE_FAILED,
+    LOG_MITM_OVERRIDE_READ_BLOCK_TOO_LONG,
+    LOG_MITM_OVERRIDE_READ_BLOCK_TOO_LARGE,
+
+    // smbus
+    LOG_SMBUS_READ,
+    LOG_SMBUS_READ_BLOCK,
+    LOG_SMBUS_WRITE_FAILED,
+    LOG_SMBUS_READ_FAILED,
+    LOG_SMBUS_BLOCK_SIZE_READ_FAILED,
+    LOG_SMBUS_BLOCK_READ_FAILED,
+    LOG_SMBUS_CRC_READ_FAILED,
+    LOG_SMBUS_BLOCK_TOO_LONG,
+    LOG_SMBUS_CRC_INVALID,
+    LOG_SMBUS_ASYNC_FAILED,
+    LOG_SMBUS_ASYNC_UPDATE,
+
+    // battery
+    LOG_BATTERY_UPDATE,
+    LOG_BATTERY_UPDATE_OVERRIDE,
+
+    LOG_EVENTS
+};
+
+typedef enum log_event log_event_t;
+
+struct log_record {
+    uint32_t timestamp;     // time_us_32()
+    uint16_t event;
+    uint16_t level;
+    int args[LOG_RECORD_MAX_ARGS];
+};
+
+typedef struct log_record log_record_t;
+
+#endif
+
+
+// records an event with up to LOG_RECORD_MAX_ARGS int arguments. use the macros below instead.
+// only call from core0, never in an interrupt
+void log_write(uint8_t level, log_event_t event, int arg0, int arg1, int arg2);
+
+// prints up to LOG_FLUSH_MAX_RECORDS pending records.
+// call from core0 when nothing time critical is going on
+void log_flush();
+
+void init_log();
+
+
+// levels below LOG_LEVEL compile to nothing
+#define _LOG_ARGS(dummy, arg0, arg1, arg2, ...) arg0, arg1, arg2
+#define _LOG(level, event, ...) log_write(level, event, _LOG_ARGS(0, ##__VA_ARGS__, 0, 0, 0))
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(event, ...) _LOG(LOG_LEVEL_DEBUG, event, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(event, ...) ((void) 0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(event, ...) _LOG(LOG_LEVEL_INFO, event, ##__VA_ARGS__)
+#else
+#define LOG_INFO(event, ...) ((void) 0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(event, ...) _LOG(LOG_LEVEL_ERROR, event, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(event, ...) ((void) 0)
+#endif
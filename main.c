@@ -24,6 +24,13 @@
 #include "mitm.h"
 #include "status.h"
 #include "battery.h"
+#include "log.h"
+#include "trace.h"
+#include "console.h"
+#include "capture.h"
+#include "history.h"
+#include "metrics.h"
+#include "flash_log.h"
 #include "defused/gui.h"
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
@@ -31,8 +38,12 @@
 
 int main() {
     stdio_init_all();
+    init_log();
+    init_trace();
     init_status();
-    init_battery();
+    init_history();
+    init_metrics();
+    if (FLASH_LOG) init_flash_log();
     
     multicore_reset_core1();
     multicore_launch_core1(&init_gui);
@@ -40,6 +51,12 @@ int main() {
     init_mitm();
     while (true) {
         mitm_loop();
+        trace_flush();
+        log_flush();
+        capture_flush();
+        console_poll();
+        capture_update();
         battery_update_cache();
+        flash_log_update();
     }
 }
@@ -0,0 +1,269 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "metrics.h"
+#include "battery.h"
+#include "flash_log.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include <stddef.h>
+
+#define METRICS_MS_PER_HOUR 3600000
+
+// seqlock like the stat cache (see battery.c), only core0 writes
+volatile uint32_t metrics_sequence = 0;
+metrics_t metrics_published;
+
+// latest readings, in the battery's units (capacities in 10 mWh)
+int32_t metrics_voltage = 0;
+int32_t metrics_current = 0;
+int32_t metrics_remaining_capacity = 0;
+int32_t metrics_full_capacity = 0;
+int32_t metrics_design_capacity = 0;
+int16_t metrics_charge = -1;
+uint64_t metrics_current_time = 0;      // 0 if there wasn't a current reading yet
+bool metrics_has_voltage = false;
+bool metrics_has_remaining_capacity = false;
+bool metrics_has_full_capacity = false;
+bool metrics_has_design_capacity = false;
+
+// counted in mA*ms and mW*ms, so short intervals at low current don't round away
+int64_t metrics_charge_in = 0;
+int64_t metrics_charge_out = 0;
+int64_t metrics_energy_in = 0;
+int64_t metrics_energy_out = 0;
+int64_t metrics_session_charge = 0;
+int64_t metrics_session_energy = 0;
+
+// flow the other way than the session's. it's where the next session starts if the new direction sticks
+int64_t metrics_pending_charge = 0;
+int64_t metrics_pending_energy = 0;
+
+// when the direction last stopped matching the session's, 0 if it matches
+uint64_t metrics_direction_since = 0;
+
+
+void metrics_integrate(uint64_t timestamp) {
+    if (metrics_current_time == 0 || timestamp - metrics_current_time > METRICS_MAX_GAP) return;
+
+    int64_t elapsed = (timestamp - metrics_current_time) / 1000;
+    int64_t charge = metrics_current * elapsed;
+    int64_t energy = metrics_published.has_power ? metrics_published.power * elapsed : 0;
+
+    if (charge > 0) metrics_charge_in += charge;
+    else metrics_charge_out -= charge;
+
+    if (energy > 0) metrics_energy_in += energy;
+    else metrics_energy_out -= energy;
+
+    metrics_direction_t session_direction = metrics_published.session.direction;
+    bool with_session = (session_direction == METRICS_CHARGING && charge > 0) || (session_direction == METRICS_DISCHARGING && charge < 0);
+
+    if (with_session) {
+        metrics_session_charge += charge > 0 ? charge : -charge;
+        metrics_session_energy += energy > 0 ? energy : -energy;
+    } else {
+        metrics_pending_charge += charge > 0 ? charge : -charge;
+        metrics_pending_energy += energy > 0 ? energy : -energy;
+    }
+}
+
+void metrics_end_session() {
+    metrics_session_t* session = &metrics_published.session;
+    if (session->direction == METRICS_IDLE) return;
+
+    metrics_published.last_session = *session;
+    metrics_published.session_count++;
+
+    if (FLASH_LOG) {
+        int32_t fields[] = {session->direction, session->duration, session->charge, session->energy, session->peak_power, session->start_charge, session->end_charge};
+        flash_log_append(FLASH_LOG_SESSION, fields, sizeof(fields) / sizeof(fields[0]));
+    }
+
+    session->direction = METRICS_IDLE;
+}
+
+void metrics_start_session(metrics_direction_t direction, uint64_t start) {
+    metrics_published.session = (metrics_session_t) {
+        direction: direction,
+        start: start,
+        start_charge: metrics_charge,
+        end_charge: metrics_charge
+    };
+
+    metrics_session_charge = metrics_pending_charge;
+    metrics_session_energy = metrics_pending_energy;
+}
+
+// a short blip the other way (or to idle) doesn't end a session, it has to last METRICS_SESSION_HOLDOFF
+void metrics_update_session(uint64_t timestamp) {
+    metrics_session_t* session = &metrics_published.session;
+    metrics_direction_t direction = metrics_published.direction;
+
+    if (direction == session->direction) {
+        metrics_direction_since = 0;
+        metrics_pending_charge = 0;
+        metrics_pending_energy = 0;
+    } else {
+        if (metrics_direction_since == 0) metrics_direction_since = timestamp;
+
+        if (session->direction == METRICS_IDLE || timestamp - metrics_direction_since >= METRICS_SESSION_HOLDOFF) {
+            metrics_end_session();
+            if (direction != METRICS_IDLE) metrics_start_session(direction, metrics_direction_since);
+            metrics_direction_since = 0;
+            metrics_pending_charge = 0;
+            metrics_pending_energy = 0;
+        }
+    }
+
+    if (session->direction == METRICS_IDLE) return;
+
+    session->charge = metrics_session_charge / METRICS_MS_PER_HOUR;
+    session->energy = metrics_session_energy / METRICS_MS_PER_HOUR;
+
+    // while it's going the other way the session might be over already, so it's left as it was
+    if (direction != session->direction) return;
+
+    session->duration = (timestamp - session->start) / 1000000;
+    session->end_charge = metrics_charge;
+
+    int32_t power = metrics_published.power < 0 ? -metrics_published.power : metrics_published.power;
+    if (metrics_published.has_power && power > session->peak_power) session->peak_power = power;
+}
+
+// everything that depends on more than one reading
+void metrics_update_derived() {
+    metrics_t* metrics = &metrics_published;
+
+    metrics->charge_in = metrics_charge_in / METRICS_MS_PER_HOUR;
+    metrics->charge_out = metrics_charge_out / METRICS_MS_PER_HOUR;
+    metrics->energy_in = metrics_energy_in / METRICS_MS_PER_HOUR;
+    metrics->energy_out = metrics_energy_out / METRICS_MS_PER_HOUR;
+
+    metrics->has_wear = metrics_has_full_capacity && metrics_has_design_capacity && metrics_design_capacity > 0;
+    if (metrics->has_wear) metrics->wear = 1000 - metrics_full_capacity * 1000 / metrics_design_capacity;
+
+    // capacities are in 10 mWh, so * 10 * 60 for minutes at a power in mW
+    metrics->has_estimate = metrics->has_power && metrics_has_remaining_capacity;
+    metrics->time_to_empty = 0;
+    metrics->time_to_full = 0;
+
+    if (metrics->has_estimate && metrics->direction == METRICS_DISCHARGING) {
+        metrics->time_to_empty = metrics_remaining_capacity * 600 / -metrics->power;
+    } else if (metrics->has_estimate && metrics->direction == METRICS_CHARGING && metrics_has_full_capacity) {
+        int32_t missing = metrics_full_capacity - metrics_remaining_capacity;
+        if (missing > 0) metrics->time_to_full = missing * 600 / metrics->power;
+    }
+}
+
+void metrics_note_reading(uint8_t cmd, int32_t value, uint64_t timestamp) {
+    switch (cmd) {
+        case BATT_CMD_VOLTAGE:
+        case BATT_CMD_CURRENT:
+        case BATT_CMD_REMAINING_CAPACITY:
+        case BATT_CMD_FULL_CHARGE_CAPACITY:
+        case BATT_CMD_DESIGN_CAPACITY:
+        case BATT_CMD_RELATIVE_STATE_OF_CHARGE:
+            break;
+        default:
+            return;
+    }
+
+    metrics_sequence++;
+    __dmb();
+
+    switch (cmd) {
+        case BATT_CMD_VOLTAGE:
+            metrics_voltage = value;
+            metrics_has_voltage = true;
+            break;
+        case BATT_CMD_CURRENT:
+            // the time since the last reading goes at the old current and power
+            metrics_integrate(timestamp);
+            metrics_current = value;
+            metrics_current_time = timestamp;
+
+            metrics_published.has_power = metrics_has_voltage;
+            metrics_published.power = (int64_t) metrics_voltage * metrics_current / 1000;
+
+            if (metrics_current >= METRICS_SESSION_CURRENT) metrics_published.direction = METRICS_CHARGING;
+            else if (metrics_current <= -METRICS_SESSION_CURRENT) metrics_published.direction = METRICS_DISCHARGING;
+            else metrics_published.direction = METRICS_IDLE;
+
+            metrics_update_session(timestamp);
+            break;
+        case BATT_CMD_REMAINING_CAPACITY:
+            metrics_remaining_capacity = value;
+            metrics_has_remaining_capacity = true;
+            break;
+        case BATT_CMD_FULL_CHARGE_CAPACITY:
+            metrics_full_capacity = value;
+            metrics_has_full_capacity = true;
+            break;
+        case BATT_CMD_DESIGN_CAPACITY:
+            metrics_design_capacity = value;
+            metrics_has_design_capacity = true;
+            break;
+        case BATT_CMD_RELATIVE_STATE_OF_CHARGE:
+            metrics_charge = value;
+            break;
+    }
+
+    metrics_update_derived();
+
+    __dmb();
+    metrics_sequence++;
+}
+
+void metrics_read(metrics_t* metrics) {
+    uint32_t sequence;
+
+    do {
+        while ((sequence = metrics_sequence) & 1) tight_loop_contents();
+        __dmb();
+
+        *metrics = metrics_published;
+
+        __dmb();
+    } while (sequence != metrics_sequence);
+}
+
+
+void init_metrics() {
+    const uint8_t cmds[] = {
+        BATT_CMD_VOLTAGE, BATT_CMD_CURRENT, BATT_CMD_REMAINING_CAPACITY, BATT_CMD_RELATIVE_STATE_OF_CHARGE
+    };
+    const uint8_t capacity_cmds[] = {BATT_CMD_FULL_CHARGE_CAPACITY, BATT_CMD_DESIGN_CAPACITY};
+
+    metrics_published.session.start_charge = -1;
+    metrics_published.session.end_charge = -1;
+    metrics_published.last_session = metrics_published.session;
+
+    // only a floor, the metrics take every reading they get (snooped from the laptop or polled for the screens)
+    for (int i = 0; i < sizeof(cmds); i++) {
+        battery_stat_subscribe(battery_get_stat(cmds[i]), METRICS_MAX_AGE);
+    }
+    for (int i = 0; i < sizeof(capacity_cmds); i++) {
+        battery_stat_subscribe(battery_get_stat(capacity_cmds[i]), METRICS_CAPACITY_MAX_AGE);
+    }
+}
@@ -0,0 +1,106 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+// figures derived from the battery stats: power, charge and energy in/out, wear and time estimates,
+// and charge/discharge sessions. core0 updates them once per new reading (from battery.c), in integer math,
+// so the screens and the usb console only read the results and always show the same numbers.
+//
+// charge and energy are counted from BATT_CMD_CURRENT and BATT_CMD_VOLTAGE readings: the last reading is taken to
+// hold until the next one. they're only as good as the read rate, which is at least once every METRICS_MAX_AGE
+// and a lot more often while the laptop or the screens read them.
+
+#define METRICS_MAX_AGE 30000000                // current, voltage and charge are read at least this often (30 sec)
+#define METRICS_CAPACITY_MAX_AGE 1200000000     // full charge and design capacity, only for the wear (20 min)
+#define METRICS_MAX_GAP 120000000               // longer than this between current readings isn't counted (2 min)
+#define METRICS_SESSION_CURRENT 50              // mA, less than this either way is idle
+#define METRICS_SESSION_HOLDOFF 60000000        // a session ends once the direction is different for this long (1 min)
+
+
+#ifndef METRICS_DEF
+#define METRICS_DEF
+
+enum metrics_direction {
+    METRICS_IDLE = 0,
+    METRICS_CHARGING = 1,
+    METRICS_DISCHARGING = 2
+};
+
+typedef enum metrics_direction metrics_direction_t;
+
+struct metrics_session {
+    metrics_direction_t direction;      // METRICS_IDLE if there's no session (yet)
+    uint64_t start;                     // time_us_64()
+    uint32_t duration;                  // seconds
+    uint32_t charge;                    // mAh moved
+    uint32_t energy;                    // mWh moved
+    int32_t peak_power;                 // mW, largest either way
+    int16_t start_charge;               // relative state of charge in %, -1 if unknown
+    int16_t end_charge;
+};
+
+typedef struct metrics_session metrics_session_t;
+
+struct metrics {
+    // power = voltage * current, + is charging
+    bool has_power;
+    int32_t power;                      // mW
+    metrics_direction_t direction;
+
+    // since boot
+    uint32_t charge_in;                 // mAh
+    uint32_t charge_out;
+    uint32_t energy_in;                 // mWh
+    uint32_t energy_out;
+
+    // full charge capacity vs design capacity
+    bool has_wear;
+    int16_t wear;                       // 0.1 %, negative if it holds more than designed
+
+    // from the remaining capacity at the current power, 0 if it's going the other way
+    bool has_estimate;
+    uint32_t time_to_empty;             // minutes
+    uint32_t time_to_full;
+
+    metrics_session_t session;          // the one that's going on
+    metrics_session_t last_session;     // the last one that ended
+    uint32_t session_count;             // since boot
+};
+
+typedef struct metrics metrics_t;
+
+#endif
+
+
+// feeds a new reading of a stat. only call from core0 (battery.c does it for every 2 byte reading)
+void metrics_note_reading(uint8_t cmd, int32_t value, uint64_t timestamp);
+
+// copies the current figures. safe to call from both cores
+void metrics_read(metrics_t* metrics);
+
+// keeps the stats the metrics need read at least every METRICS_MAX_AGE (METRICS_CAPACITY_MAX_AGE for the capacities).
+// call before core1 starts, like init_history
+void init_metrics();
@@ -23,35 +23,14 @@
  */
 #include "mitm.h"
 #include "smbus.h"
-#include "status.h"
 #include "config.h"
-#include "static_queue.h"
+#include "battery.h"
 #include "pico/stdlib.h"
-#include "hardware/irq.h"
-#include <stdio.h>
+#include "log.h"
+#include "trace.h"
 #include "override.h"
-
-enum i2c_transfer_event {
-    I2C_READ,
-    I2C_WRITE,
-    I2C_START,
-    I2C_STOP,
-    I2C_ABORT
-};
-
-typedef enum i2c_transfer_event i2c_transfer_event_t;
-
-struct i2c_transfer {
-    i2c_transfer_event_t event;
-    uint8_t data;
-};
-
-typedef struct i2c_transfer i2c_transfer_t;
-
-#define MITM_QUEUE_ELEMENT_SIZE sizeof(i2c_transfer_t)
-
-static_queue_t* mitm_transfer_queue;
-bool mitm_transfer_queue_overflow = false;
+#include "latency.h"
+#include "poll_schedule.h"
 
 i2c_transfer_event_t previous_event = I2C_ABORT;
 
@@ -60,100 +39,29 @@ size_t mitm_cmd_buffer_index = 0;
 
 uint8_t mitm_reply_buffer[MITM_REPLY_BUFFER_SIZE];
 size_t mitm_reply_buffer_index = 0;
+size_t mitm_reply_prefetch_length = 0;
 bool reply_override = false;
 
+// for the latency histograms
+int mitm_transaction_cmd = -1;              // first byte the laptop wrote in this transaction, -1 if none yet
+uint32_t mitm_transaction_start_time = 0;
+uint32_t mitm_repeated_start_time = 0;
 
-void mitm_laptop_on_i2c_event(i2c_transfer_event_t event) {
-    i2c_transfer_t* transfer = static_queue_add(mitm_transfer_queue);
-    if (transfer == NULL) {
-        mitm_transfer_queue_overflow = true;
-        return;
-    }
-
-    transfer->event = event;
-    if (event == I2C_WRITE) i2c_read_raw_blocking(LAPTOP_I2C, &transfer->data, 1);
-}
-
-void mitm_laptop_irq_handler() {
-    i2c_hw_t* hw = i2c_get_hw(LAPTOP_I2C);
-    uint32_t stat = hw->intr_stat;
-    if (stat == 0) return;
-    if (mitm_transfer_queue_overflow) return;
-
-    if (stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
-        hw->clr_tx_abrt;
-        mitm_laptop_on_i2c_event(I2C_ABORT);
-    }
-
-    if (stat & I2C_IC_INTR_STAT_R_START_DET_BITS) {
-        hw->clr_start_det;
-        mitm_laptop_on_i2c_event(I2C_START);
-    }
-
-    if (stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
-        hw->clr_stop_det;
-        mitm_laptop_on_i2c_event(I2C_STOP);
-    }
-
-
-    if (stat & I2C_IC_INTR_STAT_R_RX_FULL_BITS) {
-        mitm_laptop_on_i2c_event(I2C_WRITE);
-    }
-
-    if (stat & I2C_IC_INTR_STAT_R_RD_REQ_BITS) {
-        hw->clr_rd_req;
-        mitm_laptop_on_i2c_event(I2C_READ);
-    }
-}
-
+// running pec of everything on the laptop's bus in this transaction, to check the battery's replies on the way through
+uint8_t mitm_pec = 0;
+bool mitm_pec_address_pending = false;      // a start happened, its address byte goes in with the next read/write
+bool mitm_pec_is_reply = false;             // the current read is the reply to a read command (not overridden)
 
-void mitm_init_i2c() {
-    // init batt i2c
-    gpio_set_function(BATT_I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(BATT_I2C_SCL_PIN, GPIO_FUNC_I2C);
-    i2c_init(BATT_I2C, BATT_I2C_BAUD);
-    if (BATT_I2C_PULL_UP) {
-        gpio_pull_up(BATT_I2C_SDA_PIN);
-        gpio_pull_up(BATT_I2C_SCL_PIN);
-    }
-
-    // init laptop i2c
-    gpio_set_function(LAPTOP_I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(LAPTOP_I2C_SCL_PIN, GPIO_FUNC_I2C);
-    i2c_init(LAPTOP_I2C, LAPTOP_I2C_BAUD);
-    if (LAPTOP_I2C_PULL_UP) {
-        gpio_pull_up(LAPTOP_I2C_SDA_PIN);
-        gpio_pull_up(LAPTOP_I2C_SCL_PIN);
-    }
-
-    i2c_set_slave_mode(LAPTOP_I2C, true, LAPTOP_I2C_ADDR);
-
-    // manually set up irq
-    uint i2c_irq = I2C0_IRQ + i2c_hw_index(LAPTOP_I2C);
-    i2c_get_hw(LAPTOP_I2C)->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_START_DET_BITS;
-    irq_set_exclusive_handler(i2c_irq, &mitm_laptop_irq_handler);
-    irq_set_enabled(i2c_irq, true);
-}
-
-void mitm_reinit_i2c() {
-    uint i2c_irq = I2C0_IRQ + i2c_hw_index(LAPTOP_I2C);
-    irq_set_enabled(i2c_irq, false);
-    irq_remove_handler(i2c_irq, &mitm_laptop_irq_handler);
-    i2c_get_hw(LAPTOP_I2C)->intr_mask = I2C_IC_INTR_MASK_RESET;
-
-    i2c_set_slave_mode(LAPTOP_I2C, false, LAPTOP_I2C_ADDR);
-    i2c_deinit(BATT_I2C);
-    i2c_deinit(LAPTOP_I2C);
-
-    sleep_ms(1000);
-    mitm_transfer_queue_overflow = false;
-
-    mitm_init_i2c();
-}
+// passthrough replies with a bad pec, per command (saturating)
+uint16_t mitm_pec_failures[256];
+unsigned long mitm_pec_checked_count = 0;
+unsigned long mitm_pec_failed_count = 0;
 
 
 int mitm_read_batt_reply(uint8_t* buffer, size_t length) {
-    return i2c_read_burst_blocking(BATT_I2C, BATT_I2C_ADDR, buffer, length);
+    int ret = i2c_read_burst_blocking(BATT_I2C, BATT_I2C_ADDR, buffer, length);
+    TRACE_BYTES(TRACE_BMS_READ, buffer, length, ret);
+    return ret;
 }
 
 bool mitm_validate_batt_reply(uint8_t* buffer, uint8_t crc_index, bool is_block) {
@@ -182,170 +90,318 @@ int mitm_generate_reply_crc(uint8_t* buffer, uint8_t crc_index, bool is_block) {
 }
 
 
-void init_mitm() {
-    mitm_transfer_queue = create_static_queue(MITM_QUEUE_MAX_ELEMENTS, MITM_QUEUE_ELEMENT_SIZE);
-    mitm_init_i2c();
+// expected reply length (excluding crc) of the read commands we know about.
+// returns 0 for unknown commands, which get forwarded byte by byte instead.
+// for block reads is_block is set and only the length byte is counted, since the rest depends on it.
+uint8_t mitm_get_read_command_reply_length(uint8_t cmd, bool* is_block) {
+    *is_block = false;
+
+    switch (cmd) {
+        case BATT_CMD_MANUFACTURER_ACCESS:
+        case BATT_CMD_REMAINING_CAPACITY_ALARM:
+        case BATT_CMD_REMAINING_TIME_ALARM:
+        case BATT_CMD_BATTERY_MODE:
+        case BATT_CMD_AT_RATE:
+        case BATT_CMD_AT_RATE_TIME_TO_FULL:
+        case BATT_CMD_AT_RATE_TIME_TO_EMPTY:
+        case BATT_CMD_AT_RATE_OK:
+        case BATT_CMD_TEMPERATURE:
+        case BATT_CMD_VOLTAGE:
+        case BATT_CMD_CURRENT:
+        case BATT_CMD_AVERAGE_CURRENT:
+        case BATT_CMD_MAX_ERROR:
+        case BATT_CMD_RELATIVE_STATE_OF_CHARGE:
+        case BATT_CMD_ABSOLUTE_STATE_OF_CHARGE:
+        case BATT_CMD_REMAINING_CAPACITY:
+        case BATT_CMD_FULL_CHARGE_CAPACITY:
+        case BATT_CMD_RUN_TIME_TO_EMPTY:
+        case BATT_CMD_AVERAGE_TIME_TO_EMPTY:
+        case BATT_CMD_AVERAGE_TIME_TO_FULL:
+        case BATT_CMD_CHARGING_CURRENT:
+        case BATT_CMD_CHARGING_VOLTAGE:
+        case BATT_CMD_BATTERY_STATUS:
+        case BATT_CMD_CYCLE_COUNT:
+        case BATT_CMD_DESIGN_CAPACITY:
+        case BATT_CMD_DESIGN_VOLTAGE:
+        case BATT_CMD_SPECIFICATION_INFO:
+        case BATT_CMD_MANUFACTURE_DATE:
+        case BATT_CMD_SERIAL_NUMBER:
+            return 2;
+
+        case BATT_CMD_MANUFACTURER_NAME:
+        case BATT_CMD_DEVICE_NAME:
+        case BATT_CMD_DEVICE_CHEMISTRY:
+        case BATT_CMD_MANUFACTURER_DATA:
+            *is_block = true;
+            return 1;
+
+        default:
+            return 0;
+    }
 }
 
-
-void mitm_loop() {
+// reads the whole reply (+ crc) from the battery into the reply buffer in one go,
+// so the laptop doesn't have to wait on a battery round trip for every byte.
+// returns the number of bytes now in the reply buffer. anything past that gets forwarded byte by byte.
+size_t mitm_prefetch_batt_reply(uint8_t cmd) {
+    bool is_block;
+    uint8_t length = mitm_get_read_command_reply_length(cmd, &is_block);
     int ret;
-    i2c_dev_t* laptop = get_laptop_dev();
-    i2c_dev_t* bms = get_bms_dev();
 
-    i2c_transfer_t* transfer;
+    if (length == 0) return 0;  // unknown command
 
-    if (mitm_transfer_queue_overflow) {
-        printf("ERROR: mitm transfer queue overflow!!! please increase MITM_QUEUE_MAX_ELEMENTS\n");
-        
-        // flush the queue
-        do {
-            transfer = static_queue_pop(mitm_transfer_queue);
-        } while (transfer != NULL);
+    if (!is_block) {
+        ret = mitm_read_batt_reply(mitm_reply_buffer, length + 1);
+        if (ret < 0) {
+            LOG_ERROR(LOG_MITM_PREFETCH_FAILED, ret);
+            return 0;
+        }
+        return length + 1;
+    }
 
-        // drop off the bus temporarily
-        mitm_reinit_i2c();
+    // blocks need the length byte first
+    ret = mitm_read_batt_reply(mitm_reply_buffer, 1);
+    if (ret < 0) {
+        LOG_ERROR(LOG_MITM_PREFETCH_FAILED, ret);
+        return 0;
     }
 
-    do {
-        transfer = static_queue_peek(mitm_transfer_queue);
-        if (transfer == NULL) continue;
-        if (mitm_transfer_queue_overflow) break;
+    // length byte + block + crc have to fit (the last byte of the buffer is never read out)
+    if (mitm_reply_buffer[0] + 3 > MITM_REPLY_BUFFER_SIZE) {
+        LOG_ERROR(LOG_MITM_PREFETCH_TOO_LONG, mitm_reply_buffer[0]);
+        return 1;
+    }
 
-        status_mitm(true);
-        
-        switch (transfer->event) {
-            case I2C_WRITE:
+    ret = mitm_read_batt_reply(&mitm_reply_buffer[1], mitm_reply_buffer[0] + 1);
+    if (ret < 0) {
+        LOG_ERROR(LOG_MITM_PREFETCH_FAILED, ret);
+        return 1;
+    }
+    return mitm_reply_buffer[0] + 2;
+}
 
-                // this should never happen
-                if (previous_event == I2C_READ) {
-                    printf("ERROR: no stop after read before write!!!\n");
-                    break;
-                }
 
-                if (mitm_cmd_buffer_index + 1 >= MITM_CMD_BUFFER_SIZE) {
-                    printf("ERROR: cmd buffer overrun!!!\n");
-                    break;
-                }
-                
-                // write previous byte
-                if (mitm_cmd_buffer_index > 0) {
-                    ret = i2c_write_burst_blocking(bms->i2c, bms->address, &mitm_cmd_buffer[mitm_cmd_buffer_index - 1], 1);
-                    if (ret < 0) printf("BATT ERROR %d!\n", ret);
-                }
+void mitm_pec_update(uint8_t data, bool is_read) {
+    if (mitm_pec_address_pending) {
+        mitm_pec = smbus_pec_update(mitm_pec, (BATT_I2C_ADDR << 1) | is_read);
+        mitm_pec_address_pending = false;
+    }
+    mitm_pec = smbus_pec_update(mitm_pec, data);
+}
 
-                mitm_cmd_buffer[mitm_cmd_buffer_index++] = transfer->data;
+// checks the reply the laptop just got, if it read all of it including the pec.
+// the running pec comes out as 0 when the pec byte matches.
+void mitm_check_reply_pec() {
+    bool is_block;
+    uint8_t cmd = mitm_cmd_buffer[0];
+    uint8_t length = mitm_get_read_command_reply_length(cmd, &is_block);
+    size_t expected_length;
 
-                printf("TX 0x%02x\n", mitm_cmd_buffer[mitm_cmd_buffer_index-1]);
+    if (!mitm_pec_is_reply || length == 0) return;
 
-                break;
-            case I2C_READ:
-
-                // this should never happen
-                if (previous_event == I2C_WRITE) {
-                    printf("ERROR: no stop after write before read!!!\n");
-                    mitm_reply_buffer[0] = 0;
-                    i2c_write_raw_blocking(laptop->i2c, mitm_reply_buffer, 1);
-                    break;
-                }
+    expected_length = is_block ? mitm_reply_buffer[0] + 2 : length + 1;
+    if (mitm_reply_buffer_index != expected_length) return;
 
-                if (mitm_reply_buffer_index + 1 >= MITM_REPLY_BUFFER_SIZE) {
-                    printf("ERROR: reply buffer overrun!!!\n");
-                    mitm_reply_buffer[0] = 0;
-                    i2c_write_raw_blocking(laptop->i2c, mitm_reply_buffer, 1);
-                    break;
-                }
+    mitm_pec_checked_count++;
 
-                if (reply_override) {
-                    // forward modified reply
-                    i2c_write_raw_blocking(laptop->i2c, &mitm_reply_buffer[mitm_reply_buffer_index], 1);
-                } else {
-                    // forward reply from bms
-                    ret = i2c_read_burst_blocking(bms->i2c, bms->address, &mitm_reply_buffer[mitm_reply_buffer_index], 1);
-                    if (ret < 0) printf("BATT ERROR %d! - ", ret);
-                    i2c_write_raw_blocking(laptop->i2c, &mitm_reply_buffer[mitm_reply_buffer_index], 1);
-                }
+    if (mitm_pec == 0) {
+        // good reply, the gui can have it too
+        if (MITM_SNOOP_STATS) battery_stat_snoop_reply(cmd, is_block ? &mitm_reply_buffer[1] : mitm_reply_buffer, is_block ? mitm_reply_buffer[0] : length);
+        return;
+    }
 
-                printf("RX 0x%02x\n", mitm_reply_buffer[mitm_reply_buffer_index]);
+    mitm_pec_failed_count++;
+    if (mitm_pec_failures[cmd] < UINT16_MAX) mitm_pec_failures[cmd]++;
+    LOG_ERROR(LOG_MITM_PEC_FAILED, cmd);
+}
+
+
+// handles a single event from the laptop, forwarding it to the battery as needed
+void mitm_process_transfer(i2c_transfer_t* transfer) {
+    int ret;
+    i2c_dev_t* bms = get_bms_dev();
 
-                mitm_reply_buffer_index++;
+    switch (transfer->event) {
+        case I2C_WRITE:
+
+            // this should never happen
+            if (previous_event == I2C_READ) {
+                LOG_ERROR(LOG_MITM_NO_STOP_AFTER_READ);
                 break;
-            case I2C_ABORT:
-            case I2C_STOP:
-                bool aborted = transfer->event == I2C_ABORT;
-
-                if (previous_event == I2C_WRITE) {
-                    ret = i2c_write_timeout_us(bms->i2c, bms->address, mitm_cmd_buffer + mitm_cmd_buffer_index - 1, 1, false, bms->timeout);
-                    if (aborted) printf("ABORT - ");
-                    if (ret < 0) printf("BATT ERROR %d! - ", ret);
-                    printf("end of TX (%d bytes)\n", mitm_cmd_buffer_index);
-                } else if (previous_event == I2C_READ) {
-                    ret = i2c_stop_read_blocking(bms);
-                    if (aborted) printf("ABORT - ");
-                    if (ret < 0) printf("BATT ERROR %d! - ", ret);
-                    printf("end of RX (%d bytes)\n", mitm_reply_buffer_index);
-                } else {
-                    if (aborted) printf("ABORT\n");
-                    else printf("STOP\n");
-                }
+            }
+
+            if (mitm_cmd_buffer_index + 1 >= MITM_CMD_BUFFER_SIZE) {
+                LOG_ERROR(LOG_MITM_CMD_BUFFER_OVERRUN);
+                break;
+            }
+            
+            // write previous byte
+            if (mitm_cmd_buffer_index > 0) {
+                ret = i2c_write_burst_blocking(bms->i2c, bms->address, &mitm_cmd_buffer[mitm_cmd_buffer_index - 1], 1);
+                TRACE(TRACE_BMS_WRITE, mitm_cmd_buffer[mitm_cmd_buffer_index - 1], ret);
+                if (ret < 0) LOG_ERROR(LOG_MITM_BATT_ERROR, ret);
+            }
+
+            mitm_cmd_buffer[mitm_cmd_buffer_index++] = transfer->data;
+            if (mitm_transaction_cmd < 0) {
+                mitm_transaction_cmd = transfer->data;
+                poll_schedule_note_laptop(mitm_transaction_cmd, mitm_transaction_start_time);
+            }
+            mitm_pec_update(transfer->data, false);
+
+            LOG_DEBUG(LOG_MITM_TX, mitm_cmd_buffer[mitm_cmd_buffer_index-1]);
+
+            break;
+        case I2C_READ:
+
+            // this should never happen
+            if (previous_event == I2C_WRITE) {
+                LOG_ERROR(LOG_MITM_NO_STOP_AFTER_WRITE);
+                mitm_laptop_reply(0);
+                mitm_pec_is_reply = false;
+                break;
+            }
 
-                mitm_cmd_buffer_index = 0;
-                mitm_reply_buffer_index = 0;
-                reply_override = false;
+            if (mitm_reply_buffer_index + 1 >= MITM_REPLY_BUFFER_SIZE) {
+                LOG_ERROR(LOG_MITM_REPLY_BUFFER_OVERRUN);
+                mitm_laptop_reply(0);
+                mitm_pec_is_reply = false;
                 break;
-            case I2C_START:
-                reply_override = false;
-
-                if (previous_event == I2C_WRITE) {
-                    ret = i2c_write_timeout_us(bms->i2c, bms->address, mitm_cmd_buffer + mitm_cmd_buffer_index - 1, 1, true, bms->timeout);
-                    printf("switching TX -> RX after sending (%d bytes)\n", mitm_cmd_buffer_index);
-                    if (ret < 0) printf("BATT ERROR %d!\n", ret);
-                    else if (mitm_cmd_buffer_index == 1) { // read command
-                        // apply read command overrides
-                        cmd_reply_override override = get_read_command_reply_override(mitm_cmd_buffer[0]);
-                        if (override != NULL) {
-                            reply_override = true;
-                            printf("read command reply override!\n");
-                            int ret = override(mitm_cmd_buffer[0], mitm_reply_buffer);
-                            if (ret < 0) {
-                                printf("read command reply override returned %d, trashing response\n", ret);
-                                // since the slave can't abort the transfer, this is the best we can do
-                                for (int i = 0; i < MITM_REPLY_BUFFER_SIZE; i++) {
-                                    mitm_reply_buffer[i] = 0;
-                                }
+            }
+
+            if (reply_override || mitm_reply_buffer_index < mitm_reply_prefetch_length) {
+                // forward modified or prefetched reply
+                mitm_laptop_reply(mitm_reply_buffer[mitm_reply_buffer_index]);
+            } else {
+                // forward reply from bms
+                ret = i2c_read_burst_blocking(bms->i2c, bms->address, &mitm_reply_buffer[mitm_reply_buffer_index], 1);
+                TRACE(TRACE_BMS_READ, mitm_reply_buffer[mitm_reply_buffer_index], ret);
+                if (ret < 0) LOG_ERROR(LOG_MITM_BATT_ERROR_PREFIX, ret);
+                mitm_laptop_reply(mitm_reply_buffer[mitm_reply_buffer_index]);
+            }
+
+            TRACE(TRACE_LAPTOP_REPLY, mitm_reply_buffer[mitm_reply_buffer_index], 0);
+            mitm_pec_update(mitm_reply_buffer[mitm_reply_buffer_index], true);
+
+            // first byte after the repeated start is the one the laptop was waiting on
+            if (MITM_LATENCY_STATS && previous_event == I2C_START && mitm_transaction_cmd >= 0)
+                latency_record(LATENCY_TURNAROUND, mitm_transaction_cmd, time_us_32() - mitm_repeated_start_time);
+
+            LOG_DEBUG(LOG_MITM_RX, mitm_reply_buffer[mitm_reply_buffer_index]);
+
+            mitm_reply_buffer_index++;
+            break;
+        case I2C_ABORT:
+        case I2C_STOP:
+            bool aborted = transfer->event == I2C_ABORT;
+
+            if (previous_event == I2C_WRITE) {
+                ret = i2c_write_timeout_us(bms->i2c, bms->address, mitm_cmd_buffer + mitm_cmd_buffer_index - 1, 1, false, bms->timeout);
+                TRACE(TRACE_BMS_WRITE_STOP, mitm_cmd_buffer[mitm_cmd_buffer_index - 1], ret);
+                if (aborted) LOG_DEBUG(LOG_MITM_ABORT_PREFIX);
+                if (ret < 0) LOG_ERROR(LOG_MITM_BATT_ERROR_PREFIX, ret);
+                LOG_DEBUG(LOG_MITM_END_OF_TX, mitm_cmd_buffer_index);
+            } else if (previous_event == I2C_READ) {
+                ret = i2c_stop_read_blocking(bms);
+                TRACE(TRACE_BMS_STOP, 0, ret);
+                if (aborted) LOG_DEBUG(LOG_MITM_ABORT_PREFIX);
+                if (ret < 0) LOG_ERROR(LOG_MITM_BATT_ERROR_PREFIX, ret);
+                LOG_DEBUG(LOG_MITM_END_OF_RX, mitm_reply_buffer_index);
+            } else {
+                if (aborted) LOG_DEBUG(LOG_MITM_ABORT);
+                else LOG_DEBUG(LOG_MITM_STOP);
+            }
+
+            if (MITM_LATENCY_STATS && !aborted && mitm_transaction_cmd >= 0)
+                latency_record(LATENCY_TRANSACTION, mitm_transaction_cmd, transfer->timestamp - mitm_transaction_start_time);
+
+            if (!aborted && previous_event == I2C_READ) mitm_check_reply_pec();
+            mitm_pec_is_reply = false;
+
+            mitm_cmd_buffer_index = 0;
+            mitm_reply_buffer_index = 0;
+            mitm_reply_prefetch_length = 0;
+            reply_override = false;
+            mitm_transaction_cmd = -1;
+            break;
+        case I2C_START:
+            reply_override = false;
+            mitm_reply_prefetch_length = 0;
+
+            if (mitm_transaction_finished()) {
+                mitm_transaction_start_time = transfer->timestamp;
+                mitm_transaction_cmd = -1;
+                mitm_pec = 0;
+            } else {
+                mitm_repeated_start_time = transfer->timestamp;
+            }
+
+            if (previous_event == I2C_WRITE) {
+                ret = i2c_write_timeout_us(bms->i2c, bms->address, mitm_cmd_buffer + mitm_cmd_buffer_index - 1, 1, true, bms->timeout);
+                TRACE(TRACE_BMS_WRITE, mitm_cmd_buffer[mitm_cmd_buffer_index - 1], ret);
+                LOG_DEBUG(LOG_MITM_SWITCH_TX_RX, mitm_cmd_buffer_index);
+                if (ret < 0) LOG_ERROR(LOG_MITM_BATT_ERROR, ret);
+                else if (mitm_cmd_buffer_index == 1) { // read command
+                    // apply read command overrides
+                    cmd_reply_override override = get_read_command_reply_override(mitm_cmd_buffer[0]);
+                    if (override != NULL) {
+                        reply_override = true;
+                        LOG_DEBUG(LOG_MITM_OVERRIDE);
+                        int ret = override(mitm_cmd_buffer[0], mitm_reply_buffer);
+                        if (ret < 0) {
+                            LOG_ERROR(LOG_MITM_OVERRIDE_FAILED, ret);
+                            // since the slave can't abort the transfer, this is the best we can do
+                            for (int i = 0; i < MITM_REPLY_BUFFER_SIZE; i++) {
+                                mitm_reply_buffer[i] = 0;
                             }
                         }
+                    } else if (MITM_REPLY_PREFETCH) {
+                        mitm_reply_prefetch_length = mitm_prefetch_batt_reply(mitm_cmd_buffer[0]);
+                        if (mitm_reply_prefetch_length > 0) LOG_DEBUG(LOG_MITM_PREFETCHED, mitm_reply_prefetch_length);
                     }
-
-                } else if (previous_event == I2C_READ) {
-                    printf("START - end of RX (%d bytes)\n", mitm_reply_buffer_index);
-                } else {
-                    printf("START\n");
                 }
 
-                mitm_cmd_buffer_index = 0;
-                mitm_reply_buffer_index = 0;
-                break;
-            default:
-                break;
-        }
+            } else if (previous_event == I2C_READ) {
+                LOG_DEBUG(LOG_MITM_START_END_OF_RX, mitm_reply_buffer_index);
+            } else {
+                LOG_DEBUG(LOG_MITM_START);
+            }
+
+            // only replies that come straight from the battery are worth checking
+            mitm_pec_is_reply = previous_event == I2C_WRITE && mitm_cmd_buffer_index == 1 && !reply_override;
+            mitm_pec_address_pending = true;
+
+            mitm_cmd_buffer_index = 0;
+            mitm_reply_buffer_index = 0;
+            break;
+        default:
+            break;
+    }
 
-        previous_event = transfer->event;
-        static_queue_pop(mitm_transfer_queue);
+    previous_event = transfer->event;
+}
 
-    } while (transfer != NULL || (previous_event != I2C_STOP && previous_event != I2C_ABORT));
+bool mitm_transaction_finished() {
+    return previous_event == I2C_STOP || previous_event == I2C_ABORT;
+}
 
-    status_mitm(false);
+unsigned long mitm_get_pec_failures(uint8_t cmd) {
+    return mitm_pec_failures[cmd];
+}
 
+void mitm_get_pec_stats(unsigned long* checked, unsigned long* failed) {
+    *checked = mitm_pec_checked_count;
+    *failed = mitm_pec_failed_count;
 }
 
+
 int mitm_smbus_read_with_override(i2c_dev_t* device, uint8_t cmd, uint8_t* result, size_t length, bool is_block, cmd_reply_override override) {
     int ret;
     uint8_t block_length;
     
     if (length > MITM_REPLY_BUFFER_SIZE - 1) return -1;
 
-    printf("reading cmd 0x%02x with override\n", cmd);
+    LOG_INFO(LOG_MITM_OVERRIDE_READ, cmd);
     
     // set up for read cmd
     mitm_cmd_buffer[0] = cmd;
@@ -353,7 +409,7 @@ int mitm_smbus_read_with_override(i2c_dev_t* device, uint8_t cmd, uint8_t* resul
 
     ret = i2c_write_timeout_us(device->i2c, device->address, mitm_cmd_buffer, mitm_cmd_buffer_index, true, device->timeout);
     if (ret < 0) {
-        printf("failed, write returned %d\n", ret);
+        LOG_ERROR(LOG_SMBUS_WRITE_FAILED, ret);
         return SMBUS_ERROR_DEVICE;
     }
     
@@ -361,7 +417,7 @@ int mitm_smbus_read_with_override(i2c_dev_t* device, uint8_t cmd, uint8_t* resul
     ret = override(cmd, mitm_reply_buffer);
     i2c_stop_read_blocking(device);
     if (ret < 0) {
-        printf("failed, override returned %d\n", ret);
+        LOG_ERROR(LOG_MITM_OVERRIDE_READ_OVERRIDE_FAILED, ret);
         return SMBUS_ERROR_CRC;    // pretend it was corrupted
     }
 
@@ -370,16 +426,16 @@ int mitm_smbus_read_with_override(i2c_dev_t* device, uint8_t cmd, uint8_t* resul
     if (is_block) {
         block_length = mitm_reply_buffer[0];
         if (block_length > MITM_REPLY_BUFFER_SIZE - 2) {
-            printf("failed, block length %d doesn't fit in reply buffer size!", block_length);
+            LOG_ERROR(LOG_MITM_OVERRIDE_READ_BLOCK_TOO_LONG, block_length);
             return SMBUS_ERROR_CRC;  
         }
         if (block_length > length) {
-            printf("failed, block length %d is larger than max result length %d!", block_length, length);
+            LOG_ERROR(LOG_MITM_OVERRIDE_READ_BLOCK_TOO_LARGE, block_length, length);
             return SMBUS_ERROR_CRC;
         }
     }
 
-    if (!mitm_validate_batt_reply(mitm_reply_buffer, is_block ? block_length + 1 : length, is_block)) return SMBUS_ERROR_CRC;
+    if (!mitm_validate_batt_reply(mitm_reply_buffer, is_block ? (size_t) block_length + 1 : length, is_block)) return SMBUS_ERROR_CRC;
 
     // copy to result buffer
     for (uint i = 0; i < (is_block ? block_length : length); i++) {
@@ -392,7 +448,7 @@ int mitm_smbus_read_with_override(i2c_dev_t* device, uint8_t cmd, uint8_t* resul
 int mitm_smbus_read_text_with_override(i2c_dev_t* device, uint8_t cmd, char* result, size_t max_length, cmd_reply_override override) {
     int ret;
     
-    ret = mitm_smbus_read_with_override(device, cmd, result, max_length, true, override);
+    ret = mitm_smbus_read_with_override(device, cmd, (uint8_t*) result, max_length, true, override);
     if (ret < 0) return ret;
 
     // search for possible null termination
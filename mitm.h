@@ -26,12 +26,38 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define MITM_QUEUE_MAX_ELEMENTS 100
+#define MITM_QUEUE_MAX_ELEMENTS 128   // must be a power of two
+#define MITM_QUEUE_RESERVE 24         // free queue slots left when the laptop gets held back (the rx fifo is 16 bytes deep)
 
 #define MITM_CMD_BUFFER_SIZE 64
 #define MITM_REPLY_BUFFER_SIZE 64
 
 
+#ifndef I2C_TRANSFER_DEF
+#define I2C_TRANSFER_DEF
+
+// events seen on the laptop side of the bus
+enum i2c_transfer_event {
+    I2C_READ,
+    I2C_WRITE,
+    I2C_START,
+    I2C_STOP,
+    I2C_ABORT
+};
+
+typedef enum i2c_transfer_event i2c_transfer_event_t;
+
+struct i2c_transfer {
+    i2c_transfer_event_t event;
+    uint8_t data;
+    uint32_t timestamp;     // time_us_32() when the event happened
+};
+
+typedef struct i2c_transfer i2c_transfer_t;
+
+#endif
+
+
 // used to override the reply for any SBS read command
 // cmd -> sbs command
 // reply_buffer -> a buffer to place the new reply into. max size = MITM_REPLY_BUFFER_SIZE 
@@ -62,6 +88,49 @@ int mitm_generate_reply_crc(uint8_t* buffer, uint8_t crc_index, bool is_block);
 void init_mitm();
 void mitm_loop();
 
+// the mitm state machine. feed it laptop events in order and it forwards them to the battery.
+// only talks to the bus through the pico i2c functions, so it also runs off-target (see tools/replay).
+void mitm_process_transfer(i2c_transfer_t* transfer);
+
+// true once the last transaction from the laptop has ended (stop or abort)
+bool mitm_transaction_finished();
+
+// battery replies are checked against their pec on the way to the laptop (when the laptop reads the pec).
+// failures per command, and the total number of replies checked/failed
+unsigned long mitm_get_pec_failures(uint8_t cmd);
+void mitm_get_pec_stats(unsigned long* checked, unsigned long* failed);
+
+// answers the laptop's pending read request with one byte.
+// implemented by the laptop backend (mitm_laptop_i2c.c or mitm_laptop_pio.c, see LAPTOP_I2C_PIO)
+void mitm_laptop_reply(uint8_t data);
+
+// stops answering the laptop: its address isn't acked, so to the laptop the battery is just gone for a moment
+// and it retries, instead of being held on the bus. for things that keep the irqs off longer than the smbus
+// timeout (see flash_log.h). returns false if the laptop was on the bus already, then nothing changed.
+// only call while mitm_transaction_finished() and nothing is pending, and attach again right after
+bool mitm_laptop_detach();
+void mitm_laptop_attach();
+
+
+#ifndef MITM_FLOW_STATS_DEF
+#define MITM_FLOW_STATS_DEF
+
+struct mitm_flow_stats {
+    unsigned long flow_control_count;   // times the laptop was held back because the queue was nearly full
+    unsigned long overflow_count;       // transactions dropped because the queue filled up anyway
+    unsigned long discarded_events;     // events of those transactions that were queued already and got flushed
+    size_t queue_high_water;            // most events ever waiting in the queue
+};
+
+typedef struct mitm_flow_stats mitm_flow_stats_t;
+
+#endif
+
+void mitm_get_flow_stats(mitm_flow_stats_t* stats);
+
+// true if laptop events are waiting to be processed by mitm_loop
+bool mitm_laptop_pending();
+
 
 // like the smbus read functions but applies an override
 int mitm_smbus_read_with_override(i2c_dev_t* device, uint8_t cmd, uint8_t* result, size_t length, bool is_block, cmd_reply_override override);
@@ -0,0 +1,178 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "mitm.h"
+#include "mitm_laptop.h"
+#include "status.h"
+#include "config.h"
+#include "spsc_ring.h"
+#include "smbus_async.h"
+#include "poll_schedule.h"
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "log.h"
+#include "trace.h"
+
+// the laptop side event queue. the backend's irq queues up events
+// and mitm_loop feeds them to the mitm state machine in mitm.c
+
+#define MITM_QUEUE_ELEMENT_SIZE sizeof(i2c_transfer_t)
+
+// filled by the laptop irq, drained by mitm_loop
+spsc_ring_t mitm_transfer_queue;
+i2c_transfer_t mitm_transfer_queue_data[MITM_QUEUE_MAX_ELEMENTS];
+
+// transfers drained from the queue that are being processed
+i2c_transfer_t mitm_transfer_batch[MITM_QUEUE_MAX_ELEMENTS];
+
+// overflow recovery: if the queue fills up anyway, the irq drops the rest of the laptop's transaction.
+// mitm_loop flushes the queue and closes the battery side, then the irq picks up again at the next start.
+volatile bool mitm_transfer_queue_overflow = false;
+volatile bool mitm_overflow_cleared = false;
+volatile bool mitm_overflow_transaction_ended = false;
+
+mitm_flow_stats_t mitm_flow_stats;
+
+
+bool mitm_laptop_queue_event(i2c_transfer_event_t event, uint8_t data) {
+    bool ends_transaction = event == I2C_STOP || event == I2C_ABORT;
+
+    if (mitm_transfer_queue_overflow) {
+        if (ends_transaction) mitm_overflow_transaction_ended = true;
+        if (event != I2C_START || !mitm_overflow_transaction_ended || !mitm_overflow_cleared) return false;
+
+        // the dropped transaction is over and mitm_loop cleaned up after it, so carry on from this start
+        mitm_overflow_transaction_ended = false;
+        mitm_overflow_cleared = false;
+        mitm_transfer_queue_overflow = false;
+    }
+
+    i2c_transfer_t* transfer = spsc_ring_claim(&mitm_transfer_queue);
+    if (transfer == NULL) {
+        // if this was the end of the transaction already, the next start can go through
+        mitm_overflow_transaction_ended = ends_transaction;
+        mitm_transfer_queue_overflow = true;
+        mitm_flow_stats.overflow_count++;
+        return false;
+    }
+
+    transfer->event = event;
+    transfer->data = data;
+    transfer->timestamp = time_us_32();
+
+    spsc_ring_publish(&mitm_transfer_queue);
+
+    size_t queue_size = spsc_ring_size(&mitm_transfer_queue);
+    if (queue_size > mitm_flow_stats.queue_high_water) mitm_flow_stats.queue_high_water = queue_size;
+
+    switch (event) {
+        case I2C_READ:  TRACE(TRACE_LAPTOP_READ, 0, 0); break;
+        case I2C_WRITE: TRACE(TRACE_LAPTOP_WRITE, data, 0); break;
+        case I2C_START: TRACE(TRACE_LAPTOP_START, 0, 0); break;
+        case I2C_STOP:  TRACE(TRACE_LAPTOP_STOP, 0, 0); break;
+        case I2C_ABORT: TRACE(TRACE_LAPTOP_ABORT, 0, 0); break;
+    }
+
+    return true;
+}
+
+size_t mitm_laptop_queue_free() {
+    return MITM_QUEUE_MAX_ELEMENTS - spsc_ring_size(&mitm_transfer_queue);
+}
+
+void mitm_laptop_count_flow_control() {
+    mitm_flow_stats.flow_control_count++;
+}
+
+
+void mitm_init_batt_i2c() {
+    gpio_set_function(BATT_I2C_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(BATT_I2C_SCL_PIN, GPIO_FUNC_I2C);
+    i2c_init(BATT_I2C, BATT_I2C_BAUD);
+    if (BATT_I2C_PULL_UP) {
+        gpio_pull_up(BATT_I2C_SDA_PIN);
+        gpio_pull_up(BATT_I2C_SCL_PIN);
+    }
+}
+
+void init_mitm() {
+    init_spsc_ring(&mitm_transfer_queue, mitm_transfer_queue_data, MITM_QUEUE_MAX_ELEMENTS, MITM_QUEUE_ELEMENT_SIZE);
+    mitm_init_batt_i2c();
+    init_smbus_async();
+    mitm_laptop_init_backend();
+}
+
+
+void mitm_loop() {
+    size_t transfer_count;
+
+    if (mitm_transfer_queue_overflow && !mitm_overflow_cleared) {
+        LOG_ERROR(LOG_MITM_QUEUE_OVERFLOW);
+
+        // the irq doesn't queue anything while recovering, so the queue can be flushed from here
+        mitm_flow_stats.discarded_events += spsc_ring_size(&mitm_transfer_queue);
+        spsc_ring_clear(&mitm_transfer_queue);
+
+        // close whatever was going on with the battery
+        i2c_transfer_t abort = {I2C_ABORT, 0, time_us_32()};
+        mitm_process_transfer(&abort);
+
+        mitm_overflow_cleared = true;
+    }
+
+    do {
+        // grab everything that's pending at once
+        transfer_count = spsc_ring_drain(&mitm_transfer_queue, mitm_transfer_batch, MITM_QUEUE_MAX_ELEMENTS);
+        mitm_laptop_release_flow_control();
+        if (transfer_count == 0) continue;
+
+        status_mitm(true);
+
+        // a stat read might still be running in the background. the laptop can't wait for it (it might be stuck
+        // until BATT_I2C_TIMEOUT), so it's dropped and the stat gets read again later
+        if (smbus_async_busy()) {
+            poll_schedule_count_collision();
+            smbus_async_abort_all();
+        }
+
+        // these all came in before the queue overflowed, so they're finished even if it did meanwhile.
+        // the recovery aborts whatever is left open afterwards
+        for (size_t i = 0; i < transfer_count; i++) {
+            mitm_process_transfer(&mitm_transfer_batch[i]);
+        }
+
+        if (mitm_transfer_queue_overflow) break;
+
+    } while (transfer_count > 0 || !mitm_transaction_finished());
+
+    status_mitm(false);
+
+}
+
+void mitm_get_flow_stats(mitm_flow_stats_t* stats) {
+    *stats = mitm_flow_stats;
+}
+
+bool mitm_laptop_pending() {
+    return spsc_ring_size(&mitm_transfer_queue) > 0;
+}
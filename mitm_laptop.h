@@ -0,0 +1,53 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "mitm.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// glue between the laptop side backends and the event queue in mitm_laptop.c.
+// a backend turns whatever happens on the laptop's bus into events, mitm_loop feeds them to mitm.c.
+// LAPTOP_I2C_PIO in config.h picks the backend:
+//   mitm_laptop_i2c.c -> the rp2040's i2c block
+//   mitm_laptop_pio.c -> pio state machines (smbus slave in mitm_laptop.pio)
+
+
+// queues an event, called from the backend's irq.
+// returns false if the event was dropped because the queue overflowed. a dropped read request
+// still has to be answered (with 0xff) or the laptop will hang on the bus.
+bool mitm_laptop_queue_event(i2c_transfer_event_t event, uint8_t data);
+
+// free slots left in the queue
+size_t mitm_laptop_queue_free();
+
+// counts one time the backend held the laptop back
+void mitm_laptop_count_flow_control();
+
+
+// implemented by the backend
+
+void mitm_laptop_init_backend();
+
+// called by mitm_loop after draining the queue, lets the laptop continue if it was held back
+void mitm_laptop_release_flow_control();
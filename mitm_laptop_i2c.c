@@ -0,0 +1,172 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "mitm.h"
+#include "mitm_laptop.h"
+#include "config.h"
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#if !LAPTOP_I2C_PIO
+
+// laptop side i2c slave for the rp2040's i2c block (the default backend, see mitm_laptop.h)
+
+#define MITM_INTR_MASK_FLOW_CONTROL (I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS)
+#define MITM_DETACH_TIMEOUT 1000      // us for the i2c block to go idle, a byte at 100 kHz is 90 us
+
+// flow control: when the queue is nearly full the irq stops taking bytes and read requests,
+// so the i2c block stretches the clock until mitm_loop catches up
+volatile bool mitm_flow_control_engaged = false;
+
+
+// moves everything in the rx fifo into the queue. a pending start gets queued right
+// before the first byte of its transfer, so bytes from before a repeated start stay in front of it.
+void mitm_laptop_drain_rx(i2c_hw_t* hw, bool* start_pending) {
+    while (i2c_get_read_available(LAPTOP_I2C) > 0) {
+        uint32_t data_cmd = hw->data_cmd;
+
+        if (*start_pending && (data_cmd & I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS)) {
+            mitm_laptop_queue_event(I2C_START, 0);
+            *start_pending = false;
+        }
+
+        mitm_laptop_queue_event(I2C_WRITE, data_cmd & I2C_IC_DATA_CMD_DAT_BITS);
+    }
+}
+
+void mitm_laptop_irq_handler() {
+    i2c_hw_t* hw = i2c_get_hw(LAPTOP_I2C);
+    uint32_t stat = hw->intr_stat;
+    bool start_pending = false;
+    if (stat == 0) return;
+
+    if (stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        hw->clr_tx_abrt;
+        mitm_laptop_drain_rx(hw, &start_pending);
+        mitm_laptop_queue_event(I2C_ABORT, 0);
+    }
+
+    if (stat & I2C_IC_INTR_STAT_R_START_DET_BITS) {
+        hw->clr_start_det;
+        start_pending = true;
+    }
+
+    // rx_full is masked during flow control, but start/stop still need everything before them
+    if (stat & (I2C_IC_INTR_STAT_R_START_DET_BITS | I2C_IC_INTR_STAT_R_STOP_DET_BITS | I2C_IC_INTR_STAT_R_RX_FULL_BITS)) {
+        mitm_laptop_drain_rx(hw, &start_pending);
+    }
+
+    if (start_pending) {
+        mitm_laptop_queue_event(I2C_START, 0);
+    }
+
+    if (stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        hw->clr_stop_det;
+        mitm_laptop_queue_event(I2C_STOP, 0);
+    }
+
+    if (stat & I2C_IC_INTR_STAT_R_RD_REQ_BITS) {
+        hw->clr_rd_req;
+
+        // dropped while recovering from an overflow. the laptop will get a bad pec and retry
+        if (!mitm_laptop_queue_event(I2C_READ, 0)) i2c_write_byte_raw(LAPTOP_I2C, 0xff);
+    }
+
+    // running low on space, hold the laptop back. the reserve covers whatever can't be held back
+    // (start/stop and the bytes already in the rx fifo)
+    if (!mitm_flow_control_engaged && mitm_laptop_queue_free() < MITM_QUEUE_RESERVE) {
+        hw_clear_bits(&hw->intr_mask, MITM_INTR_MASK_FLOW_CONTROL);
+        mitm_flow_control_engaged = true;
+        mitm_laptop_count_flow_control();
+    }
+}
+
+// lets the laptop continue once there's room again. pending rx/read requests fire right away
+void mitm_laptop_release_flow_control() {
+    if (!mitm_flow_control_engaged) return;
+
+    uint32_t irq_status = save_and_disable_interrupts();
+
+    if (mitm_laptop_queue_free() >= MITM_QUEUE_RESERVE * 2) {
+        hw_set_bits(&i2c_get_hw(LAPTOP_I2C)->intr_mask, MITM_INTR_MASK_FLOW_CONTROL);
+        mitm_flow_control_engaged = false;
+    }
+
+    restore_interrupts(irq_status);
+}
+
+void mitm_laptop_reply(uint8_t data) {
+    i2c_write_raw_blocking(LAPTOP_I2C, &data, 1);
+}
+
+bool mitm_laptop_detach() {
+    i2c_hw_t* hw = i2c_get_hw(LAPTOP_I2C);
+    hw->enable = 0;
+
+    uint32_t start = time_us_32();
+    while (hw->enable_status & I2C_IC_ENABLE_STATUS_IC_EN_BITS) {
+        if (time_us_32() - start > MITM_DETACH_TIMEOUT) break;
+        tight_loop_contents();
+    }
+
+    // the laptop got in right before the disable, let it finish
+    if (hw->enable_status & (I2C_IC_ENABLE_STATUS_IC_EN_BITS | I2C_IC_ENABLE_STATUS_SLV_DISABLED_WHILE_BUSY_BITS)) {
+        hw->enable = 1;
+        return false;
+    }
+
+    return true;
+}
+
+void mitm_laptop_attach() {
+    i2c_get_hw(LAPTOP_I2C)->enable = 1;
+}
+
+
+void mitm_laptop_init_backend() {
+    gpio_set_function(LAPTOP_I2C_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(LAPTOP_I2C_SCL_PIN, GPIO_FUNC_I2C);
+    i2c_init(LAPTOP_I2C, LAPTOP_I2C_BAUD);
+    if (LAPTOP_I2C_PULL_UP) {
+        gpio_pull_up(LAPTOP_I2C_SDA_PIN);
+        gpio_pull_up(LAPTOP_I2C_SCL_PIN);
+    }
+
+    i2c_set_slave_mode(LAPTOP_I2C, true, LAPTOP_I2C_ADDR);
+
+    // hold the clock when the rx fifo is full instead of dropping bytes (needed for flow control)
+    i2c_hw_t* hw = i2c_get_hw(LAPTOP_I2C);
+    hw->enable = 0;
+    hw_set_bits(&hw->con, I2C_IC_CON_RX_FIFO_FULL_HLD_CTRL_BITS);
+    hw->enable = 1;
+
+    // manually set up irq
+    uint i2c_irq = I2C0_IRQ + i2c_hw_index(LAPTOP_I2C);
+    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_START_DET_BITS;
+    irq_set_exclusive_handler(i2c_irq, &mitm_laptop_irq_handler);
+    irq_set_enabled(i2c_irq, true);
+}
+
+#endif
@@ -0,0 +1,219 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "mitm.h"
+#include "mitm_laptop.h"
+#include "config.h"
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include "mitm_laptop.pio.h"
+
+#if LAPTOP_I2C_PIO
+
+// the byte engine is re-armed by mitm_pio_start_stop_irq_handler after each start and has to be running before the
+// address bits come in. flash log writes keep core0's irqs off for a whole sector erase (~45 ms), so the laptop
+// would lose transfers. this goes away once start detection and the restart happen inside the pio program
+#if FLASH_LOG
+#error "LAPTOP_I2C_PIO doesn't work with FLASH_LOG, turn one of them off in config.h"
+#endif
+
+// laptop side smbus slave running on the pio (see mitm_laptop.pio and mitm_laptop.h).
+// the byte engine sits alone on pio0 (it needs all 32 instructions), start/stop detection on pio1.
+// received bytes are moved to a ring buffer by dma, so the cpu only gets interrupted
+// for starts, stops and read requests instead of every byte.
+
+#define MITM_PIO_SLAVE pio0
+#define MITM_PIO_START_STOP pio1
+
+#define MITM_PIO_SLAVE_CLOCK 10000000      // 100ns per pio cycle, plenty for smbus speeds
+
+// dma ring for received bytes (one word per byte). must be a power of two, it's drained at every
+// start/stop so it only has to fit the longest write (block writes are up to 34 bytes)
+#define MITM_PIO_RX_RING_SIZE 64
+#define MITM_PIO_RX_RING_BITS 8             // log2 of the ring size in bytes
+
+uint32_t mitm_pio_rx_ring[MITM_PIO_RX_RING_SIZE] __attribute__((aligned(MITM_PIO_RX_RING_SIZE * sizeof(uint32_t))));
+uint mitm_pio_rx_ring_index = 0;            // next word to read
+
+uint mitm_pio_slave_sm;
+uint mitm_pio_slave_offset;
+uint mitm_pio_start_stop_sm;
+uint mitm_pio_rx_dma;
+
+// the pio is holding scl and waiting for a reply byte
+volatile bool mitm_pio_read_pending = false;
+
+
+// queues everything the dma moved into the ring so far
+void __not_in_flash_func(mitm_pio_drain_rx)() {
+    uint write_index = ((uintptr_t) dma_channel_hw_addr(mitm_pio_rx_dma)->write_addr - (uintptr_t) mitm_pio_rx_ring) / sizeof(uint32_t);
+
+    while (mitm_pio_rx_ring_index != write_index) {
+        // the isr also has the address in it when the first byte gets pushed
+        mitm_laptop_queue_event(I2C_WRITE, mitm_pio_rx_ring[mitm_pio_rx_ring_index] & 0xff);
+        mitm_pio_rx_ring_index = (mitm_pio_rx_ring_index + 1) % MITM_PIO_RX_RING_SIZE;
+    }
+}
+
+// puts the byte engine back to the beginning and lets go of the bus.
+// with listen set it waits for the address of the transfer that just started, otherwise it stays stopped.
+void __not_in_flash_func(mitm_pio_restart_slave)(bool listen) {
+    pio_sm_set_enabled(MITM_PIO_SLAVE, mitm_pio_slave_sm, false);
+
+    // the bytes of the previous transfer were pushed long before this start/stop
+    mitm_pio_drain_rx();
+
+    // drop a reply that came too late
+    pio_sm_clear_fifos(MITM_PIO_SLAVE, mitm_pio_slave_sm);
+    pio_sm_restart(MITM_PIO_SLAVE, mitm_pio_slave_sm);
+    mitm_pio_read_pending = false;
+
+    pio_sm_exec(MITM_PIO_SLAVE, mitm_pio_slave_sm, pio_encode_set(pio_pindirs, 0) | pio_encode_sideset_opt(1, 0));
+    if (!listen) return;
+
+    pio_sm_exec(MITM_PIO_SLAVE, mitm_pio_slave_sm, pio_encode_jmp(mitm_pio_slave_offset + smbus_slave_offset_start));
+    pio_sm_set_enabled(MITM_PIO_SLAVE, mitm_pio_slave_sm, true);
+}
+
+void __not_in_flash_func(mitm_pio_start_stop_irq_handler)() {
+    // if both are set the stop came first, a start is always followed by an address
+    if (pio_interrupt_get(MITM_PIO_START_STOP, 1)) {
+        pio_interrupt_clear(MITM_PIO_START_STOP, 1);
+        mitm_pio_restart_slave(false);
+        mitm_laptop_queue_event(I2C_STOP, 0);
+    }
+
+    if (pio_interrupt_get(MITM_PIO_START_STOP, 0)) {
+        pio_interrupt_clear(MITM_PIO_START_STOP, 0);
+        mitm_pio_restart_slave(true);
+        mitm_laptop_queue_event(I2C_START, 0);
+    }
+}
+
+void __not_in_flash_func(mitm_pio_read_irq_handler)() {
+    pio_interrupt_clear(MITM_PIO_SLAVE, 0);
+    mitm_pio_read_pending = true;
+
+    // dropped while recovering from an overflow. the laptop will get a bad pec and retry
+    if (!mitm_laptop_queue_event(I2C_READ, 0)) mitm_laptop_reply(0xff);
+}
+
+// the pio holds scl by itself while it waits for a reply or for room in the rx fifo,
+// so there's nothing to release here
+void mitm_laptop_release_flow_control() {}
+
+// only the flash log detaches, and it can't be built with this backend (see above)
+bool mitm_laptop_detach() { return false; }
+void mitm_laptop_attach() {}
+
+void mitm_laptop_reply(uint8_t data) {
+    uint32_t irq_status = save_and_disable_interrupts();
+
+    // only answer the read that's waiting, a late reply would end up in the next transfer
+    if (mitm_pio_read_pending) {
+        pio_sm_put(MITM_PIO_SLAVE, mitm_pio_slave_sm, (uint32_t) (uint8_t) ~data << 24);
+        mitm_pio_read_pending = false;
+    }
+
+    restore_interrupts(irq_status);
+}
+
+
+void mitm_pio_init_gpio(uint pin) {
+    // open drain: the value stays low, the pio only switches the direction
+    pio_gpio_init(MITM_PIO_SLAVE, pin);
+    pio_sm_set_pins_with_mask(MITM_PIO_SLAVE, mitm_pio_slave_sm, 0, 1u << pin);
+    pio_sm_set_pindirs_with_mask(MITM_PIO_SLAVE, mitm_pio_slave_sm, 0, 1u << pin);
+    if (LAPTOP_I2C_PULL_UP) gpio_pull_up(pin);
+}
+
+void mitm_pio_init_slave() {
+    mitm_pio_slave_sm = pio_claim_unused_sm(MITM_PIO_SLAVE, true);
+    mitm_pio_slave_offset = pio_add_program(MITM_PIO_SLAVE, &smbus_slave_program);
+
+    mitm_pio_init_gpio(LAPTOP_I2C_SDA_PIN);
+    mitm_pio_init_gpio(LAPTOP_I2C_SCL_PIN);
+
+    pio_sm_config config = smbus_slave_program_get_default_config(mitm_pio_slave_offset);
+    sm_config_set_in_pins(&config, LAPTOP_I2C_SDA_PIN);         // scl is in pin 1, so it has to be sda + 1
+    sm_config_set_out_pins(&config, LAPTOP_I2C_SDA_PIN, 1);
+    sm_config_set_set_pins(&config, LAPTOP_I2C_SDA_PIN, 1);
+    sm_config_set_sideset_pins(&config, LAPTOP_I2C_SCL_PIN);
+    sm_config_set_jmp_pin(&config, LAPTOP_I2C_SDA_PIN);
+    sm_config_set_in_shift(&config, false, false, 32);
+    sm_config_set_out_shift(&config, false, false, 9);
+    sm_config_set_clkdiv(&config, (float) clock_get_hz(clk_sys) / MITM_PIO_SLAVE_CLOCK);
+    pio_sm_init(MITM_PIO_SLAVE, mitm_pio_slave_sm, mitm_pio_slave_offset + smbus_slave_offset_start, &config);
+
+    // load our address into y
+    pio_sm_put(MITM_PIO_SLAVE, mitm_pio_slave_sm, LAPTOP_I2C_ADDR << 1);
+    pio_sm_exec(MITM_PIO_SLAVE, mitm_pio_slave_sm, pio_encode_pull(false, false));
+    pio_sm_exec(MITM_PIO_SLAVE, mitm_pio_slave_sm, pio_encode_mov(pio_y, pio_osr));
+
+    // rx fifo -> ring. the transfer count is big enough to never run out
+    mitm_pio_rx_dma = dma_claim_unused_channel(true);
+    dma_channel_config dma_config = dma_channel_get_default_config(mitm_pio_rx_dma);
+    channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&dma_config, false);
+    channel_config_set_write_increment(&dma_config, true);
+    channel_config_set_ring(&dma_config, true, MITM_PIO_RX_RING_BITS);
+    channel_config_set_dreq(&dma_config, pio_get_dreq(MITM_PIO_SLAVE, mitm_pio_slave_sm, false));
+    dma_channel_configure(mitm_pio_rx_dma, &dma_config, mitm_pio_rx_ring, &MITM_PIO_SLAVE->rxf[mitm_pio_slave_sm], 0xffffffff, true);
+
+    // read requests
+    pio_set_irq0_source_enabled(MITM_PIO_SLAVE, pis_interrupt0, true);
+    irq_set_exclusive_handler(PIO0_IRQ_0, &mitm_pio_read_irq_handler);
+    irq_set_enabled(PIO0_IRQ_0, true);
+
+    // stays stopped until the first start
+}
+
+void mitm_pio_init_start_stop() {
+    mitm_pio_start_stop_sm = pio_claim_unused_sm(MITM_PIO_START_STOP, true);
+    uint offset = pio_add_program(MITM_PIO_START_STOP, &smbus_start_stop_program);
+
+    pio_sm_config config = smbus_start_stop_program_get_default_config(offset);
+    sm_config_set_in_pins(&config, LAPTOP_I2C_SDA_PIN);
+    sm_config_set_jmp_pin(&config, LAPTOP_I2C_SCL_PIN);
+
+    // the bus is idle (sda high) at this point, starting at sda_low would see a stop right away
+    pio_sm_init(MITM_PIO_START_STOP, mitm_pio_start_stop_sm, offset + smbus_start_stop_offset_sda_high, &config);
+
+    pio_set_irq0_source_enabled(MITM_PIO_START_STOP, pis_interrupt0, true);
+    pio_set_irq0_source_enabled(MITM_PIO_START_STOP, pis_interrupt1, true);
+    irq_set_exclusive_handler(PIO1_IRQ_0, &mitm_pio_start_stop_irq_handler);
+    irq_set_enabled(PIO1_IRQ_0, true);
+
+    pio_sm_set_enabled(MITM_PIO_START_STOP, mitm_pio_start_stop_sm, true);
+}
+
+void mitm_laptop_init_backend() {
+    mitm_pio_init_slave();
+    mitm_pio_init_start_stop();
+}
+
+#endif
@@ -0,0 +1,182 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "poll_schedule.h"
+#include "config.h"
+#include "pico/stdlib.h"
+
+// only used from core0 (mitm and stat poller), so nothing here needs a lock
+
+struct poll_schedule_cadence {
+    uint8_t cmd;
+    uint32_t last_start;
+    uint32_t period;        // moving average of the time between starts, 0 if unknown
+};
+
+typedef struct poll_schedule_cadence poll_schedule_cadence_t;
+
+
+poll_schedule_cadence_t poll_schedule_cadence[POLL_SCHEDULE_MAX_COMMANDS];
+uint8_t poll_schedule_cadence_count = 0;
+
+bool poll_schedule_laptop_seen = false;
+uint32_t poll_schedule_last_laptop_start = 0;
+
+// when the poller started waiting for a gap, 0 if it isn't waiting
+uint32_t poll_schedule_deferred_since = 0;
+
+poll_schedule_stats_t poll_schedule_stats;
+
+
+poll_schedule_cadence_t* poll_schedule_find(uint8_t cmd) {
+    for (int i = 0; i < poll_schedule_cadence_count; i++) {
+        if (poll_schedule_cadence[i].cmd == cmd) return &poll_schedule_cadence[i];
+    }
+    return NULL;
+}
+
+// new entry for cmd, replaces the one that wasn't seen for the longest time if the table is full
+poll_schedule_cadence_t* poll_schedule_add(uint8_t cmd, uint32_t timestamp) {
+    poll_schedule_cadence_t* cadence;
+
+    if (poll_schedule_cadence_count < POLL_SCHEDULE_MAX_COMMANDS) {
+        cadence = &poll_schedule_cadence[poll_schedule_cadence_count++];
+    } else {
+        cadence = &poll_schedule_cadence[0];
+        for (int i = 1; i < POLL_SCHEDULE_MAX_COMMANDS; i++) {
+            if (timestamp - poll_schedule_cadence[i].last_start > timestamp - cadence->last_start) cadence = &poll_schedule_cadence[i];
+        }
+    }
+
+    cadence->cmd = cmd;
+    cadence->last_start = timestamp;
+    cadence->period = 0;
+    return cadence;
+}
+
+void poll_schedule_note_laptop(uint8_t cmd, uint32_t timestamp) {
+    poll_schedule_laptop_seen = true;
+    poll_schedule_last_laptop_start = timestamp;
+
+    poll_schedule_cadence_t* cadence = poll_schedule_find(cmd);
+    if (cadence == NULL) {
+        poll_schedule_add(cmd, timestamp);
+        return;
+    }
+
+    uint32_t interval = timestamp - cadence->last_start;
+
+    // the same command again within a burst is a retry, not the next poll
+    if (interval < POLL_SCHEDULE_BURST_GAP) return;
+
+    cadence->last_start = timestamp;
+
+    if (interval > POLL_SCHEDULE_MAX_PERIOD) {
+        // the laptop paused (sleep, battery removed), start over
+        cadence->period = 0;
+    } else if (cadence->period == 0) {
+        cadence->period = interval;
+    } else {
+        cadence->period = (cadence->period * 3 + interval) / 4;
+    }
+}
+
+
+// true if nothing from the laptop is expected within duration_us
+bool poll_schedule_is_gap(uint32_t now, uint32_t duration_us) {
+    if (!poll_schedule_laptop_seen) return true;
+    if (now - poll_schedule_last_laptop_start < POLL_SCHEDULE_BURST_GAP) return false;
+
+    for (int i = 0; i < poll_schedule_cadence_count; i++) {
+        poll_schedule_cadence_t* cadence = &poll_schedule_cadence[i];
+        if (cadence->period == 0) continue;
+
+        int32_t until_next = (int32_t) (cadence->last_start + cadence->period - now);
+
+        // more than half a period late, the laptop stopped reading this one
+        if (until_next < -(int32_t) (cadence->period / 2)) continue;
+
+        if (until_next < (int32_t) (duration_us + cadence->period / 16 + POLL_SCHEDULE_GUARD)) return false;
+    }
+
+    return true;
+}
+
+bool poll_schedule_can_start(uint32_t duration_us) {
+    uint32_t now = time_us_32();
+
+    if (!BATT_POLL_SCHEDULE || poll_schedule_is_gap(now, duration_us)) {
+        poll_schedule_deferred_since = 0;
+        poll_schedule_stats.started++;
+        return true;
+    }
+
+    if (poll_schedule_deferred_since == 0) {
+        poll_schedule_deferred_since = now | 1;     // 0 means not waiting
+        poll_schedule_stats.deferred++;
+        return false;
+    }
+
+    // the laptop is too busy to ever leave a gap this big, better to make it wait once than never update
+    if (now - poll_schedule_deferred_since > POLL_SCHEDULE_MAX_DEFER) {
+        poll_schedule_deferred_since = 0;
+        poll_schedule_stats.forced++;
+        poll_schedule_stats.started++;
+        return true;
+    }
+
+    return false;
+}
+
+bool poll_schedule_fits(uint32_t duration_us) {
+    if (BATT_POLL_SCHEDULE && !poll_schedule_is_gap(time_us_32(), duration_us)) return false;
+
+    poll_schedule_stats.started++;
+    return true;
+}
+
+bool poll_schedule_is_quiet(uint32_t duration_us) {
+    return !BATT_POLL_SCHEDULE || poll_schedule_is_gap(time_us_32(), duration_us);
+}
+
+uint32_t poll_schedule_estimate_read_us(uint8_t length, bool is_block) {
+    // address + command + address again + data (+ block length) + pec, 9 clocks per byte, plus start/restart/stop
+    uint32_t bits = (3 + length + (is_block ? 1 : 0) + 1) * 9 + 3;
+    return bits * 1000000 / BATT_I2C_BAUD + POLL_SCHEDULE_READ_OVERHEAD;
+}
+
+void poll_schedule_count_collision() {
+    poll_schedule_stats.collisions++;
+}
+
+
+uint32_t poll_schedule_get_period(uint8_t cmd) {
+    poll_schedule_cadence_t* cadence = poll_schedule_find(cmd);
+    if (cadence == NULL) return 0;
+    return cadence->period;
+}
+
+void poll_schedule_get_stats(poll_schedule_stats_t* stats) {
+    *stats = poll_schedule_stats;
+    stats->tracked_commands = poll_schedule_cadence_count;
+}
@@ -0,0 +1,81 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+// decides when the stat poller may use the battery bus.
+// the laptop usually reads the same commands over and over at a fixed interval, so the time between
+// transactions is learned per command. a background read only starts if it's done before the laptop
+// is expected to show up again, otherwise the laptop would have to wait for it.
+
+#define POLL_SCHEDULE_MAX_COMMANDS 32       // distinct laptop commands to track, more than a laptop usually reads
+#define POLL_SCHEDULE_MAX_PERIOD 60000000   // longer gaps than this aren't treated as a cadence (60 sec)
+#define POLL_SCHEDULE_BURST_GAP 20000       // the laptop reads in bursts, stay off the bus this long after its last start
+#define POLL_SCHEDULE_GUARD 2000            // extra room before a predicted start, on top of 1/16 of the period
+#define POLL_SCHEDULE_MAX_DEFER 2000000     // don't hold back a read longer than this, even if there's no gap (2 sec)
+#define POLL_SCHEDULE_READ_OVERHEAD 500     // per read on top of the bits on the wire (irq latency, bus turnaround)
+
+
+#ifndef POLL_SCHEDULE_STATS_DEF
+#define POLL_SCHEDULE_STATS_DEF
+
+struct poll_schedule_stats {
+    unsigned long started;          // background reads allowed to start
+    unsigned long deferred;         // times a read was held back for the laptop
+    unsigned long forced;           // reads started without a gap after waiting POLL_SCHEDULE_MAX_DEFER
+    unsigned long collisions;       // laptop transactions that had to wait for a background read
+    uint8_t tracked_commands;
+};
+
+typedef struct poll_schedule_stats poll_schedule_stats_t;
+
+#endif
+
+
+// called by the mitm once the command of a laptop transaction is known. timestamp is when it started
+void poll_schedule_note_laptop(uint8_t cmd, uint32_t timestamp);
+
+// true if a background read that takes duration_us fits before the laptop's next predicted transaction.
+// counts the read as started if it does
+bool poll_schedule_can_start(uint32_t duration_us);
+
+// like poll_schedule_can_start, but never lets a read through without a gap.
+// for reads that can just be skipped when the laptop is busy
+bool poll_schedule_fits(uint32_t duration_us);
+
+// true if nothing from the laptop is expected within duration_us. doesn't count anything, for things
+// other than reads that need the laptop to stay away (flash_log.c counts its own writes)
+bool poll_schedule_is_quiet(uint32_t duration_us);
+
+// time a read of length data bytes takes on the wire
+uint32_t poll_schedule_estimate_read_us(uint8_t length, bool is_block);
+
+// a laptop transaction started while a background read was on the bus
+void poll_schedule_count_collision();
+
+// learned period of a command in microseconds, 0 if it doesn't have one (yet)
+uint32_t poll_schedule_get_period(uint8_t cmd);
+
+void poll_schedule_get_stats(poll_schedule_stats_t* stats);
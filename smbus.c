@@ -23,7 +23,7 @@
  */
 #include "smbus.h"
 #include "config.h"
-#include <stdio.h>
+#include "log.h"
 
 
 struct i2c_dev;
@@ -42,19 +42,39 @@ i2c_dev_t* get_laptop_dev() {
 }
 
 
-// CRC-8
+// CRC-8 (polynomial x^8 + x^2 + x + 1), one lookup per byte.
+// not const so it sits in ram, the mitm goes through it for every byte on the bus
+uint8_t smbus_crc_table[256] = {
+    0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15, 0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+    0x70, 0x77, 0x7e, 0x79, 0x6c, 0x6b, 0x62, 0x65, 0x48, 0x4f, 0x46, 0x41, 0x54, 0x53, 0x5a, 0x5d,
+    0xe0, 0xe7, 0xee, 0xe9, 0xfc, 0xfb, 0xf2, 0xf5, 0xd8, 0xdf, 0xd6, 0xd1, 0xc4, 0xc3, 0xca, 0xcd,
+    0x90, 0x97, 0x9e, 0x99, 0x8c, 0x8b, 0x82, 0x85, 0xa8, 0xaf, 0xa6, 0xa1, 0xb4, 0xb3, 0xba, 0xbd,
+    0xc7, 0xc0, 0xc9, 0xce, 0xdb, 0xdc, 0xd5, 0xd2, 0xff, 0xf8, 0xf1, 0xf6, 0xe3, 0xe4, 0xed, 0xea,
+    0xb7, 0xb0, 0xb9, 0xbe, 0xab, 0xac, 0xa5, 0xa2, 0x8f, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9d, 0x9a,
+    0x27, 0x20, 0x29, 0x2e, 0x3b, 0x3c, 0x35, 0x32, 0x1f, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0d, 0x0a,
+    0x57, 0x50, 0x59, 0x5e, 0x4b, 0x4c, 0x45, 0x42, 0x6f, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7d, 0x7a,
+    0x89, 0x8e, 0x87, 0x80, 0x95, 0x92, 0x9b, 0x9c, 0xb1, 0xb6, 0xbf, 0xb8, 0xad, 0xaa, 0xa3, 0xa4,
+    0xf9, 0xfe, 0xf7, 0xf0, 0xe5, 0xe2, 0xeb, 0xec, 0xc1, 0xc6, 0xcf, 0xc8, 0xdd, 0xda, 0xd3, 0xd4,
+    0x69, 0x6e, 0x67, 0x60, 0x75, 0x72, 0x7b, 0x7c, 0x51, 0x56, 0x5f, 0x58, 0x4d, 0x4a, 0x43, 0x44,
+    0x19, 0x1e, 0x17, 0x10, 0x05, 0x02, 0x0b, 0x0c, 0x21, 0x26, 0x2f, 0x28, 0x3d, 0x3a, 0x33, 0x34,
+    0x4e, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5c, 0x5b, 0x76, 0x71, 0x78, 0x7f, 0x6a, 0x6d, 0x64, 0x63,
+    0x3e, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2c, 0x2b, 0x06, 0x01, 0x08, 0x0f, 0x1a, 0x1d, 0x14, 0x13,
+    0xae, 0xa9, 0xa0, 0xa7, 0xb2, 0xb5, 0xbc, 0xbb, 0x96, 0x91, 0x98, 0x9f, 0x8a, 0x8d, 0x84, 0x83,
+    0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb, 0xe6, 0xe1, 0xe8, 0xef, 0xfa, 0xfd, 0xf4, 0xf3,
+};
+
+uint8_t smbus_pec_update(uint8_t pec, uint8_t data) {
+    return smbus_crc_table[pec ^ data];
+}
+
 void generate_crc(uint8_t* crc, uint8_t current_byte) {
-    for (int i = 0; i < 8; i++) {
-        bool apply = (current_byte >> (7 - i) & 1) ^ (*crc >> 7 & 1);
-        *crc <<= 1;
-        if (apply) *crc ^= 0x07;
-    }
+    *crc = smbus_pec_update(*crc, current_byte);
 }
 
 int generate_smbus_crc(uint8_t address, uint8_t cmd, uint8_t* reply, uint8_t length, bool is_block, bool is_read) {
     uint8_t crc = 0;
 
-    generate_crc(&crc, (address << 1) + !is_read);  // address + write bit
+    generate_crc(&crc, address << 1);               // address + write bit
     generate_crc(&crc, cmd);                        // command
 
     // reading causes direction flip, so the address occurs again
@@ -76,7 +96,7 @@ bool validate_smbus_crc(uint8_t address, uint8_t cmd, uint8_t* reply, uint8_t le
     int crc_gen = generate_smbus_crc(address, cmd, reply, length, is_block, is_read);
     if (recieved_crc == crc_gen) return true;
 
-    printf("CRC invalid! recieved 0x%02x != calculated 0x%02x\n", recieved_crc, crc_gen);
+    LOG_ERROR(LOG_SMBUS_CRC_INVALID, recieved_crc, crc_gen);
     return false;
 }
 
@@ -92,28 +112,28 @@ int i2c_stop_read_blocking(i2c_dev_t* device) {
  * if return value is non-negative it always equals the length.
  */
 int smbus_read(i2c_dev_t* device, uint8_t cmd, uint8_t* result, size_t length) {
-    printf("reading %d bytes from command 0x%02x\n", length, cmd);
+    LOG_INFO(LOG_SMBUS_READ, length, cmd);
     int ret;
     uint8_t crc;
 
     // write command code
     ret = i2c_write_timeout_us(device->i2c, device->address, &cmd, 1, true, device->timeout);
     if (ret < 0) {
-        printf("failed, write returned %d\n", ret);
+        LOG_ERROR(LOG_SMBUS_WRITE_FAILED, ret);
         return SMBUS_ERROR_DEVICE;
     }
 
     // read result
     ret = i2c_read_burst_blocking(device->i2c, device->address, result, length);
     if (ret < 0) {
-        printf("failed, read returned %d\n", ret);
+        LOG_ERROR(LOG_SMBUS_READ_FAILED, ret);
         return SMBUS_ERROR_DEVICE;
     }
 
     // read crc
     ret = i2c_read_timeout_us(device->i2c, device->address, &crc, 1, false, device->timeout);
     if (ret < 0) {
-        printf("failed, crc read returned %d\n", ret);
+        LOG_ERROR(LOG_SMBUS_CRC_READ_FAILED, ret);
         return SMBUS_ERROR_DEVICE;
     }
     
@@ -128,27 +148,27 @@ int smbus_read(i2c_dev_t* device, uint8_t cmd, uint8_t* result, size_t length) {
  * returns a negative value on error, or the block length.
  */
 int smbus_read_block(i2c_dev_t* device, uint8_t cmd, uint8_t* result, size_t max_length) {
-    printf("reading block from command 0x%02x (max %d bytes)\n", cmd, max_length);
+    LOG_INFO(LOG_SMBUS_READ_BLOCK, cmd, max_length);
     int ret;
     uint8_t block_length, crc;
 
     // write command code
     ret = i2c_write_timeout_us(device->i2c, device->address, &cmd, 1, true, device->timeout);
     if (ret < 0) {
-        printf("failed, write returned %d\n", ret);
+        LOG_ERROR(LOG_SMBUS_WRITE_FAILED, ret);
         return SMBUS_ERROR_DEVICE;
     }
 
     // read block length
     ret = i2c_read_burst_blocking(device->i2c, device->address, &block_length, 1);
     if (ret < 0) {
-        printf("failed, block size read returned %d\n", ret);
+        LOG_ERROR(LOG_SMBUS_BLOCK_SIZE_READ_FAILED, ret);
         return SMBUS_ERROR_DEVICE;
     }
 
     if (block_length > max_length) {
         // don't truncate, crc can't be verified
-        printf("block is longer than max_length! block_length = %d, max_length = %d\n", block_length, max_length);
+        LOG_ERROR(LOG_SMBUS_BLOCK_TOO_LONG, block_length, max_length);
         i2c_stop_read_blocking(device);
         return SMBUS_ERROR_GENERIC;
     }
@@ -156,14 +176,14 @@ int smbus_read_block(i2c_dev_t* device, uint8_t cmd, uint8_t* result, size_t max
     // read block
     ret = i2c_read_burst_blocking(device->i2c, device->address, result, block_length);
     if (ret < 0) {
-        printf("failed, block read returned %d\n", ret);
+        LOG_ERROR(LOG_SMBUS_BLOCK_READ_FAILED, ret);
         return SMBUS_ERROR_DEVICE;
     }
 
     // read crc
     ret = i2c_read_timeout_us(device->i2c, device->address, &crc, 1, false, device->timeout);
     if (ret < 0) {
-        printf("failed, crc read returned %d\n", ret);
+        LOG_ERROR(LOG_SMBUS_CRC_READ_FAILED, ret);
         return SMBUS_ERROR_DEVICE;
     }
 
@@ -190,7 +210,7 @@ int smbus_read_uint16(i2c_dev_t* device, uint8_t cmd, uint16_t* result) {
 int smbus_read_text(i2c_dev_t* device, uint8_t cmd, char* result, size_t max_length) {
     int ret;
     
-    ret = smbus_read_block(device, cmd, result, max_length);
+    ret = smbus_read_block(device, cmd, (uint8_t*) result, max_length);
     if (ret < 0) return ret;
 
     // sometimes text is null-terminated and the block length goes longer than the actual text
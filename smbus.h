@@ -28,6 +28,8 @@
 #define SMBUS_ERROR_DEVICE -1
 #define SMBUS_ERROR_GENERIC -2
 #define SMBUS_ERROR_CRC -3
+#define SMBUS_ERROR_TIMEOUT -4
+#define SMBUS_ERROR_ABORTED -5      // background transfer given up on so the laptop can have the bus
 
 
 #ifndef I2C_DEV_DEF
@@ -47,6 +49,10 @@ i2c_dev_t* get_bms_dev();
 i2c_dev_t* get_laptop_dev();
 
 int i2c_stop_read_blocking(i2c_dev_t* device);
+// incremental pec: start with 0 and feed it every byte of the transaction in bus order, address bytes included.
+// a transaction that ends in a correct pec byte comes out as 0.
+uint8_t smbus_pec_update(uint8_t pec, uint8_t data);
+
 int generate_smbus_crc(uint8_t address, uint8_t cmd, uint8_t* reply, uint8_t length, bool is_block, bool is_read);
 bool validate_smbus_crc(uint8_t address, uint8_t cmd, uint8_t* reply, uint8_t length, uint8_t recieved_crc, bool is_block, bool is_read);
 
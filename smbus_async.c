@@ -0,0 +1,417 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "smbus_async.h"
+#include "smbus.h"
+#include "config.h"
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+// words for the i2c block's data_cmd register: command + block length + data + pec
+#define SMBUS_ASYNC_MAX_WORDS (SMBUS_ASYNC_MAX_LENGTH + 3)
+
+#define SMBUS_ASYNC_READ I2C_IC_DATA_CMD_CMD_BITS
+
+#define SMBUS_ASYNC_INTR_MASK (I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS)
+
+#define SMBUS_ASYNC_RECOVER_TIMEOUT 1000   // us to wait for the i2c block at each recovery step
+#define SMBUS_ASYNC_RX_DMA_TIMEOUT 20      // us for the dma to move the last byte after the stop
+
+
+// what's on the bus right now
+enum smbus_async_stage {
+    SMBUS_ASYNC_STAGE_DATA,             // the whole transfer is queued up, done at the stop
+    SMBUS_ASYNC_STAGE_BLOCK_LENGTH,     // block read, waiting for the length before queuing the rest
+    SMBUS_ASYNC_STAGE_BLOCK_DISCARD     // block read that's too long, ending it
+};
+
+typedef enum smbus_async_stage smbus_async_stage_t;
+
+smbus_transfer_t* smbus_async_current = NULL;
+smbus_transfer_t* smbus_async_queue_head = NULL;
+smbus_transfer_t* smbus_async_queue_tail = NULL;
+
+smbus_async_stage_t smbus_async_stage;
+int smbus_async_error;                  // set when the i2c block aborted the current transfer
+
+uint32_t smbus_async_words[SMBUS_ASYNC_MAX_WORDS];
+uint8_t smbus_async_rx_buffer[SMBUS_ASYNC_MAX_LENGTH + 2];  // block length + data + pec
+
+uint smbus_async_tx_dma;
+uint smbus_async_rx_dma;
+
+
+void smbus_transfer_read(smbus_transfer_t* transfer, i2c_dev_t* device, uint8_t cmd, uint8_t* result, uint8_t length) {
+    *transfer = (smbus_transfer_t) {
+        device: device,
+        cmd: cmd,
+        is_read: true,
+        is_block: false,
+        data: result,
+        length: length,
+        state: SMBUS_TRANSFER_IDLE
+    };
+}
+
+void smbus_transfer_read_block(smbus_transfer_t* transfer, i2c_dev_t* device, uint8_t cmd, uint8_t* result, uint8_t max_length) {
+    smbus_transfer_read(transfer, device, cmd, result, max_length);
+    transfer->is_block = true;
+}
+
+void smbus_transfer_write(smbus_transfer_t* transfer, i2c_dev_t* device, uint8_t cmd, uint8_t* data, uint8_t length, bool is_block) {
+    *transfer = (smbus_transfer_t) {
+        device: device,
+        cmd: cmd,
+        is_read: false,
+        is_block: is_block,
+        data: data,
+        length: length,
+        state: SMBUS_TRANSFER_IDLE
+    };
+}
+
+
+// hands the words to the i2c block and catches rx_length bytes in the rx buffer at rx_offset
+void smbus_async_run(size_t word_count, uint8_t rx_offset, size_t rx_length) {
+    if (rx_length > 0) dma_channel_transfer_to_buffer_now(smbus_async_rx_dma, &smbus_async_rx_buffer[rx_offset], rx_length);
+    dma_channel_transfer_from_buffer_now(smbus_async_tx_dma, smbus_async_words, word_count);
+}
+
+// queues count reads, the last one with a stop if requested
+size_t smbus_async_add_reads(size_t index, size_t count, bool restart, bool stop) {
+    for (size_t i = 0; i < count; i++) {
+        smbus_async_words[index] = SMBUS_ASYNC_READ;
+        if (restart && i == 0) smbus_async_words[index] |= I2C_IC_DATA_CMD_RESTART_BITS;
+        if (stop && i == count - 1) smbus_async_words[index] |= I2C_IC_DATA_CMD_STOP_BITS;
+        index++;
+    }
+    return index;
+}
+
+void smbus_async_start(smbus_transfer_t* transfer) {
+    i2c_hw_t* hw = i2c_get_hw(BATT_I2C);
+    size_t index = 0;
+
+    smbus_async_current = transfer;
+    smbus_async_error = 0;
+    transfer->state = SMBUS_TRANSFER_BUSY;
+    transfer->start_time = time_us_32();
+
+    hw->enable = 0;
+    hw->tar = transfer->device->address;
+    hw->enable = 1;
+
+    hw->clr_intr;
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->intr_mask = SMBUS_ASYNC_INTR_MASK;
+
+    smbus_async_words[index++] = transfer->cmd;
+
+    if (transfer->is_read && transfer->is_block) {
+        // the length decides how many bytes follow, the rest gets queued once it's in
+        smbus_async_stage = SMBUS_ASYNC_STAGE_BLOCK_LENGTH;
+        index = smbus_async_add_reads(index, 1, true, false);
+        smbus_async_run(index, 0, 1);
+
+    } else if (transfer->is_read) {
+        smbus_async_stage = SMBUS_ASYNC_STAGE_DATA;
+        index = smbus_async_add_reads(index, transfer->length + 1, true, true);
+        smbus_async_run(index, 0, transfer->length + 1);
+
+    } else {
+        smbus_async_stage = SMBUS_ASYNC_STAGE_DATA;
+        if (transfer->is_block) smbus_async_words[index++] = transfer->length;
+        for (size_t i = 0; i < transfer->length; i++) {
+            smbus_async_words[index++] = transfer->data[i];
+        }
+        smbus_async_words[index++] = generate_smbus_crc(transfer->device->address, transfer->cmd, transfer->data, transfer->length, transfer->is_block, false) | I2C_IC_DATA_CMD_STOP_BITS;
+        smbus_async_run(index, 0, 0);
+    }
+}
+
+// checks the pec and hands the result over
+int smbus_async_read_result(smbus_transfer_t* transfer) {
+    uint8_t* data = smbus_async_rx_buffer;
+    uint8_t length = transfer->length;
+
+    if (transfer->is_block) {
+        length = smbus_async_rx_buffer[0];
+        data++;
+    }
+
+    if (data[length] != generate_smbus_crc(transfer->device->address, transfer->cmd, data, length, transfer->is_block, true))
+        return SMBUS_ERROR_CRC;
+
+    for (size_t i = 0; i < length; i++) {
+        transfer->data[i] = data[i];
+    }
+
+    return length;
+}
+
+// waits for the bits in reg to clear, gives up after SMBUS_ASYNC_RECOVER_TIMEOUT
+bool smbus_async_wait_clear(volatile uint32_t* reg, uint32_t bits) {
+    uint32_t start = time_us_32();
+    while (*reg & bits) {
+        if (time_us_32() - start > SMBUS_ASYNC_RECOVER_TIMEOUT) return false;
+        tight_loop_contents();
+    }
+    return true;
+}
+
+// gets the i2c block back to idle after a transfer was given up on, otherwise the next one starts
+// in the middle of the old one (or behind its leftover bytes in the fifos).
+// the abort sends a stop and flushes the tx fifo. disabling the block afterwards drops whatever is still in the rx fifo,
+// and also gets it out of a transfer the abort couldn't end (ie. the battery holding the clock)
+void smbus_async_recover() {
+    i2c_hw_t* hw = i2c_get_hw(BATT_I2C);
+
+    hw_set_bits(&hw->enable, I2C_IC_ENABLE_ABORT_BITS);
+    smbus_async_wait_clear(&hw->enable, I2C_IC_ENABLE_ABORT_BITS);
+    hw->clr_tx_abrt;
+
+    hw->enable = 0;
+    smbus_async_wait_clear(&hw->enable_status, I2C_IC_ENABLE_STATUS_IC_EN_BITS);
+    hw->clr_intr;
+    hw->enable = 1;
+}
+
+void smbus_async_finish(int result) {
+    i2c_hw_t* hw = i2c_get_hw(BATT_I2C);
+    smbus_transfer_t* transfer = smbus_async_current;
+
+    dma_channel_abort(smbus_async_tx_dma);
+    dma_channel_abort(smbus_async_rx_dma);
+    hw->intr_mask = 0;
+    hw->dma_cr = 0;
+
+    // timed out, given up on, or the block aborted the transfer itself (the dma was stopped mid way)
+    if (result == SMBUS_ERROR_TIMEOUT || result == SMBUS_ERROR_ABORTED || smbus_async_error < 0) smbus_async_recover();
+
+    smbus_async_current = NULL;
+    transfer->result = result;
+    transfer->state = SMBUS_TRANSFER_DONE;
+    if (transfer->callback != NULL) transfer->callback(transfer);
+
+    // next one
+    if (smbus_async_queue_head != NULL) {
+        transfer = smbus_async_queue_head;
+        smbus_async_queue_head = transfer->next;
+        if (smbus_async_queue_head == NULL) smbus_async_queue_tail = NULL;
+        smbus_async_start(transfer);
+    }
+}
+
+
+// the last byte was received before the stop, the dma just has to move it. that takes a few cycles,
+// the bound is only there so a stuck channel can't hang the irq
+bool smbus_async_wait_rx_dma() {
+    uint32_t start = time_us_32();
+    while (dma_channel_is_busy(smbus_async_rx_dma)) {
+        if (time_us_32() - start > SMBUS_ASYNC_RX_DMA_TIMEOUT) return false;
+        tight_loop_contents();
+    }
+    return true;
+}
+
+void smbus_async_i2c_irq_handler() {
+    i2c_hw_t* hw = i2c_get_hw(BATT_I2C);
+    uint32_t stat = hw->intr_stat;
+    if (smbus_async_current == NULL) return;
+
+    // nack or lost arbitration. the i2c block sends a stop by itself, the transfer ends there
+    if (stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        hw->clr_tx_abrt;
+        dma_channel_abort(smbus_async_tx_dma);
+        dma_channel_abort(smbus_async_rx_dma);
+        smbus_async_error = SMBUS_ERROR_DEVICE;
+    }
+
+    if (stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        hw->clr_stop_det;
+
+        if (smbus_async_error < 0) {
+            smbus_async_finish(smbus_async_error);
+            return;
+        }
+
+        switch (smbus_async_stage) {
+            case SMBUS_ASYNC_STAGE_DATA:
+                if (!smbus_async_wait_rx_dma()) {
+                    smbus_async_finish(SMBUS_ERROR_GENERIC);
+                    break;
+                }
+                smbus_async_finish(smbus_async_current->is_read ? smbus_async_read_result(smbus_async_current) : smbus_async_current->length);
+                break;
+            case SMBUS_ASYNC_STAGE_BLOCK_DISCARD:
+                smbus_async_finish(SMBUS_ERROR_GENERIC);
+                break;
+            default:
+                // a stop in the middle of a block read, the battery let go of the bus
+                smbus_async_finish(SMBUS_ERROR_DEVICE);
+        }
+    }
+}
+
+// block length is in
+void smbus_async_dma_irq_handler() {
+    if (!dma_channel_get_irq1_status(smbus_async_rx_dma)) return;
+    dma_channel_acknowledge_irq1(smbus_async_rx_dma);
+
+    if (smbus_async_current == NULL || smbus_async_stage != SMBUS_ASYNC_STAGE_BLOCK_LENGTH) return;
+    uint8_t block_length = smbus_async_rx_buffer[0];
+
+    // the master holds the clock while nothing is queued, so the rest of the block can follow right away
+    if (block_length > smbus_async_current->length) {
+        // don't truncate, crc can't be verified. just end the transfer
+        smbus_async_stage = SMBUS_ASYNC_STAGE_BLOCK_DISCARD;
+        smbus_async_add_reads(0, 1, false, true);
+        smbus_async_run(1, 1, 1);
+        return;
+    }
+
+    smbus_async_stage = SMBUS_ASYNC_STAGE_DATA;
+    size_t word_count = smbus_async_add_reads(0, block_length + 1, false, true);
+    smbus_async_run(word_count, 1, block_length + 1);
+}
+
+
+int smbus_async_submit(smbus_transfer_t* transfer) {
+    if (transfer->state == SMBUS_TRANSFER_QUEUED || transfer->state == SMBUS_TRANSFER_BUSY) return SMBUS_ERROR_GENERIC;
+    if (transfer->length > SMBUS_ASYNC_MAX_LENGTH) return SMBUS_ERROR_GENERIC;
+
+    transfer->next = NULL;
+    transfer->result = 0;
+
+    uint32_t irq_status = save_and_disable_interrupts();
+
+    if (smbus_async_current == NULL) {
+        smbus_async_start(transfer);
+    } else {
+        transfer->state = SMBUS_TRANSFER_QUEUED;
+        if (smbus_async_queue_tail != NULL) smbus_async_queue_tail->next = transfer;
+        else smbus_async_queue_head = transfer;
+        smbus_async_queue_tail = transfer;
+    }
+
+    restore_interrupts(irq_status);
+    return 0;
+}
+
+// gives up on a transfer that's been on the bus for too long (battery holding the clock, lost stop, ...)
+void smbus_async_check_timeout() {
+    uint32_t irq_status = save_and_disable_interrupts();
+
+    smbus_transfer_t* transfer = smbus_async_current;
+    if (transfer != NULL && time_us_32() - transfer->start_time > transfer->device->timeout) {
+        smbus_async_finish(SMBUS_ERROR_TIMEOUT);
+    }
+
+    restore_interrupts(irq_status);
+}
+
+void smbus_async_abort_all() {
+    uint32_t irq_status = save_and_disable_interrupts();
+
+    // take the queue first, finishing the current transfer would start the next one
+    smbus_transfer_t* transfer = smbus_async_queue_head;
+    smbus_async_queue_head = NULL;
+    smbus_async_queue_tail = NULL;
+
+    if (smbus_async_current != NULL) smbus_async_finish(SMBUS_ERROR_ABORTED);
+
+    while (transfer != NULL) {
+        smbus_transfer_t* next = transfer->next;
+        transfer->result = SMBUS_ERROR_ABORTED;
+        transfer->state = SMBUS_TRANSFER_DONE;
+        if (transfer->callback != NULL) transfer->callback(transfer);
+        transfer = next;
+    }
+
+    restore_interrupts(irq_status);
+}
+
+bool smbus_async_poll(smbus_transfer_t* transfer) {
+    if (transfer->state == SMBUS_TRANSFER_BUSY) smbus_async_check_timeout();
+    return transfer->state == SMBUS_TRANSFER_DONE;
+}
+
+int smbus_async_wait(smbus_transfer_t* transfer) {
+    while (!smbus_async_poll(transfer)) {
+        smbus_async_check_timeout();
+        tight_loop_contents();
+    }
+    return transfer->result;
+}
+
+void smbus_async_wait_idle() {
+    while (smbus_async_busy()) {
+        smbus_async_check_timeout();
+        tight_loop_contents();
+    }
+}
+
+bool smbus_async_busy() {
+    return smbus_async_current != NULL;
+}
+
+
+void init_smbus_async() {
+    i2c_hw_t* hw = i2c_get_hw(BATT_I2C);
+
+    // tx requests only while the tx fifo is empty (level <= dma_tdlr), so the dma stays about a word ahead of the bus.
+    // rx requests as soon as there's a byte in the rx fifo (level > dma_rdlr)
+    hw->dma_tdlr = 0;
+    hw->dma_rdlr = 0;
+
+    // words -> data_cmd
+    smbus_async_tx_dma = dma_claim_unused_channel(true);
+    dma_channel_config tx_config = dma_channel_get_default_config(smbus_async_tx_dma);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_dreq(&tx_config, i2c_get_dreq(BATT_I2C, true));
+    dma_channel_configure(smbus_async_tx_dma, &tx_config, &hw->data_cmd, smbus_async_words, 0, false);
+
+    // data_cmd -> rx buffer
+    smbus_async_rx_dma = dma_claim_unused_channel(true);
+    dma_channel_config rx_config = dma_channel_get_default_config(smbus_async_rx_dma);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_write_increment(&rx_config, true);
+    channel_config_set_dreq(&rx_config, i2c_get_dreq(BATT_I2C, false));
+    dma_channel_configure(smbus_async_rx_dma, &rx_config, smbus_async_rx_buffer, &hw->data_cmd, 0, false);
+
+    dma_channel_set_irq1_enabled(smbus_async_rx_dma, true);
+    irq_add_shared_handler(DMA_IRQ_1, &smbus_async_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    // only unmasked while a transfer is running, the blocking functions poll these themselves
+    hw->intr_mask = 0;
+    uint i2c_irq = I2C0_IRQ + i2c_hw_index(BATT_I2C);
+    irq_set_exclusive_handler(i2c_irq, &smbus_async_i2c_irq_handler);
+    irq_set_enabled(i2c_irq, true);
+}
@@ -0,0 +1,102 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "smbus.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// asynchronous smbus transfers for the battery side.
+// a whole smbus transaction (command, data, pec) is described by one smbus_transfer_t. the i2c block
+// is fed by dma and irqs move it along, so the cpu is free while the bytes are on the bus.
+// transfers queue up and run one after another.
+//
+// the blocking functions in smbus.c and mitm.c use the same i2c block. call smbus_async_wait_idle()
+// before using them, they'd mess up a transfer that's on the bus.
+
+#define SMBUS_ASYNC_MAX_LENGTH 64       // max data bytes per transfer (not counting block length and pec)
+
+
+#ifndef SMBUS_TRANSFER_DEF
+#define SMBUS_TRANSFER_DEF
+
+enum smbus_transfer_state {
+    SMBUS_TRANSFER_IDLE,
+    SMBUS_TRANSFER_QUEUED,
+    SMBUS_TRANSFER_BUSY,
+    SMBUS_TRANSFER_DONE
+};
+
+typedef enum smbus_transfer_state smbus_transfer_state_t;
+
+typedef struct smbus_transfer smbus_transfer_t;
+
+// called when a transfer is done, usually from an interrupt. keep it short
+typedef void (*smbus_transfer_callback)(smbus_transfer_t* transfer);
+
+struct smbus_transfer {
+    // set up by the caller (see smbus_transfer_read/read_block/write)
+    i2c_dev_t* device;
+    uint8_t cmd;
+    bool is_read;
+    bool is_block;
+    uint8_t* data;                      // read: result buffer, write: bytes to send
+    uint8_t length;                     // read: result length (max length for blocks), write: bytes to send
+    smbus_transfer_callback callback;   // optional
+    void* user_data;
+
+    // filled in by smbus_async
+    volatile smbus_transfer_state_t state;
+    int result;                         // like smbus_read/smbus_read_block: the length or a negative error
+    uint32_t start_time;                // time_us_32() when it went on the bus
+    smbus_transfer_t* next;
+};
+
+#endif
+
+
+// set up a transfer. the buffer has to stay around until the transfer is done
+void smbus_transfer_read(smbus_transfer_t* transfer, i2c_dev_t* device, uint8_t cmd, uint8_t* result, uint8_t length);
+void smbus_transfer_read_block(smbus_transfer_t* transfer, i2c_dev_t* device, uint8_t cmd, uint8_t* result, uint8_t max_length);
+void smbus_transfer_write(smbus_transfer_t* transfer, i2c_dev_t* device, uint8_t cmd, uint8_t* data, uint8_t length, bool is_block);
+
+// queues a transfer. returns SMBUS_ERROR_GENERIC if it's already queued or too long.
+// only call from core0, never in an interrupt
+int smbus_async_submit(smbus_transfer_t* transfer);
+
+// true once the transfer is done (result is set). also times out a transfer that's stuck on the bus
+bool smbus_async_poll(smbus_transfer_t* transfer);
+
+// blocks until the transfer is done and returns its result
+int smbus_async_wait(smbus_transfer_t* transfer);
+
+// blocks until nothing is queued or on the bus anymore
+void smbus_async_wait_idle();
+
+// ends the transfer on the bus right away (stop + i2c block reset) and drops the queued ones,
+// they all finish with SMBUS_ERROR_ABORTED. for when the laptop needs the bus and can't wait.
+// only call from core0, never in an interrupt
+void smbus_async_abort_all();
+bool smbus_async_busy();
+
+void init_smbus_async();
@@ -0,0 +1,110 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "spsc_ring.h"
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+// lock-free single-producer single-consumer ring buffer
+// the producer publishes with release ordering and the consumer picks it up with acquire ordering (and vice versa for freed slots),
+// so an element is never visible to the consumer before it has been completely written.
+
+bool init_spsc_ring(spsc_ring_t* inst, void* data, size_t capacity, size_t element_size) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        printf("FATAL: spsc ring capacity %zu is not a power of two\n", capacity);
+        return false;
+    }
+
+    inst->capacity = capacity;
+    inst->element_size = element_size;
+    inst->dropped = 0;
+    atomic_init(&inst->_head, 0);
+    atomic_init(&inst->_tail, 0);
+    inst->_data = data;
+    return true;
+}
+
+void* spsc_ring_get_element_ptr(spsc_ring_t* inst, size_t index) {
+    return (uint8_t*) inst->_data + (index & (inst->capacity - 1)) * inst->element_size;
+}
+
+// returns a pointer to place data for the next element, without making it visible to the consumer yet.
+// call spsc_ring_publish once the element is fully written.
+// if the ring is full this returns a NULL pointer and increments `dropped`.
+// producer only.
+void* spsc_ring_claim(spsc_ring_t* inst) {
+    size_t head = atomic_load_explicit(&inst->_head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&inst->_tail, memory_order_acquire);   // slot has to be fully drained before reuse
+
+    if (head - tail >= inst->capacity) {
+        inst->dropped++;
+        return NULL;
+    }
+
+    return spsc_ring_get_element_ptr(inst, head);
+}
+
+// makes the most recently claimed element available to the consumer.
+// producer only.
+void spsc_ring_publish(spsc_ring_t* inst) {
+    size_t head = atomic_load_explicit(&inst->_head, memory_order_relaxed);
+    atomic_store_explicit(&inst->_head, head + 1, memory_order_release);
+}
+
+// copies up to max_elements pending elements into `out` (in order) and frees their slots.
+// returns the number of elements copied.
+// consumer only.
+size_t spsc_ring_drain(spsc_ring_t* inst, void* out, size_t max_elements) {
+    size_t tail = atomic_load_explicit(&inst->_tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&inst->_head, memory_order_acquire);
+
+    size_t count = head - tail;
+    if (count > max_elements) count = max_elements;
+    if (count == 0) return 0;
+
+    // the pending elements may wrap around the end of the storage
+    size_t start = tail & (inst->capacity - 1);
+    size_t first_run = inst->capacity - start;
+    if (first_run > count) first_run = count;
+
+    memcpy(out, spsc_ring_get_element_ptr(inst, tail), first_run * inst->element_size);
+    memcpy((uint8_t*) out + first_run * inst->element_size, inst->_data, (count - first_run) * inst->element_size);
+
+    atomic_store_explicit(&inst->_tail, tail + count, memory_order_release);
+    return count;
+}
+
+// throws away everything that is currently pending.
+// consumer only.
+void spsc_ring_clear(spsc_ring_t* inst) {
+    size_t head = atomic_load_explicit(&inst->_head, memory_order_acquire);
+    atomic_store_explicit(&inst->_tail, head, memory_order_release);
+}
+
+// returns the number of pending elements
+size_t spsc_ring_size(spsc_ring_t* inst) {
+    size_t tail = atomic_load_explicit(&inst->_tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&inst->_head, memory_order_acquire);
+    return head - tail;
+}
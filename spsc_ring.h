@@ -0,0 +1,56 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// lock-free single-producer single-consumer ring buffer.
+// one side (ie. an interrupt) only ever claims/publishes, the other only ever drains.
+// the storage is provided by the caller so it can be statically allocated.
+
+struct spsc_ring {
+    size_t capacity;        // always a power of two
+    size_t element_size;
+
+    long dropped;
+
+    // free-running indices, masked on access. head is only written by the producer, tail only by the consumer
+    atomic_size_t _head;
+    atomic_size_t _tail;
+    void* _data;
+};
+
+typedef struct spsc_ring spsc_ring_t;
+
+bool init_spsc_ring(spsc_ring_t* inst, void* data, size_t capacity, size_t element_size);
+
+// producer side
+void* spsc_ring_claim(spsc_ring_t* inst);
+void spsc_ring_publish(spsc_ring_t* inst);
+
+// consumer side
+size_t spsc_ring_drain(spsc_ring_t* inst, void* out, size_t max_elements);
+void spsc_ring_clear(spsc_ring_t* inst);
+
+size_t spsc_ring_size(spsc_ring_t* inst);
@@ -0,0 +1,139 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "smbus.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+    checks the table driven smbus pec (smbus.c) against a plain bit-by-bit crc-8 on random buffers,
+    and times both.
+
+    usage: crccheck [buffers]     (default 1000000)
+
+    exits with 1 if the table and the bit loop ever disagree.
+*/
+
+#define CRCCHECK_DEFAULT_BUFFERS 1000000
+#define CRCCHECK_MAX_LENGTH 34      // block length + 32 bytes + pec, the longest thing on the bus
+#define CRCCHECK_POOL_SIZE 4096     // buffers generated up front so the timing doesn't include rand()
+
+
+extern uint8_t smbus_crc_table[256];
+
+struct crccheck_buffer {
+    uint8_t length;
+    uint8_t data[CRCCHECK_MAX_LENGTH];
+};
+
+
+// crc-8, polynomial x^8 + x^2 + x + 1, msb first. what the table has to match
+uint8_t crccheck_bit_update(uint8_t crc, uint8_t data) {
+    crc ^= data;
+    for (int i = 0; i < 8; i++) {
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+uint8_t crccheck_bit_crc(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) crc = crccheck_bit_update(crc, data[i]);
+    return crc;
+}
+
+uint8_t crccheck_table_crc(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) crc = smbus_pec_update(crc, data[i]);
+    return crc;
+}
+
+uint64_t crccheck_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+    long buffers = CRCCHECK_DEFAULT_BUFFERS;
+    if (argc > 1) buffers = strtol(argv[1], NULL, 0);
+
+    long errors = 0;
+    srand(1);
+
+    for (int i = 0; i < 256; i++) {
+        if (smbus_crc_table[i] != crccheck_bit_update(0, i)) {
+            printf("table entry 0x%02x is 0x%02x, should be 0x%02x\n", i, smbus_crc_table[i], crccheck_bit_update(0, i));
+            errors++;
+        }
+    }
+
+    static struct crccheck_buffer pool[CRCCHECK_POOL_SIZE];
+    for (long n = 0; n < buffers; n++) {
+        struct crccheck_buffer* buffer = &pool[n % CRCCHECK_POOL_SIZE];
+        buffer->length = rand() % (CRCCHECK_MAX_LENGTH + 1);
+        for (int i = 0; i < buffer->length; i++) buffer->data[i] = rand();
+
+        uint8_t expected = crccheck_bit_crc(buffer->data, buffer->length);
+        uint8_t got = crccheck_table_crc(buffer->data, buffer->length);
+
+        // the same thing through generate_smbus_crc, as a read block reply with the address and command in front
+        uint8_t header[4] = {0x0b << 1, buffer->data[0], (0x0b << 1) | 1, buffer->length};
+        uint8_t reply_crc = crccheck_bit_update(crccheck_bit_update(crccheck_bit_update(crccheck_bit_update(0, header[0]), header[1]), header[2]), header[3]);
+        for (int i = 0; i < buffer->length; i++) reply_crc = crccheck_bit_update(reply_crc, buffer->data[i]);
+        int generated = generate_smbus_crc(0x0b, header[1], buffer->data, buffer->length, true, true);
+
+        if (got != expected || generated != reply_crc) {
+            if (errors < 10) printf("buffer %ld (%d bytes): table 0x%02x, generate_smbus_crc 0x%02x, bit loop 0x%02x / 0x%02x\n",
+                                    n, buffer->length, got, generated, expected, reply_crc);
+            errors++;
+        }
+    }
+
+    // timing, same buffers for both
+    long timed = buffers < CRCCHECK_POOL_SIZE ? buffers : CRCCHECK_POOL_SIZE;
+    long rounds = buffers / timed;
+    volatile uint8_t sink = 0;
+    uint64_t bytes = 0;
+    for (long i = 0; i < timed; i++) bytes += pool[i].length;
+    bytes *= rounds;
+
+    uint64_t start = crccheck_now_ns();
+    for (long r = 0; r < rounds; r++) {
+        for (long i = 0; i < timed; i++) sink ^= crccheck_bit_crc(pool[i].data, pool[i].length);
+    }
+    double bit_ns = (double) (crccheck_now_ns() - start) / bytes;
+
+    start = crccheck_now_ns();
+    for (long r = 0; r < rounds; r++) {
+        for (long i = 0; i < timed; i++) sink ^= crccheck_table_crc(pool[i].data, pool[i].length);
+    }
+    double table_ns = (double) (crccheck_now_ns() - start) / bytes;
+    (void) sink;
+
+    printf("%ld buffers checked, %ld mismatches\n", buffers, errors);
+    printf("bit loop %.2f ns/byte, table %.2f ns/byte (%llu bytes)\n", bit_ns, table_ns, (unsigned long long) bytes);
+    return errors > 0 ? 1 : 0;
+}
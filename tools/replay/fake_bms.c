@@ -0,0 +1,198 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "fake_bms.h"
+#include "mitm.h"
+#include "battery.h"
+#include "config.h"
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include <string.h>
+#include <time.h>
+
+i2c_inst_t i2c0_inst = {0};
+i2c_inst_t i2c1_inst = {1};
+
+
+struct fake_bms_reply {
+    bool scripted;
+    bool error;
+    uint8_t length;
+    uint8_t data[FAKE_BMS_REPLY_MAX];
+};
+
+struct fake_bms_reply fake_bms_replies[256];
+
+// current transfer with the battery
+bool fake_bms_addressed = false;    // set after the first byte (the command) is written
+bool fake_bms_reading = false;
+uint8_t fake_bms_cmd = 0;
+size_t fake_bms_read_index = 0;
+
+fake_bms_stats_t fake_bms_stats;
+
+uint8_t fake_laptop_rx[FAKE_LAPTOP_RX_MAX];
+size_t fake_laptop_rx_length = 0;
+
+
+void fake_bms_set_reply(uint8_t cmd, const uint8_t* reply, size_t length) {
+    if (length > FAKE_BMS_REPLY_MAX) length = FAKE_BMS_REPLY_MAX;
+
+    fake_bms_replies[cmd].scripted = true;
+    fake_bms_replies[cmd].error = false;
+    fake_bms_replies[cmd].length = length;
+    memcpy(fake_bms_replies[cmd].data, reply, length);
+}
+
+void fake_bms_set_error(uint8_t cmd) {
+    fake_bms_replies[cmd].scripted = true;
+    fake_bms_replies[cmd].error = true;
+}
+
+bool fake_bms_has_reply(uint8_t cmd) {
+    return fake_bms_replies[cmd].scripted;
+}
+
+
+size_t fake_laptop_received(const uint8_t** buffer) {
+    *buffer = fake_laptop_rx;
+    return fake_laptop_rx_length;
+}
+
+void fake_laptop_clear() {
+    fake_laptop_rx_length = 0;
+}
+
+
+void fake_bms_get_stats(fake_bms_stats_t* stats) {
+    *stats = fake_bms_stats;
+}
+
+void fake_bms_clear_stats() {
+    memset(&fake_bms_stats, 0, sizeof(fake_bms_stats));
+}
+
+
+void fake_bms_end_transfer() {
+    fake_bms_addressed = false;
+    fake_bms_reading = false;
+    fake_bms_read_index = 0;
+}
+
+int fake_bms_write(uint8_t addr, const uint8_t* src, size_t len, bool nostop) {
+    fake_bms_stats.transfers++;
+
+    // a write after a read is a new transfer
+    if (fake_bms_reading) fake_bms_end_transfer();
+
+    if (addr != BATT_I2C_ADDR || (fake_bms_addressed && fake_bms_replies[fake_bms_cmd].error)) {
+        fake_bms_stats.errors++;
+        fake_bms_end_transfer();
+        return PICO_ERROR_GENERIC;
+    }
+
+    if (!fake_bms_addressed && len > 0) {
+        fake_bms_cmd = src[0];
+        fake_bms_addressed = true;
+    }
+
+    fake_bms_stats.bytes_written += len;
+    if (!nostop) fake_bms_end_transfer();
+    return len;
+}
+
+int fake_bms_read(uint8_t addr, uint8_t* dst, size_t len, bool nostop) {
+    struct fake_bms_reply* reply = &fake_bms_replies[fake_bms_cmd];
+    fake_bms_stats.transfers++;
+
+    // reads need a command first, and a battery that knows it
+    if (addr != BATT_I2C_ADDR || !fake_bms_addressed || !reply->scripted || reply->error) {
+        fake_bms_stats.errors++;
+        fake_bms_end_transfer();
+        return PICO_ERROR_GENERIC;
+    }
+
+    fake_bms_reading = true;
+    for (size_t i = 0; i < len; i++) {
+        // past the end of the reply the bus just floats high
+        uint8_t data = fake_bms_read_index < reply->length ? reply->data[fake_bms_read_index] : 0xff;
+        if (dst != NULL) dst[i] = data;
+        fake_bms_read_index++;
+    }
+
+    fake_bms_stats.bytes_read += len;
+    if (!nostop) fake_bms_end_transfer();
+    return len;
+}
+
+
+int i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop, uint timeout_us) {
+    if (i2c != BATT_I2C) return PICO_ERROR_GENERIC;
+    return fake_bms_write(addr, src, len, nostop);
+}
+
+int i2c_read_timeout_us(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop, uint timeout_us) {
+    if (i2c != BATT_I2C) return PICO_ERROR_GENERIC;
+    return fake_bms_read(addr, dst, len, nostop);
+}
+
+int i2c_write_blocking(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop) {
+    return i2c_write_timeout_us(i2c, addr, src, len, nostop, 0);
+}
+
+int i2c_read_blocking(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop) {
+    return i2c_read_timeout_us(i2c, addr, dst, len, nostop, 0);
+}
+
+int i2c_write_burst_blocking(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len) {
+    return i2c_write_timeout_us(i2c, addr, src, len, true, 0);
+}
+
+int i2c_read_burst_blocking(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len) {
+    return i2c_read_timeout_us(i2c, addr, dst, len, true, 0);
+}
+
+// laptop side: bytes the mitm sends back to the laptop (stands in for the laptop backend)
+void mitm_laptop_reply(uint8_t data) {
+    if (fake_laptop_rx_length < FAKE_LAPTOP_RX_MAX) fake_laptop_rx[fake_laptop_rx_length++] = data;
+}
+
+
+// there's no stat cache on the host
+void battery_stat_snoop_reply(uint8_t cmd, uint8_t* reply, uint8_t length) {}
+
+
+uint64_t time_us_64() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+uint32_t time_us_32() {
+    return time_us_64();
+}
+
+void sleep_ms(uint32_t ms) {
+    struct timespec duration = {ms / 1000, (ms % 1000) * 1000000};
+    nanosleep(&duration, NULL);
+}
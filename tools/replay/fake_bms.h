@@ -0,0 +1,61 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// scripted stand-in for the battery (on BATT_I2C) and the laptop (mitm_laptop_reply).
+// the battery answers read commands with whatever reply was scripted for them,
+// and everything the mitm sends back to the laptop gets collected.
+
+#define FAKE_BMS_REPLY_MAX 64
+#define FAKE_LAPTOP_RX_MAX 256
+
+
+// scripts the reply for a read command (including the pec byte if there is one)
+void fake_bms_set_reply(uint8_t cmd, const uint8_t* reply, size_t length);
+
+// makes the battery fail every transfer involving cmd
+void fake_bms_set_error(uint8_t cmd);
+
+bool fake_bms_has_reply(uint8_t cmd);
+
+
+// bytes the laptop has received since the last fake_laptop_clear()
+size_t fake_laptop_received(const uint8_t** buffer);
+void fake_laptop_clear();
+
+
+// battery transfers (pico sdk calls) and bytes moved since the last fake_bms_clear_stats()
+struct fake_bms_stats {
+    unsigned long transfers;
+    unsigned long bytes_written;
+    unsigned long bytes_read;
+    unsigned long errors;
+};
+
+typedef struct fake_bms_stats fake_bms_stats_t;
+
+void fake_bms_get_stats(fake_bms_stats_t* stats);
+void fake_bms_clear_stats();
@@ -0,0 +1,485 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "mitm.h"
+#include "smbus.h"
+#include "config.h"
+#include "log.h"
+#include "trace.h"
+#include "latency.h"
+#include "fake_bms.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    replays laptop-side smbus traffic through the mitm state machine (mitm.c) on the host,
+    with a scripted fake battery on the other side. prints one line per transaction with
+    what the laptop got back, whether it matched, and how long it took.
+
+    usage: replay [-v] [-t] [script...]     (reads stdin if no script is given)
+      -v    print the mitm log output and the bus trace of the replay, and the latency histograms at the end
+      -t    only look at "$T" trace lines and ignore everything else (for raw serial captures)
+
+    script lines:
+      # comment
+      bms <cmd> <bytes...>      reply of the fake battery for a read command. the pec gets appended.
+                                for block reads include the length byte.
+      bms-raw <cmd> <bytes...>  same, but sent as-is (no pec appended)
+      bms-error <cmd>           the battery fails any transfer for this command
+      expect <bytes...>         bytes the laptop should receive in the next transaction
+      start                     raw laptop events, fed to the mitm as-is
+      write <byte>
+      read [count]
+      stop
+      abort
+      word <cmd>                a full read word transaction (reads 2 bytes + pec)
+      block <cmd> <length>      a full read block transaction (reads length byte + length bytes + pec)
+      ...$T<hex>...             a bus trace line (see trace.h). each traced laptop transaction is replayed,
+                                the battery answers with what the real one sent (unless there's a bms line
+                                for the command), and the laptop has to get the same reply as in the trace.
+
+    all numbers are hex. exits with 1 if any transaction didn't match.
+*/
+
+#define REPLAY_LINE_MAX 4096
+#define REPLAY_TRACE_TRANSACTION_MAX 512    // records
+
+
+struct replay_transaction {
+    bool open;
+    unsigned long number;
+    int cmd;                    // first byte written, -1 if none
+    bool is_read;
+    uint64_t host_time;         // us spent in mitm_process_transfer
+    uint64_t bus_time;          // us the transaction took in the trace, 0 if not from a trace
+
+    bool has_expectation;
+    uint8_t expected[FAKE_LAPTOP_RX_MAX];
+    size_t expected_length;
+};
+
+struct replay_transaction replay_transaction;
+unsigned long replay_transaction_count = 0;
+
+// set by "expect", used up by the next transaction
+bool replay_pending_expectation = false;
+uint8_t replay_pending_expected[FAKE_LAPTOP_RX_MAX];
+size_t replay_pending_expected_length = 0;
+
+// commands with a reply from the script, which wins over replies learned from a trace
+bool replay_scripted[256];
+
+// records of the traced transaction that's being collected
+trace_record_t replay_trace_records[REPLAY_TRACE_TRANSACTION_MAX];
+uint64_t replay_trace_times[REPLAY_TRACE_TRANSACTION_MAX];
+size_t replay_trace_record_count = 0;
+bool replay_trace_in_transaction = false;
+uint32_t replay_trace_time_high = 0;
+int replay_trace_next_sequence = -1;
+
+bool replay_verbose = false;
+bool replay_trace_only = false;
+
+// totals
+unsigned long replay_passed = 0;
+unsigned long replay_failed = 0;
+unsigned long replay_unchecked = 0;
+unsigned long replay_events = 0;
+unsigned long replay_lost_records = 0;
+uint64_t replay_host_time = 0;
+unsigned long replay_bms_transfers = 0;
+
+
+void replay_flush_output() {
+    if (!replay_verbose) return;
+
+    // drain everything the mitm logged and traced
+    for (int i = 0; i < LOG_BUFFER_RECORDS / LOG_FLUSH_MAX_RECORDS; i++) log_flush();
+    for (int i = 0; i < TRACE_BUFFER_RECORDS / TRACE_FLUSH_MAX_RECORDS; i++) trace_flush();
+}
+
+void replay_print_bytes(const char* label, const uint8_t* buffer, size_t length) {
+    printf("    %-9s", label);
+    for (size_t i = 0; i < length; i++) printf(" %02x", buffer[i]);
+    printf("\n");
+}
+
+void replay_begin_transaction() {
+    memset(&replay_transaction, 0, sizeof(replay_transaction));
+    replay_transaction.open = true;
+    replay_transaction.number = ++replay_transaction_count;
+    replay_transaction.cmd = -1;
+
+    if (replay_pending_expectation) {
+        replay_transaction.has_expectation = true;
+        memcpy(replay_transaction.expected, replay_pending_expected, replay_pending_expected_length);
+        replay_transaction.expected_length = replay_pending_expected_length;
+        replay_pending_expectation = false;
+    }
+
+    fake_laptop_clear();
+    fake_bms_clear_stats();
+}
+
+void replay_end_transaction(bool aborted) {
+    struct replay_transaction* transaction = &replay_transaction;
+    const uint8_t* received;
+    size_t received_length = fake_laptop_received(&received);
+    fake_bms_stats_t stats;
+    const char* result;
+
+    fake_bms_get_stats(&stats);
+    transaction->open = false;
+
+    if (!transaction->has_expectation) {
+        result = "-";
+        replay_unchecked++;
+    } else if (received_length == transaction->expected_length && memcmp(received, transaction->expected, received_length) == 0) {
+        result = "ok";
+        replay_passed++;
+    } else {
+        result = "FAIL";
+        replay_failed++;
+    }
+
+    replay_host_time += transaction->host_time;
+    replay_bms_transfers += stats.transfers;
+
+    printf("#%-5lu ", transaction->number);
+    if (transaction->cmd >= 0) printf("cmd 0x%02x ", transaction->cmd);
+    else printf("cmd  -   ");
+    printf("%-5s %3zu bytes  %-4s  bms %lu xfers %lu errors  host %llu us",
+        aborted ? "abort" : transaction->is_read ? "read" : "write", received_length, result,
+        stats.transfers, stats.errors, (unsigned long long) transaction->host_time);
+    if (transaction->bus_time > 0) printf("  bus %llu us", (unsigned long long) transaction->bus_time);
+    printf("\n");
+
+    if (strcmp(result, "FAIL") == 0) {
+        replay_print_bytes("got", received, received_length);
+        replay_print_bytes("expected", transaction->expected, transaction->expected_length);
+    }
+
+    replay_flush_output();
+}
+
+void replay_event(i2c_transfer_event_t event, uint8_t data) {
+    i2c_transfer_t transfer = {event, data, time_us_32()};
+    bool ends = event == I2C_STOP || event == I2C_ABORT;
+    uint64_t start;
+
+    if (!replay_transaction.open && !ends) replay_begin_transaction();
+
+    if (replay_transaction.open) {
+        if (event == I2C_WRITE && replay_transaction.cmd < 0) replay_transaction.cmd = data;
+        if (event == I2C_READ) replay_transaction.is_read = true;
+    }
+
+    // mitm_laptop.c normally traces these
+    switch (event) {
+        case I2C_READ:  TRACE(TRACE_LAPTOP_READ, 0, 0); break;
+        case I2C_WRITE: TRACE(TRACE_LAPTOP_WRITE, data, 0); break;
+        case I2C_START: TRACE(TRACE_LAPTOP_START, 0, 0); break;
+        case I2C_STOP:  TRACE(TRACE_LAPTOP_STOP, 0, 0); break;
+        case I2C_ABORT: TRACE(TRACE_LAPTOP_ABORT, 0, 0); break;
+    }
+
+    start = time_us_64();
+    mitm_process_transfer(&transfer);
+    if (replay_transaction.open) replay_transaction.host_time += time_us_64() - start;
+    replay_events++;
+
+    if (ends && replay_transaction.open) replay_end_transaction(event == I2C_ABORT);
+}
+
+
+// appends the pec a real battery would send after this reply
+size_t replay_append_pec(uint8_t cmd, uint8_t* reply, size_t length) {
+    reply[length] = generate_smbus_crc(BATT_I2C_ADDR, cmd, reply, length, false, true);
+    return length + 1;
+}
+
+
+// replays one traced laptop transaction, with the battery scripted from what it sent in the trace
+void replay_trace_transaction() {
+    uint8_t bms_reply[FAKE_BMS_REPLY_MAX];
+    size_t bms_reply_length = 0;
+    bool bms_error = false;
+    int cmd = -1;
+    uint8_t laptop_reply[FAKE_LAPTOP_RX_MAX];
+    size_t laptop_reply_length = 0;
+
+    for (size_t i = 0; i < replay_trace_record_count; i++) {
+        trace_record_t* record = &replay_trace_records[i];
+
+        switch (record->type) {
+            case TRACE_LAPTOP_WRITE:
+                if (cmd < 0) cmd = record->data;
+                break;
+            case TRACE_LAPTOP_REPLY:
+                if (laptop_reply_length < FAKE_LAPTOP_RX_MAX) laptop_reply[laptop_reply_length++] = record->data;
+                break;
+            case TRACE_BMS_READ:
+                if (record->status < 0) bms_error = true;
+                else if (bms_reply_length < FAKE_BMS_REPLY_MAX) bms_reply[bms_reply_length++] = record->data;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // script the battery with what it sent back then. if the reply never came from the
+    // battery (override), the laptop's copy is the best guess there is.
+    if (cmd >= 0 && !replay_scripted[cmd]) {
+        if (bms_error) fake_bms_set_error(cmd);
+        else if (bms_reply_length > 0) fake_bms_set_reply(cmd, bms_reply, bms_reply_length);
+        else if (laptop_reply_length > 0) fake_bms_set_reply(cmd, laptop_reply, laptop_reply_length);
+    }
+
+    replay_pending_expectation = true;
+    memcpy(replay_pending_expected, laptop_reply, laptop_reply_length);
+    replay_pending_expected_length = laptop_reply_length;
+
+    for (size_t i = 0; i < replay_trace_record_count; i++) {
+        trace_record_t* record = &replay_trace_records[i];
+
+        switch (record->type) {
+            case TRACE_LAPTOP_START: replay_event(I2C_START, 0); break;
+            case TRACE_LAPTOP_WRITE: replay_event(I2C_WRITE, record->data); break;
+            case TRACE_LAPTOP_READ: replay_event(I2C_READ, 0); break;
+            case TRACE_LAPTOP_STOP:
+            case TRACE_LAPTOP_ABORT:
+                // note the traced duration before the transaction gets reported
+                replay_transaction.bus_time = replay_trace_times[i] - replay_trace_times[0];
+                replay_event(record->type == TRACE_LAPTOP_STOP ? I2C_STOP : I2C_ABORT, 0);
+                break;
+            default:
+                break;
+        }
+    }
+
+    replay_trace_record_count = 0;
+    replay_pending_expectation = false;
+}
+
+void replay_trace_record(trace_record_t* record) {
+    // sequence gaps mean the firmware dropped records, so the transaction can't be trusted
+    if (replay_trace_next_sequence >= 0 && record->sequence != replay_trace_next_sequence) {
+        unsigned long lost = (uint8_t) (record->sequence - replay_trace_next_sequence);
+        replay_lost_records += lost;
+        printf("WARNING: %lu trace records lost, skipping transaction\n", lost);
+        replay_trace_record_count = 0;
+        replay_trace_in_transaction = false;
+    }
+    replay_trace_next_sequence = (uint8_t) (record->sequence + 1);
+
+    if (record->type == TRACE_TIME_HIGH) {
+        replay_trace_time_high = record->timestamp;
+        return;
+    }
+
+    // only laptop transactions are collected, anything in between (like battery polling by the gui) is skipped
+    if (record->type == TRACE_LAPTOP_START) replay_trace_in_transaction = true;
+    if (!replay_trace_in_transaction) return;
+
+    if (replay_trace_record_count >= REPLAY_TRACE_TRANSACTION_MAX) {
+        printf("WARNING: traced transaction too long, skipping it\n");
+        replay_trace_record_count = 0;
+        replay_trace_in_transaction = false;
+        return;
+    }
+    replay_trace_records[replay_trace_record_count] = *record;
+    replay_trace_times[replay_trace_record_count++] = (uint64_t) replay_trace_time_high << 32 | record->timestamp;
+
+    if (record->type == TRACE_LAPTOP_STOP || record->type == TRACE_LAPTOP_ABORT) {
+        replay_trace_in_transaction = false;
+        replay_trace_transaction();
+    }
+}
+
+int replay_hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void replay_trace_line(const char* hex) {
+    trace_record_t record;
+    uint8_t* bytes = (uint8_t*) &record;
+    size_t index = 0;
+
+    // records are hex-encoded in memory order, which matches the host (little endian)
+    while (replay_hex_digit(hex[0]) >= 0 && replay_hex_digit(hex[1]) >= 0) {
+        bytes[index++] = replay_hex_digit(hex[0]) << 4 | replay_hex_digit(hex[1]);
+        hex += 2;
+
+        if (index == sizeof(record)) {
+            replay_trace_record(&record);
+            index = 0;
+        }
+    }
+}
+
+
+// parses hex bytes into buffer, returns how many or -1 if something isn't a byte
+int replay_parse_bytes(char* tokens[], int count, uint8_t* buffer, size_t max_length) {
+    for (int i = 0; i < count; i++) {
+        char* end;
+        unsigned long value = strtoul(tokens[i], &end, 16);
+        if (*end != 0 || value > 0xff || i >= (int) max_length) return -1;
+        buffer[i] = value;
+    }
+    return count;
+}
+
+bool replay_script_line(char* tokens[], int count) {
+    uint8_t bytes[FAKE_LAPTOP_RX_MAX];
+    const char* op = tokens[0];
+    int length = count > 1 ? replay_parse_bytes(&tokens[1], count - 1, bytes, FAKE_BMS_REPLY_MAX - 1) : 0;
+
+    if (length < 0) return false;
+
+    if (strcmp(op, "bms") == 0 || strcmp(op, "bms-raw") == 0) {
+        if (length < 1) return false;
+        size_t reply_length = length - 1;
+        if (strcmp(op, "bms") == 0) reply_length = replay_append_pec(bytes[0], &bytes[1], reply_length);
+        fake_bms_set_reply(bytes[0], &bytes[1], reply_length);
+        replay_scripted[bytes[0]] = true;
+    } else if (strcmp(op, "bms-error") == 0) {
+        if (length != 1) return false;
+        fake_bms_set_error(bytes[0]);
+        replay_scripted[bytes[0]] = true;
+    } else if (strcmp(op, "expect") == 0) {
+        replay_pending_expectation = true;
+        memcpy(replay_pending_expected, bytes, length);
+        replay_pending_expected_length = length;
+    } else if (strcmp(op, "start") == 0 && length == 0) {
+        replay_event(I2C_START, 0);
+    } else if (strcmp(op, "write") == 0 && length == 1) {
+        replay_event(I2C_WRITE, bytes[0]);
+    } else if (strcmp(op, "read") == 0 && length <= 1) {
+        for (int i = 0; i < (length == 1 ? bytes[0] : 1); i++) replay_event(I2C_READ, 0);
+    } else if (strcmp(op, "stop") == 0 && length == 0) {
+        replay_event(I2C_STOP, 0);
+    } else if (strcmp(op, "abort") == 0 && length == 0) {
+        replay_event(I2C_ABORT, 0);
+    } else if ((strcmp(op, "word") == 0 && length == 1) || (strcmp(op, "block") == 0 && length == 2)) {
+        int reads = length == 1 ? 3 : bytes[1] + 2;
+        replay_event(I2C_START, 0);
+        replay_event(I2C_WRITE, bytes[0]);
+        replay_event(I2C_START, 0);
+        for (int i = 0; i < reads; i++) replay_event(I2C_READ, 0);
+        replay_event(I2C_STOP, 0);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool replay_file(FILE* file, const char* name) {
+    char line[REPLAY_LINE_MAX];
+    char* tokens[REPLAY_LINE_MAX / 2];
+    unsigned long line_number = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* trace = strstr(line, "$T");
+        int count = 0;
+        line_number++;
+
+        if (trace != NULL) {
+            replay_trace_line(trace + 2);
+            continue;
+        }
+        if (replay_trace_only) continue;
+
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = 0;
+
+        for (char* token = strtok(line, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+            tokens[count++] = token;
+        }
+        if (count == 0) continue;
+
+        if (!replay_script_line(tokens, count)) {
+            fprintf(stderr, "%s:%lu: bad script line\n", name, line_number);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+int main(int argc, char* argv[]) {
+    int first_script = 1;
+    bool ok = true;
+
+    for (; first_script < argc && argv[first_script][0] == '-' && argv[first_script][1] != 0; first_script++) {
+        if (strcmp(argv[first_script], "-v") == 0) replay_verbose = true;
+        else if (strcmp(argv[first_script], "-t") == 0) replay_trace_only = true;
+        else {
+            fprintf(stderr, "usage: %s [-v] [-t] [script...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    init_log();
+    init_trace();
+
+    if (first_script == argc) ok = replay_file(stdin, "stdin");
+
+    for (int i = first_script; i < argc && ok; i++) {
+        FILE* file = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "r");
+        if (file == NULL) {
+            perror(argv[i]);
+            return 2;
+        }
+        ok = replay_file(file, argv[i]);
+        if (file != stdin) fclose(file);
+    }
+
+    if (!ok) return 2;
+
+    if (replay_transaction.open) printf("WARNING: last transaction never ended\n");
+
+    printf("\n%lu transactions: %lu ok, %lu failed, %lu unchecked\n",
+        replay_transaction_count, replay_passed, replay_failed, replay_unchecked);
+    printf("%lu events, %lu battery transfers, %llu us in the mitm (%.2f us per transaction)\n",
+        replay_events, replay_bms_transfers, (unsigned long long) replay_host_time,
+        replay_transaction_count > 0 ? (double) replay_host_time / replay_transaction_count : 0.0);
+    if (replay_lost_records > 0) printf("%lu trace records were lost\n", replay_lost_records);
+
+    unsigned long pec_checked, pec_failed;
+    mitm_get_pec_stats(&pec_checked, &pec_failed);
+    printf("%lu replies checked against their pec, %lu bad\n", pec_checked, pec_failed);
+
+    if (replay_verbose) {
+        printf("\n");
+        latency_dump();
+    }
+
+    return replay_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,321 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "spsc_ring.h"
+#include "static_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+    stress test and benchmark for the spsc ring (spsc_ring.c) on the host.
+    a producer thread and a consumer thread push a numbered sequence through rings of
+    different sizes, and the consumer checks that every element arrives once, in order and intact.
+    the small rings are full most of the time, so the full path and the wrap around the end of the
+    storage get hit constantly. the indices are also started just below SIZE_MAX once to make sure
+    the free-running counters survive overflowing.
+    afterwards the ring is timed against the old static queue (static_queue.c).
+
+    usage: ringtest [items]     (default 10000000 per run)
+
+    exits with 1 if anything went missing or arrived out of order.
+*/
+
+#define RINGTEST_DEFAULT_ITEMS 10000000
+#define RINGTEST_MAX_BATCH 64
+#define RINGTEST_BENCH_ITEMS 50000000
+#define RINGTEST_BENCH_CAPACITY 256
+
+
+// odd size on purpose so elements don't line up with the storage
+struct ringtest_element {
+    uint64_t seq;
+    uint32_t check;
+    uint8_t fill[5];
+} __attribute__((packed));
+
+struct ringtest_run {
+    spsc_ring_t ring;
+    size_t items;
+    unsigned seed;
+
+    long full_hits;         // producer side: how often the ring was full
+    long errors;            // consumer side
+};
+
+
+static uint32_t ringtest_check_value(uint64_t seq) {
+    uint32_t x = (uint32_t) seq ^ (uint32_t) (seq >> 32);
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static uint64_t ringtest_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void* ringtest_producer(void* arg) {
+    struct ringtest_run* run = arg;
+
+    for (uint64_t seq = 0; seq < run->items; seq++) {
+        struct ringtest_element* element;
+        while ((element = spsc_ring_claim(&run->ring)) == NULL) {
+            run->full_hits++;
+            sched_yield();      // let the consumer run, even on a single core
+        }
+
+        element->seq = seq;
+        element->check = ringtest_check_value(seq);
+        memset(element->fill, (uint8_t) seq, sizeof(element->fill));
+        spsc_ring_publish(&run->ring);
+    }
+
+    return NULL;
+}
+
+static void* ringtest_consumer(void* arg) {
+    struct ringtest_run* run = arg;
+    struct ringtest_element batch[RINGTEST_MAX_BATCH];
+    uint64_t expected = 0;
+    unsigned seed = run->seed;
+
+    while (expected < run->items) {
+        // vary the batch size so drains end at every possible spot in the storage
+        size_t max = rand_r(&seed) % RINGTEST_MAX_BATCH + 1;
+        size_t count = spsc_ring_drain(&run->ring, batch, max);
+        if (count > max) {
+            printf("  drain returned %zu elements, asked for at most %zu\n", count, max);
+            run->errors++;
+            return NULL;
+        }
+        if (count == 0) sched_yield();
+
+        for (size_t i = 0; i < count; i++) {
+            struct ringtest_element* element = &batch[i];
+            bool fill_ok = true;
+            for (size_t j = 0; j < sizeof(element->fill); j++) {
+                if (element->fill[j] != (uint8_t) element->seq) fill_ok = false;
+            }
+
+            if (element->seq != expected || element->check != ringtest_check_value(element->seq) || !fill_ok) {
+                if (run->errors < 10) {
+                    printf("  expected element %llu, got %llu (check %08x, fill %s)\n",
+                           (unsigned long long) expected, (unsigned long long) element->seq,
+                           element->check, fill_ok ? "ok" : "corrupt");
+                }
+                run->errors++;
+                expected = element->seq;    // resync so one bad element doesn't fail the rest
+            }
+            expected++;
+        }
+    }
+
+    return NULL;
+}
+
+static bool ringtest_run(size_t capacity, size_t items, size_t start_index) {
+    struct ringtest_run run = {
+        items: items,
+        seed: (unsigned) (capacity * 7919 + start_index),
+    };
+    struct ringtest_element* data = malloc(capacity * sizeof(struct ringtest_element));
+    if (data == NULL || !init_spsc_ring(&run.ring, data, capacity, sizeof(struct ringtest_element))) {
+        printf("capacity %zu: can't set up the ring\n", capacity);
+        free(data);
+        return false;
+    }
+
+    // the ring is empty whenever head == tail, so starting both somewhere else is legal
+    atomic_store(&run.ring._head, start_index);
+    atomic_store(&run.ring._tail, start_index);
+
+    uint64_t start = ringtest_now_ns();
+    pthread_t producer, consumer;
+    pthread_create(&consumer, NULL, ringtest_consumer, &run);
+    pthread_create(&producer, NULL, ringtest_producer, &run);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    double seconds = (ringtest_now_ns() - start) / 1e9;
+
+    size_t leftover = spsc_ring_size(&run.ring);
+    bool ok = run.errors == 0 && leftover == 0 && run.ring.dropped == run.full_hits;
+
+    printf("capacity %5zu, start index %#zx: %zu items in %.2fs, ring full %ld times, %ld errors, %zu left over -> %s\n",
+           capacity, start_index, items, seconds, run.full_hits, run.errors, leftover, ok ? "ok" : "FAILED");
+    if (run.ring.dropped != run.full_hits) {
+        printf("  dropped counter says %ld, producer saw %ld\n", run.ring.dropped, run.full_hits);
+    }
+
+    free(data);
+    return ok;
+}
+
+// the single threaded edge cases: filling up, refusing more, partial drains across the end and clear
+static bool ringtest_edge_cases() {
+    uint32_t data[4];
+    uint32_t out[8];
+    spsc_ring_t ring;
+    bool ok = true;
+
+    if (init_spsc_ring(&ring, data, 3, sizeof(uint32_t))) {
+        printf("edge cases: capacity 3 was accepted\n");
+        ok = false;
+    }
+    init_spsc_ring(&ring, data, 4, sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < 4; i++) {
+        uint32_t* element = spsc_ring_claim(&ring);
+        if (element == NULL) {
+            printf("edge cases: claim %u failed on a ring that isn't full\n", i);
+            return false;
+        }
+        *element = i;
+        spsc_ring_publish(&ring);
+    }
+
+    if (spsc_ring_claim(&ring) != NULL || ring.dropped != 1 || spsc_ring_size(&ring) != 4) {
+        printf("edge cases: full ring accepted another element\n");
+        ok = false;
+    }
+
+    // take 3, put 3 more in so they wrap around the end, then take everything
+    if (spsc_ring_drain(&ring, out, 3) != 3 || out[0] != 0 || out[2] != 2) {
+        printf("edge cases: partial drain returned the wrong elements\n");
+        ok = false;
+    }
+    for (uint32_t i = 4; i < 7; i++) {
+        uint32_t* element = spsc_ring_claim(&ring);
+        if (element == NULL) {
+            printf("edge cases: claim %u failed after a drain\n", i);
+            return false;
+        }
+        *element = i;
+        spsc_ring_publish(&ring);
+    }
+    size_t count = spsc_ring_drain(&ring, out, 8);
+    if (count != 4) {
+        printf("edge cases: wrapped drain returned %zu elements instead of 4\n", count);
+        ok = false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (out[i] != i + 3) {
+            printf("edge cases: wrapped drain element %u is %u instead of %u\n", i, out[i], i + 3);
+            ok = false;
+        }
+    }
+
+    if (spsc_ring_drain(&ring, out, 8) != 0) {
+        printf("edge cases: drain on an empty ring returned something\n");
+        ok = false;
+    }
+
+    *(uint32_t*) spsc_ring_claim(&ring) = 42;
+    spsc_ring_publish(&ring);
+    spsc_ring_clear(&ring);
+    if (spsc_ring_size(&ring) != 0 || spsc_ring_drain(&ring, out, 8) != 0) {
+        printf("edge cases: clear left elements behind\n");
+        ok = false;
+    }
+
+    printf("edge cases -> %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// same access pattern the firmware uses (one add, one take), single threaded so the queue isn't racing itself
+static void ringtest_benchmark() {
+    static_queue_t* queue = create_static_queue(RINGTEST_BENCH_CAPACITY, sizeof(uint64_t));
+    uint64_t ring_data[RINGTEST_BENCH_CAPACITY];
+    uint64_t out[RINGTEST_BENCH_CAPACITY];
+    spsc_ring_t ring;
+    init_spsc_ring(&ring, ring_data, RINGTEST_BENCH_CAPACITY, sizeof(uint64_t));
+    volatile uint64_t sink = 0;
+
+    uint64_t start = ringtest_now_ns();
+    for (uint64_t i = 0; i < RINGTEST_BENCH_ITEMS; i++) {
+        *(uint64_t*) static_queue_add(queue) = i;
+        sink += *(uint64_t*) static_queue_pop(queue);
+    }
+    double queue_ns = (double) (ringtest_now_ns() - start) / RINGTEST_BENCH_ITEMS;
+
+    start = ringtest_now_ns();
+    for (uint64_t i = 0; i < RINGTEST_BENCH_ITEMS; i++) {
+        *(uint64_t*) spsc_ring_claim(&ring) = i;
+        spsc_ring_publish(&ring);
+        spsc_ring_drain(&ring, out, 1);
+        sink += out[0];
+    }
+    double ring_ns = (double) (ringtest_now_ns() - start) / RINGTEST_BENCH_ITEMS;
+
+    // the way the logger drains: fill up, then take everything in one go
+    start = ringtest_now_ns();
+    for (uint64_t i = 0; i < RINGTEST_BENCH_ITEMS; i += RINGTEST_BENCH_CAPACITY) {
+        for (size_t j = 0; j < RINGTEST_BENCH_CAPACITY; j++) {
+            *(uint64_t*) spsc_ring_claim(&ring) = i + j;
+            spsc_ring_publish(&ring);
+        }
+        sink += spsc_ring_drain(&ring, out, RINGTEST_BENCH_CAPACITY);
+    }
+    double ring_batch_ns = (double) (ringtest_now_ns() - start) / RINGTEST_BENCH_ITEMS;
+
+    start = ringtest_now_ns();
+    for (uint64_t i = 0; i < RINGTEST_BENCH_ITEMS; i += RINGTEST_BENCH_CAPACITY - 1) {
+        for (size_t j = 0; j < RINGTEST_BENCH_CAPACITY - 1; j++) {
+            *(uint64_t*) static_queue_add(queue) = i + j;
+        }
+        void* element;
+        while ((element = static_queue_pop(queue)) != NULL) sink += *(uint64_t*) element;
+    }
+    double queue_batch_ns = (double) (ringtest_now_ns() - start) / RINGTEST_BENCH_ITEMS;
+
+    printf("\nbenchmark, %d items of 8 bytes:\n", RINGTEST_BENCH_ITEMS);
+    printf("  one at a time:  static queue %.2f ns/item, spsc ring %.2f ns/item\n", queue_ns, ring_ns);
+    printf("  fill and empty: static queue %.2f ns/item, spsc ring %.2f ns/item\n", queue_batch_ns, ring_batch_ns);
+    (void) sink;
+}
+
+int main(int argc, char** argv) {
+    size_t items = RINGTEST_DEFAULT_ITEMS;
+    if (argc > 1) items = strtoull(argv[1], NULL, 0);
+
+    bool ok = ringtest_edge_cases();
+
+    const size_t capacities[] = {1, 2, 4, 64, 1024};
+    for (size_t i = 0; i < sizeof(capacities) / sizeof(capacities[0]); i++) {
+        ok &= ringtest_run(capacities[i], items, 0);
+    }
+
+    // let the free-running indices overflow in the middle of the run
+    ok &= ringtest_run(16, items, SIZE_MAX - items / 2);
+
+    ringtest_benchmark();
+
+    return ok ? 0 : 1;
+}
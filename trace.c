@@ -0,0 +1,110 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include "trace.h"
+#include "spsc_ring.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+
+
+spsc_ring_t trace_ring;
+trace_record_t trace_ring_data[TRACE_BUFFER_RECORDS];
+
+uint8_t trace_sequence = 0;
+uint32_t trace_time_high = 0;
+bool trace_time_high_sent = false;
+
+// records currently being sent, and the line they're encoded into
+trace_record_t trace_flush_batch[TRACE_FLUSH_MAX_RECORDS];
+char trace_flush_line[2 + TRACE_FLUSH_MAX_RECORDS * sizeof(trace_record_t) * 2 + 2];
+
+
+bool trace_write_internal(trace_record_type_t type, uint32_t timestamp, uint8_t data, int status) {
+    trace_record_t* record = spsc_ring_claim(&trace_ring);
+    uint8_t sequence = trace_sequence++;    // also counts dropped records
+    if (record == NULL) return false;
+
+    record->timestamp = timestamp;
+    record->type = type;
+    record->data = data;
+    record->status = status < -128 ? -128 : status;
+    record->sequence = sequence;
+
+    spsc_ring_publish(&trace_ring);
+    return true;
+}
+
+void trace_record(trace_record_type_t type, uint8_t data, int status) {
+    // the laptop irq adds records too, keep it from cutting in while we write ours.
+    // the time is taken in here as well, so the records stay in time order
+    uint32_t irq_state = save_and_disable_interrupts();
+
+    uint64_t timestamp = time_us_64();
+    uint32_t time_high = timestamp >> 32;
+
+    if (!trace_time_high_sent || trace_time_high != time_high) {
+        trace_time_high_sent = trace_write_internal(TRACE_TIME_HIGH, time_high, 0, 0);
+        trace_time_high = time_high;
+    }
+
+    trace_write_internal(type, (uint32_t) timestamp, data, status);
+
+    restore_interrupts(irq_state);
+}
+
+void trace_record_bytes(trace_record_type_t type, uint8_t* buffer, size_t length, int status) {
+    if (status < 0) {
+        trace_record(type, 0, status);
+        return;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        trace_record(type, buffer[i], 0);
+    }
+}
+
+void trace_flush() {
+    const char hex[] = "0123456789abcdef";
+    size_t count = spsc_ring_drain(&trace_ring, trace_flush_batch, TRACE_FLUSH_MAX_RECORDS);
+    if (count == 0) return;
+
+    // hex-encode the records as they sit in memory (little endian)
+    uint8_t* bytes = (uint8_t*) trace_flush_batch;
+    size_t length = 0;
+
+    trace_flush_line[length++] = '$';
+    trace_flush_line[length++] = 'T';
+    for (size_t i = 0; i < count * sizeof(trace_record_t); i++) {
+        trace_flush_line[length++] = hex[bytes[i] >> 4];
+        trace_flush_line[length++] = hex[bytes[i] & 0x0F];
+    }
+    trace_flush_line[length++] = '\n';
+    trace_flush_line[length] = 0;
+
+    fputs(trace_flush_line, stdout);
+}
+
+void init_trace() {
+    init_spsc_ring(&trace_ring, trace_ring_data, TRACE_BUFFER_RECORDS, sizeof(trace_record_t));
+}
@@ -0,0 +1,117 @@
+/**
+    MIT License
+
+    Copyright (c) 2025 Benjamin Wiegand
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy 
+    of this software and associated documentation files (the "Software"), to deal 
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell 
+    copies of the Software, and to permit persons to whom the Software is 
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in 
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+    IN THE SOFTWARE.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "config.h"
+
+// smbus bus trace
+// records everything the laptop does on the bus and everything forwarded to the battery, with timestamps.
+// records go into a big ring buffer and get streamed out over usb serial by trace_flush() in the background.
+//
+// record format (8 bytes, little endian):
+//   offset 0   uint32  timestamp: lower 32 bits of time_us_64()
+//   offset 4   uint8   type (see trace_record_type below)
+//   offset 5   uint8   data byte, depends on the type
+//   offset 6   int8    status: 0 if ok, otherwise the (negative) pico sdk error code of the battery transfer
+//   offset 7   uint8   sequence number. goes up by 1 for every record (wrapping), including ones that got dropped
+//                      because the ring was full, so a gap means records were lost
+//
+// TRACE_TIME_HIGH records hold the upper 32 bits of time_us_64() in the timestamp field instead.
+// one comes before the first record and then whenever the upper half changes, so full timestamps can be rebuilt.
+//
+// export format:
+//   records are sent over usb serial as text lines alongside the regular log output.
+//   each line is "$T" followed by one or more records hex-encoded in byte order (16 hex chars per record), then "\n".
+//   the "$T" may follow an unfinished log line, so look for it anywhere in a line.
+//
+// decoding transactions:
+//   a laptop transaction is LAPTOP_START, LAPTOP_WRITEs (command code, then any data), and for reads another
+//   LAPTOP_START followed by LAPTOP_READ + LAPTOP_REPLY pairs. it ends with LAPTOP_STOP or LAPTOP_ABORT.
+//   BMS_* records show what was forwarded to the battery on behalf of the laptop (or read by an override).
+
+#define TRACE_BUFFER_RECORDS 4096       // must be a power of two
+#define TRACE_FLUSH_MAX_RECORDS 32      // max records sent per trace_flush() call
+
+
+#ifndef TRACE_RECORD_DEF
+#define TRACE_RECORD_DEF
+
+// values are part of the export format, don't reorder
+enum trace_record_type {
+    TRACE_TIME_HIGH = 0x00,
+
+    // seen by the laptop irq
+    TRACE_LAPTOP_START = 0x01,
+    TRACE_LAPTOP_STOP = 0x02,
+    TRACE_LAPTOP_ABORT = 0x03,
+    TRACE_LAPTOP_WRITE = 0x04,      // data = byte written by the laptop
+    TRACE_LAPTOP_READ = 0x05,       // laptop requested a byte
+
+    // sent back to the laptop
+    TRACE_LAPTOP_REPLY = 0x06,      // data = byte sent to the laptop
+
+    // forwarded to the battery
+    TRACE_BMS_WRITE = 0x10,         // data = byte written, transfer kept open
+    TRACE_BMS_WRITE_STOP = 0x11,    // data = byte written, followed by a stop
+    TRACE_BMS_READ = 0x12,          // data = byte read
+    TRACE_BMS_STOP = 0x13,          // read transfer ended
+};
+
+typedef enum trace_record_type trace_record_type_t;
+
+struct trace_record {
+    uint32_t timestamp;
+    uint8_t type;
+    uint8_t data;
+    int8_t status;
+    uint8_t sequence;
+};
+
+typedef struct trace_record trace_record_t;
+
+#endif
+
+
+// adds a record to the trace. safe to call from core0 and its interrupts
+void trace_record(trace_record_type_t type, uint8_t data, int status);
+
+// same as trace_record, but adds one record per byte in the buffer (or a single one with the error if status is negative)
+void trace_record_bytes(trace_record_type_t type, uint8_t* buffer, size_t length, int status);
+
+// sends up to TRACE_FLUSH_MAX_RECORDS pending records over usb serial.
+// call from core0 when nothing time critical is going on
+void trace_flush();
+
+void init_trace();
+
+
+// compiles to nothing when the trace is disabled in config.h
+#if BUS_TRACE
+#define TRACE(type, data, status) trace_record(type, data, status)
+#define TRACE_BYTES(type, buffer, length, status) trace_record_bytes(type, buffer, length, status)
+#else
+#define TRACE(type, data, status) ((void) 0)
+#define TRACE_BYTES(type, buffer, length, status) ((void) 0)
+#endif